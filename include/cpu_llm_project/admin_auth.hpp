@@ -0,0 +1,18 @@
+#ifndef CPU_LLM_PROJECT_ADMIN_AUTH_HPP
+#define CPU_LLM_PROJECT_ADMIN_AUTH_HPP
+
+#include <string>
+
+namespace cpu_llm_project {
+
+// Autorização das rotas administrativas (POST /api/admin/reload), comum ao ApiServer e ao
+// roteador. Pelo Unix socket (criado com modo 0600: só o usuário do servidor conecta) a
+// requisição sempre passa. Por TCP, só com admin_token configurado e o header
+// "Authorization: Bearer <admin_token>"; sem token configurado, a rota fica restrita ao
+// Unix socket. Em caso de recusa, retorna false com o status HTTP (401 ou 403) e a mensagem.
+bool authorize_admin_request(const std::string& admin_token, const std::string& authorization_header,
+                             bool via_unix_socket, int& status, std::string& error);
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_ADMIN_AUTH_HPP
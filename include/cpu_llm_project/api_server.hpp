@@ -3,11 +3,15 @@
 
 #include <string>
 #include <memory> // Para std::unique_ptr
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
 
-// Forward declare LlmEngine para evitar include completo aqui se não for necessário
-// No entanto, como o ApiServer o usará diretamente, um include pode ser mais simples
-// dependendo de como os métodos são implementados.
-// Por enquanto, vamos com forward declaration e incluir no .cpp.
+// O ApiServer guarda os padrões de geração da persona (GenerationParams), então
+// incluímos o header do LlmEngine aqui em vez de apenas declará-lo.
+#include "cpu_llm_project/llm_engine.hpp"
 
 // Forward declaration para classes do cpp-httplib
 namespace httplib {
@@ -18,27 +22,89 @@ namespace httplib {
 
 namespace cpu_llm_project {
 
-class LlmEngine; // Forward declaration da nossa classe LlmEngine
+// Configuração do front end HTTP. Os padrões mantêm o comportamento do cpp-httplib,
+// exceto onde indicado.
+struct ServerOptions {
+    int worker_threads = 0;          // Threads que atendem conexões. 0 = padrão do httplib, max(8, núcleos - 1)
+    size_t max_connections = 0;      // Conexões abertas (em atendimento ou na fila), somando os listeners. 0 = sem limite
+    size_t max_queued = 0;           // Conexões aceitas esperando uma thread livre, por listener. 0 = sem limite
+    time_t read_timeout_sec = 5;     // Tempo máximo esperando dados do cliente
+    time_t write_timeout_sec = 5;    // Tempo máximo escrevendo a resposta
+    time_t keep_alive_timeout_sec = 5;   // Conexão keep-alive ociosa é fechada após este tempo
+    size_t keep_alive_max_requests = 5;  // Requisições por conexão keep-alive antes de fechá-la
+    size_t payload_max_bytes = 0;    // Corpo máximo de uma requisição. 0 = sem limite
+    std::string unix_socket_path;    // Se não vazio, também escuta neste Unix domain socket (modo 0600)
+    std::string admin_token;         // Libera /api/admin/* por TCP com "Authorization: Bearer <token>" (veja admin_auth.hpp)
+};
+
+// Contadores de conexão, somados entre os listeners (TCP e Unix socket).
+struct ConnectionStats {
+    uint64_t accepted = 0;  // Conexões entregues às threads de atendimento
+    uint64_t rejected = 0;  // Fechadas na aceitação por max_connections / max_queued
+    uint64_t active = 0;    // Abertas agora (em atendimento ou na fila)
+    uint64_t peak_active = 0;
+    uint64_t requests = 0;  // Requisições respondidas (uma conexão keep-alive atende várias)
+};
 
 class ApiServer {
 public:
-    ApiServer(LlmEngine& engine, const std::string& host = "localhost", int port = 8080);
+    // Chamado por POST /api/admin/reload. force_model_reload pede para recarregar o modelo
+    // mesmo que o caminho no YAML não tenha mudado. Retorna false e preenche message em caso de erro.
+    using ReloadHandler = std::function<bool(bool force_model_reload, std::string& message)>;
+
+    ApiServer(LlmEngine& engine, const std::string& host = "localhost", int port = 8080,
+              const ServerOptions& options = ServerOptions());
     ~ApiServer();
 
-    bool start(); // Retorna true se iniciou com sucesso
+    bool start(); // Retorna true se iniciou com sucesso. Bloqueia até stop().
     void stop();
 
+    // Porta TCP em que o servidor escuta (a escolhida pelo sistema se port for 0); 0 até
+    // start() conseguir o bind.
+    int port() const { return bound_port_; }
+
+    ConnectionStats get_connection_stats() const;
+
+    // Valores da persona usados quando a requisição não os especifica.
+    // Pode ser chamado com o servidor rodando (recarga a quente da persona).
+    void set_persona_defaults(const std::string& system_prompt, const GenerationParams& params);
+    void set_reload_handler(ReloadHandler handler);
+
 private:
-    void setup_routes();
+    // Contadores atualizados pelas filas de conexão e pelo logger dos servidores.
+    struct ConnectionCounters {
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> active{0};
+        std::atomic<uint64_t> peak_active{0};
+        std::atomic<uint64_t> requests{0};
+    };
+
+    // via_unix_socket: o listener é o Unix socket (rotas administrativas sem token).
+    void setup_routes(httplib::Server& server, bool via_unix_socket);
+    void configure_server(httplib::Server& server);
 
     // Handlers para as rotas da API
     void post_generate(const httplib::Request& req, httplib::Response& res);
+    void post_score(const httplib::Request& req, httplib::Response& res);
+    void post_admin_reload(const httplib::Request& req, httplib::Response& res, bool via_unix_socket);
+    void get_metrics(const httplib::Request& req, httplib::Response& res);
+    void get_ps(const httplib::Request& req, httplib::Response& res);
     // Adicionar mais handlers conforme necessário (ex: /api/chat, /api/models)
 
     LlmEngine& engine_; // Referência ao motor LLM principal
-    std::unique_ptr<httplib::Server> server_; // O servidor HTTP
+    ServerOptions options_;
+    ConnectionCounters counters_;
+    std::unique_ptr<httplib::Server> server_; // O servidor HTTP (TCP em host_:port_)
+    std::unique_ptr<httplib::Server> unix_server_; // Listener no Unix socket, se configurado
     std::string host_;
     int port_;
+    std::atomic<int> bound_port_{0};
+
+    std::string default_system_prompt_;
+    GenerationParams default_params_;
+    ReloadHandler reload_handler_;
+    std::mutex defaults_mutex_; // Protege os padrões da persona e o reload_handler_
     // std::thread server_thread_; // Para rodar o servidor em uma thread separada
     // bool is_running_ = false; // Para controlar o estado do servidor
 };
@@ -0,0 +1,99 @@
+#ifndef CPU_LLM_PROJECT_AUTOTUNE_HPP
+#define CPU_LLM_PROJECT_AUTOTUNE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cpu_llm_project {
+
+// Uma combinação de parâmetros do motor avaliada pelo autotune.
+struct TuneConfig {
+    int prefill_threads = 0;
+    int decode_threads = 0;
+    int n_batch = 512;
+    int n_ubatch = 512;
+    std::string kv_cache_type = "f16";
+    bool flash_attn = false;
+
+    std::string to_string() const;
+};
+
+struct TuneMeasurement {
+    bool ok = false;
+    std::string error;         // Por que a combinação não rodou (ex.: cache V quantizado sem flash attention)
+    double prefill_tok_s = 0.0;
+    double decode_tok_s = 0.0;
+    double ttft_ms = 0.0;      // Prompt sintético inteiro até os logits do primeiro token
+};
+
+enum class TuneObjective {
+    DecodeThroughput,  // "decode": tokens/s gerados
+    PrefillThroughput, // "prefill": tokens/s de prompt
+    TimeToFirstToken,  // "ttft": menor tempo até o primeiro token
+};
+
+struct TuneSearchSpace {
+    std::vector<int> threads;  // Candidatos para prefill_threads e decode_threads
+    std::vector<int> n_batch;
+    std::vector<int> n_ubatch;
+    std::vector<std::string> kv_cache_types;
+    std::vector<bool> flash_attn;
+};
+
+struct AutotuneOptions {
+    std::string model_path;
+    int n_ctx = 2048;
+    int n_seq_max = 1;         // max_sequences da persona: o contexto medido tem o formato do de produção
+    TuneObjective objective = TuneObjective::DecodeThroughput;
+    int prefill_tokens = 512;  // Tamanho do prompt sintético
+    int decode_tokens = 64;    // Passos de geração medidos
+    int repetitions = 2;       // Vale a melhor de N medições de cada combinação
+    int max_passes = 2;        // Voltas da busca por coordenadas
+    uint32_t threadpool_poll = 50;
+};
+
+struct AutotuneResult {
+    std::string fingerprint;
+    TuneConfig best;
+    TuneMeasurement best_measurement;
+    int trials = 0;            // Combinações medidas (sem repetir as já vistas)
+};
+
+namespace autotune {
+
+// Identifica a CPU: modelo (cpuid ou /proc/cpuinfo), CPUs online e maior extensão SIMD.
+// Máquinas do mesmo SKU produzem a mesma string, qualquer que seja a afinidade do processo.
+std::string hardware_fingerprint();
+
+bool parse_objective(const std::string& name, TuneObjective& objective);
+const char* objective_name(TuneObjective objective);
+
+// Maior é melhor. Medições que falharam valem -infinito.
+double objective_score(TuneObjective objective, const TuneMeasurement& measurement);
+
+// Espaço padrão para n_cpus: threads em quartos do total (a geração costuma saturar a
+// banda de memória antes de usar todos os núcleos), batches de 256 a 2048, f16/q8_0 e
+// flash attention ligada ou não.
+TuneSearchSpace default_search_space(int n_cpus);
+
+using MeasureFunction = std::function<TuneMeasurement(const TuneConfig&)>;
+
+// Busca por coordenadas: a partir de start, varia um parâmetro por vez mantendo os outros,
+// fica com o melhor valor e repete até uma volta sem melhora (ou max_passes voltas).
+// Combinações já medidas não são medidas de novo; n_ubatch > n_batch é pulado.
+TuneConfig coordinate_descent(const TuneSearchSpace& space, const TuneConfig& start, TuneObjective objective,
+                              int max_passes, const MeasureFunction& measure, AutotuneResult& result);
+
+// Carrega o modelo uma vez e mede cada combinação com um prompt sintético e passos de
+// geração, recriando só o contexto. on_trial é chamado após cada medição. O backend
+// (llama_backend_init/llama_backend_free) é do chamador, e o callback de log anterior é
+// restaurado ao fim, como em quantizer::quantize_model.
+bool run(const AutotuneOptions& options, AutotuneResult& result, std::string& error,
+         const std::function<void(const TuneConfig&, const TuneMeasurement&)>& on_trial = {});
+
+} // namespace autotune
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_AUTOTUNE_HPP
@@ -0,0 +1,98 @@
+#ifndef CPU_LLM_PROJECT_COMPUTE_POOL_HPP
+#define CPU_LLM_PROJECT_COMPUTE_POOL_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace cpu_llm_project {
+
+struct ComputePoolOptions {
+    int prefill_threads = 0;     // Pool de batches (prompt, n > 1); 0 = todas as CPUs disponíveis
+    int decode_threads = 0;      // Pool de passos de um token; 0 = todas as CPUs disponíveis
+    uint32_t poll = 50;          // Espera ativa após cada grafo (0 = dorme logo, 100 = gira o máximo)
+    bool partition_cpus = false; // Prende prefill e decode a conjuntos disjuntos de CPUs
+
+    bool operator==(const ComputePoolOptions& other) const {
+        return prefill_threads == other.prefill_threads && decode_threads == other.decode_threads
+            && poll == other.poll && partition_cpus == other.partition_cpus;
+    }
+    bool operator!=(const ComputePoolOptions& other) const { return !(*this == other); }
+};
+
+// Threads de computação do ggml compartilhadas por todos os contextos do processo. Sem
+// isso, cada llama_context cria as suas próprias threads (que giram esperando trabalho),
+// e dois modelos carregados, ou o antigo e o novo durante uma troca a quente, disputam
+// os mesmos núcleos com o dobro de threads.
+//
+// Um pool do ggml computa um grafo por vez: cada llama_decode trava, via Lease, os pools
+// que vai usar, então contextos diferentes se revezam em vez de se sobreporem. Sem
+// partition_cpus os dois pools ocupam as mesmas CPUs, e todo Lease trava os dois.
+class ComputePools {
+public:
+    enum class Pool { Prefill, Decode };
+
+    // Retorna nullptr e preenche error se o ggml não conseguir criar as threads.
+    static std::shared_ptr<ComputePools> create(const ComputePoolOptions& options, std::string& error);
+    ~ComputePools();
+
+    ComputePools(const ComputePools&) = delete;
+    ComputePools& operator=(const ComputePools&) = delete;
+
+    // Opções como pedidas (para comparar numa recarga) e número efetivo de threads.
+    const ComputePoolOptions& requested_options() const { return requested_; }
+    int prefill_threads() const { return prefill_threads_; }
+    int decode_threads() const { return decode_threads_; }
+    bool partitioned() const { return partitioned_; }
+
+    // O contexto precisa ter sido criado com n_threads = decode_threads() e
+    // n_threads_batch = prefill_threads().
+    void attach(llama_context* ctx) const;
+    // Um só pool para todos os batches do contexto (modo desagregado: um contexto só de
+    // prefill, outro só de decode). O contexto precisa ter sido criado com n_threads e
+    // n_threads_batch iguais a threads(pool).
+    void attach(llama_context* ctx, Pool pool) const;
+    int threads(Pool pool) const { return pool == Pool::Prefill ? prefill_threads_ : decode_threads_; }
+
+    // Trava, durante a vida do objeto, os pools que um llama_decode de n_tokens vai usar
+    // (os dois, se não houver partição).
+    class Lease {
+    public:
+        Lease(ComputePools& pools, int n_tokens, int n_ubatch);
+        // Para contextos anexados a um só pool: trava só ele (havendo partição).
+        Lease(ComputePools& pools, Pool pool);
+    private:
+        void lock(ComputePools& pools, bool prefill, bool decode);
+
+        std::unique_lock<std::mutex> prefill_lock_;
+        std::unique_lock<std::mutex> decode_lock_;
+    };
+
+    // O llama.cpp divide o batch em micro-batches de até n_ubatch tokens e usa o pool de
+    // prefill para os que têm mais de um token e o de decode para os de um token só. Um
+    // batch que ocupa mais de um micro-batch usa os dois.
+    static void pools_for_batch(int n_tokens, int n_ubatch, bool& uses_prefill, bool& uses_decode);
+
+    // CPUs em que o processo pode rodar (afinidade atual; todas se não disponível).
+    static std::vector<int> available_cpus();
+
+private:
+    ComputePools() = default;
+
+    ComputePoolOptions requested_;
+    int prefill_threads_ = 0;
+    int decode_threads_ = 0;
+    bool partitioned_ = false;
+    ggml_threadpool_t prefill_pool_ = nullptr;
+    ggml_threadpool_t decode_pool_ = nullptr;
+    std::mutex prefill_mutex_;
+    std::mutex decode_mutex_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_COMPUTE_POOL_HPP
@@ -0,0 +1,39 @@
+#ifndef CPU_LLM_PROJECT_CONNECTION_QUEUE_HPP
+#define CPU_LLM_PROJECT_CONNECTION_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "httplib.h"
+
+namespace cpu_llm_project {
+
+// Fila de conexões do httplib com limite de conexões abertas. O httplib entrega cada
+// conexão aceita a enqueue() e a fecha se enqueue() retornar false; a tarefa só termina
+// quando a conexão (com keep-alive) é fechada, então "tarefas em andamento" = conexões abertas.
+// Os contadores são do dono (ApiServer), compartilhados entre os listeners.
+class BoundedConnectionQueue : public httplib::TaskQueue {
+public:
+    // threads 0 = o padrão do httplib (CPPHTTPLIB_THREAD_POOL_COUNT). max_queued e
+    // max_connections 0 = sem limite.
+    BoundedConnectionQueue(size_t threads, size_t max_queued, size_t max_connections,
+                           std::atomic<uint64_t>& accepted, std::atomic<uint64_t>& rejected,
+                           std::atomic<uint64_t>& active, std::atomic<uint64_t>& peak_active);
+
+    bool enqueue(std::function<void()> fn) override;
+    void shutdown() override;
+
+private:
+    httplib::ThreadPool pool_;
+    size_t max_connections_;
+    std::atomic<uint64_t>& accepted_;
+    std::atomic<uint64_t>& rejected_;
+    std::atomic<uint64_t>& active_;
+    std::atomic<uint64_t>& peak_active_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_CONNECTION_QUEUE_HPP
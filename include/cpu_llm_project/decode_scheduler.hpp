@@ -0,0 +1,150 @@
+#ifndef CPU_LLM_PROJECT_DECODE_SCHEDULER_HPP
+#define CPU_LLM_PROJECT_DECODE_SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "llama.h"
+
+#include "cpu_llm_project/sampler.hpp"
+
+namespace cpu_llm_project {
+
+// Sequências (seq_ids) e células do cache KV do contexto de decode reservadas por geração.
+// Uma geração de n completações ocupa n seq_ids e as células do prompt (compartilhadas
+// pelas n) mais max_tokens - 1 por completação; só entra se couber inteira, para que uma
+// geração nunca esgote o cache de outra no meio do caminho. As células são um só total
+// para todas as sequências, o que exige o contexto criado com kv_unified.
+class SlotTable {
+public:
+    SlotTable(int n_slots, int n_cells);
+
+    // true se a geração cabe com o contexto vazio (senão, nunca vai caber).
+    bool fits(int n_seqs, int cells) const { return n_seqs <= n_slots_ && cells <= n_cells_; }
+    // Reserva n_seqs seq_ids livres e cells células; false (sem reservar nada) se não couber agora.
+    bool reserve(int n_seqs, int cells, std::vector<llama_seq_id>& seq_ids);
+    void release(const std::vector<llama_seq_id>& seq_ids, int cells);
+
+    int n_slots() const { return n_slots_; }
+    int n_cells() const { return n_cells_; }
+    int free_slots() const;
+    int free_cells() const { return n_cells_ - used_cells_; }
+
+private:
+    std::vector<bool> used_;
+    int n_slots_ = 0;
+    int n_cells_ = 0;
+    int used_cells_ = 0;
+};
+
+// Células do cache KV ocupadas pelas sequências seq_ids, pelas posições de cada uma
+// (llama_memory_seq_pos_min/max). Com kv_unified, llama_memory_seq_cp não copia células:
+// os n_shared_prefix tokens do prompt copiados da primeira para as demais contam uma vez só.
+int32_t kv_cells_in_use(llama_memory_t memory, const std::vector<llama_seq_id>& seq_ids, int32_t n_shared_prefix);
+
+// Uma geração já com o prompt processado no contexto de prefill.
+struct DecodeJob {
+    // Entrada
+    std::vector<uint8_t> prompt_state; // llama_state_seq_get_data da sequência do prompt
+    std::vector<float> prompt_logits;  // Logits do último token do prompt
+    int n_prompt_tokens = 0;
+    int max_tokens = 0;
+    std::vector<Sampler> samplers;     // Um por completação, com os tokens do prompt já aceitos
+    std::vector<std::pair<llama_adapter_lora*, float>> loras;
+    uint64_t trace_id = 0;             // Spans dos passos de decode vão para este trace,
+    uint64_t parent_span_id = 0;       // como filhos deste span da requisição
+
+    // Saída
+    std::vector<std::vector<llama_token>> tokens; // Tokens gerados por completação (sem o EOG)
+    bool ok = false;
+    std::string error;
+};
+
+// Dono do contexto de decode no modo desagregado (disaggregate_prefill). Uma thread admite
+// as gerações cujo prompt já foi processado em outro contexto, restaura o estado KV de cada
+// uma numa sequência livre e avança todas as sequências ativas juntas, um token por
+// sequência a cada llama_decode (continuous batching): uma geração entra ou sai entre dois
+// passos sem esperar as outras terminarem, e um prompt longo nunca ocupa este contexto.
+//
+// A restauração é uma cópia do tamanho do cache KV do prompt e acontece entre dois passos,
+// atrasando todas as sequências ativas. Por isso cada intervalo entre passos restaura no
+// máximo restore_bytes_per_step (um estado maior que isso é restaurado sozinho); o resto
+// entra nos passos seguintes. Com o contexto ocioso não há limite.
+class DecodeScheduler {
+public:
+    using DecodeFunction = std::function<int32_t(llama_batch&)>;
+
+    static constexpr size_t kDefaultRestoreBytesPerStep = 64u * 1024 * 1024;
+
+    // decode é chamado só pela thread do escalonador. n_cells é o n_ctx do contexto, que
+    // precisa ter cache KV unificado (veja SlotTable).
+    DecodeScheduler(llama_context* ctx, const llama_vocab* vocab, int n_slots, int n_cells,
+                    DecodeFunction decode, std::atomic<int32_t>& kv_used_cells,
+                    size_t restore_bytes_per_step = kDefaultRestoreBytesPerStep);
+    ~DecodeScheduler();
+
+    DecodeScheduler(const DecodeScheduler&) = delete;
+    DecodeScheduler& operator=(const DecodeScheduler&) = delete;
+
+    // Enfileira a geração e bloqueia até ela terminar (job.ok / job.error preenchidos).
+    void run(DecodeJob& job);
+
+private:
+    struct Sequence {
+        DecodeJob* job = nullptr;
+        size_t index = 0;           // Completação do job
+        llama_seq_id seq_id = 0;
+        llama_pos pos = 0;          // Posição do próximo token
+        int32_t logits_index = -1;  // Linha dos logits no último batch (-1 = prompt_logits)
+        bool done = false;
+    };
+    struct Active {
+        DecodeJob* job = nullptr;
+        std::vector<llama_seq_id> seq_ids;
+        int cells = 0;
+    };
+
+    void loop();
+    // Restaura as gerações pendentes que couberem, dentro do limite de bytes por passo
+    // (trava mutex_ por dentro).
+    void admit();
+    void remove_pending(DecodeJob* job);
+    // Termina o job: libera as sequências e as células e acorda quem espera por ele.
+    void finish(Active& active, bool ok, const std::string& error);
+    bool apply_loras(const std::vector<std::pair<llama_adapter_lora*, float>>& loras);
+
+    llama_context* ctx_;
+    const llama_vocab* vocab_;
+    int n_vocab_ = 0;
+    DecodeFunction decode_;
+    std::atomic<int32_t>& kv_used_cells_;
+    size_t restore_bytes_per_step_;
+    SlotTable slots_;                // Só a thread do escalonador usa
+    // Primeiro da fila esperando as gerações com outros adaptadores LoRA terminarem, e
+    // quantas gerações compatíveis já passaram na frente dele.
+    const DecodeJob* blocked_head_ = nullptr;
+    int overtaken_ = 0;
+    std::vector<std::pair<llama_adapter_lora*, float>> applied_loras_;
+    std::vector<Active> active_;
+    std::vector<Sequence> sequences_;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;  // Há job novo (ou pedido de parada)
+    std::condition_variable done_cv_;  // Algum job terminou
+    std::deque<DecodeJob*> pending_;
+    std::vector<DecodeJob*> finished_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_DECODE_SCHEDULER_HPP
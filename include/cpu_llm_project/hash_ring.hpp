@@ -0,0 +1,38 @@
+#ifndef CPU_LLM_PROJECT_HASH_RING_HPP
+#define CPU_LLM_PROJECT_HASH_RING_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cpu_llm_project {
+
+// Hashing consistente: cada nó ocupa vários pontos ("nós virtuais") num anel de 64 bits
+// e uma chave pertence ao primeiro ponto a partir do seu hash. Adicionar ou remover um
+// nó só move as chaves daquele nó, então a afinidade das demais é preservada.
+// Não é thread-safe; o roteador monta o anel uma vez e só o consulta depois.
+class HashRing {
+public:
+    explicit HashRing(int virtual_nodes = 160);
+
+    void add_node(int node_id);
+    void remove_node(int node_id);
+    bool empty() const { return ring_.empty(); }
+
+    // Nó dono da chave; -1 se o anel estiver vazio.
+    int node_for(const std::string& key) const;
+    // Todos os nós distintos, na ordem em que aparecem no anel a partir da chave.
+    // O primeiro é node_for(key); os seguintes servem de alternativa estável.
+    std::vector<int> nodes_for(const std::string& key) const;
+
+private:
+    static uint64_t hash(const std::string& value);
+
+    int virtual_nodes_;
+    std::map<uint64_t, int> ring_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_HASH_RING_HPP
@@ -0,0 +1,31 @@
+#ifndef CPU_LLM_PROJECT_LLAMA_LOG_HPP
+#define CPU_LLM_PROJECT_LLAMA_LOG_HPP
+
+#include "ggml.h" // ggml_log_callback
+
+namespace cpu_llm_project {
+namespace llama_log {
+
+// O callback de log do llama.cpp é global ao processo e a API não tem como lê-lo de volta
+// (em todas as versões suportadas). Quem o troca passa por aqui, para que uma troca
+// temporária (ex.: a quantização, que lê o progresso pelo log) devolva o anterior.
+void set_callback(ggml_log_callback callback, void* user_data);
+
+// Troca o callback durante a vida do objeto e restaura o que estava antes.
+class ScopedCallback {
+public:
+    ScopedCallback(ggml_log_callback callback, void* user_data);
+    ~ScopedCallback();
+
+    ScopedCallback(const ScopedCallback&) = delete;
+    ScopedCallback& operator=(const ScopedCallback&) = delete;
+
+private:
+    ggml_log_callback previous_callback_ = nullptr;
+    void* previous_user_data_ = nullptr;
+};
+
+} // namespace llama_log
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_LLAMA_LOG_HPP
@@ -4,11 +4,18 @@
 #include <string>
 #include <vector>
 #include <functional> // Para std::function, se usarmos callbacks no futuro
+#include <memory>     // Para std::shared_ptr (instância de modelo trocável a quente)
+#include <mutex>
+#include <atomic>
 
 // Forward declarações para tipos do llama.cpp para evitar incluir headers do llama aqui diretamente
 // se possível, ou apenas incluir o header principal 'llama.h' se for leve e necessário.
 #include "llama.h" // Incluir o header principal do llama.cpp
 
+#include "cpu_llm_project/response_cache.hpp"
+#include "cpu_llm_project/memory_stats.hpp"
+#include "cpu_llm_project/compute_pool.hpp"
+
 // Não precisamos mais das forward declarations se incluirmos llama.h
 // struct llama_model; // Já vem de llama.h
 // struct llama_context; // Já vem de llama.h
@@ -16,6 +23,94 @@
 
 namespace cpu_llm_project {
 
+// Adaptador LoRA carregado uma vez junto com o modelo base (lora_adapters no YAML).
+struct LoraAdapterSpec {
+    std::string name;   // Usado pelas requisições para escolher o adaptador
+    std::string path;   // GGUF do adaptador
+    float scale = 1.0f; // Escala padrão
+};
+
+// Adaptador aplicado numa geração: o nome de um LoraAdapterSpec carregado e a escala.
+struct LoraSelection {
+    std::string name;
+    float scale = 1.0f;
+};
+
+// Parâmetros usados para carregar um modelo e criar seu contexto.
+struct ModelLoadParams {
+    std::string model_path;
+    int n_ctx = 2048;
+    int n_gpu_layers = 0; // Mantido por compatibilidade com a API do llama.cpp; 0 para CPU.
+    int num_threads = 0;  // 0 = lógica padrão (hardware_concurrency).
+    int max_sequences = 4; // Sequências simultâneas no contexto (limite de GenerationParams::n).
+    int n_batch = 512;     // Tokens por llama_decode (pedaços do prompt)
+    int n_ubatch = 512;    // Micro-batch computado de cada vez (<= n_batch)
+    std::string kv_cache_type = "f16"; // Tipo do cache KV: f16, bf16, q8_0, q4_0 ou f32
+    bool flash_attn = false; // Exigido pelo llama.cpp para cache V quantizado
+    // Pools de threads de computação compartilhados (veja compute_pool.hpp).
+    int prefill_threads = 0;       // Threads para prompts/batches; 0 = num_threads
+    int decode_threads = 0;        // Threads para passos de um token; 0 = num_threads
+    uint32_t threadpool_poll = 50; // Espera ativa das threads ociosas (0-100)
+    bool threadpool_partition = false; // Prefill e decode em CPUs disjuntas
+    // Prompts num contexto próprio (pool de prefill) e geração em outro (pool de decode),
+    // com o cache KV de cada prompt transferido entre eles; veja decode_scheduler.hpp.
+    bool disaggregate_prefill = false;
+    std::vector<LoraAdapterSpec> lora_adapters; // Carregados sobre o modelo base, compartilhado
+};
+
+// Converte o nome de ModelLoadParams::kv_cache_type ("f16", "q8_0"...) para o tipo do ggml.
+bool parse_kv_cache_type(const std::string& name, ggml_type& type);
+
+// Parâmetros de amostragem de uma geração.
+struct GenerationParams {
+    int max_tokens = 128;
+    float temperature = 0.8f;
+    int top_k = 40;
+    float top_p = 0.9f;
+    float repeat_penalty = 1.1f;
+    uint32_t seed = LLAMA_DEFAULT_SEED; // LLAMA_DEFAULT_SEED = seed aleatória a cada geração
+    bool use_cache = true;              // false ignora o cache de respostas nesta geração
+    int n = 1;                          // Número de completações do mesmo prompt (predict_n)
+    std::vector<LoraSelection> lora_adapters; // Adaptadores desta geração; vazio = só o modelo base
+
+    // Gerações determinísticas (greedy ou seed fixa) podem ser servidas do cache de respostas.
+    bool is_deterministic() const { return temperature <= 0.0f || seed != LLAMA_DEFAULT_SEED; }
+};
+
+// Par (prompt, continuação) pontuado por score(): a log-verossimilhança da continuação
+// dado o prompt.
+struct ScoreItem {
+    std::string prompt;
+    std::string continuation;
+};
+
+struct ScoreParams {
+    int top_logprobs = 0;               // Alternativas mais prováveis por posição (0 = nenhuma)
+    bool chat_template = false;         // Envolve o prompt no mesmo template de predict()
+    std::string system_prompt;          // Só com chat_template
+    std::vector<LoraSelection> lora_adapters;
+};
+
+struct TokenLogprob {
+    llama_token id = 0;
+    std::string text;
+    float logprob = 0.0f;
+    std::vector<std::pair<std::string, float>> top; // (texto, logprob), do mais provável ao menos
+};
+
+struct ScoreResult {
+    std::vector<TokenLogprob> tokens;   // Um por token da continuação
+    double total_logprob = 0.0;
+    std::string error;                  // Não vazio se este item não pôde ser pontuado
+};
+
+struct ScoreBatch {
+    std::vector<ScoreResult> results;   // Na ordem dos itens
+    std::string error;                  // Não vazio se a requisição inteira falhou
+    int decode_calls = 0;               // Chamadas a llama_decode usadas
+    int evaluated_tokens = 0;           // Tokens enviados ao modelo (prompts comuns contam uma vez)
+};
+
 class LlmEngine {
 public:
     LlmEngine();
@@ -25,10 +120,16 @@ public:
     // n_gpu_layers é incluído para compatibilidade com a API do llama.cpp, mas será 0 para CPU.
     // num_threads = 0 indica para usar a lógica padrão (hardware_concurrency com limite).
     bool load_model(const std::string& model_path, int n_ctx = 2048, int n_gpu_layers = 0, int num_threads = 0);
+    bool load_model(const ModelLoadParams& params);
     void unload_model();
 
+    // Carrega um novo modelo sem interromper o atendimento: as requisições em andamento
+    // terminam no modelo antigo, as novas passam a usar o novo, e o antigo é liberado
+    // quando a última requisição que o usa termina. Se o novo modelo falhar ao carregar,
+    // o modelo atual continua em uso e false é retornado.
+    bool reload_model(const ModelLoadParams& params);
+
     // Gera texto a partir de um prompt.
-    // Os parâmetros de amostragem são incluídos para uso futuro quando a amostragem avançada for restaurada.
     std::string predict(const std::string& user_prompt,
                         const std::string& system_prompt = "", // System prompt opcional
                         int max_tokens = 128,
@@ -36,6 +137,25 @@ public:
                         int top_k = 40,
                         float top_p = 0.9f,
                         float repeat_penalty = 1.1f);
+    std::string predict(const std::string& user_prompt,
+                        const std::string& system_prompt,
+                        const GenerationParams& params);
+
+    // Gera params.n completações do mesmo prompt. O prompt é processado uma única vez,
+    // a sequência é copiada no cache KV para n seq_ids e as n continuações são decodificadas
+    // juntas, um batch por passo. Em caso de erro, retorna um único elemento "[Error: ...]".
+    // Com disaggregate_prefill, só o prompt ocupa o contexto de prefill; a geração divide
+    // os passos de decode com as demais requisições ativas.
+    std::vector<std::string> predict_n(const std::string& user_prompt,
+                                       const std::string& system_prompt,
+                                       const GenerationParams& params);
+
+    // Log-probabilidades das continuações. Os itens são empacotados como sequências
+    // distintas do mesmo batch (até max_sequences por vez), itens com o mesmo prompt
+    // compartilham os tokens do prompt, e só as posições que precedem um token da
+    // continuação pedem logits. Com max_sequences >= número de itens e tudo cabendo em
+    // n_batch, a requisição inteira é um único llama_decode.
+    ScoreBatch score(const std::vector<ScoreItem>& items, const ScoreParams& params);
 
     // Callback para streaming de tokens, se implementarmos no futuro
     // using token_callback = std::function<void(const std::string& token)>;
@@ -43,15 +163,58 @@ public:
 
     bool is_model_loaded() const;
     std::string get_model_path() const; // Getter para o model_path
+    int get_max_sequences() const;      // Maior n aceito por predict_n (0 sem modelo)
+    std::vector<LoraAdapterSpec> get_lora_adapters() const; // Adaptadores carregados com o modelo atual
+
+    // Cache LRU de respostas para gerações determinísticas. 0 bytes desabilita (padrão).
+    // O cache é esvaziado quando o modelo é trocado por reload_model().
+    void set_response_cache_capacity(size_t capacity_bytes);
+    ResponseCache::Stats get_response_cache_stats() const;
+
+    // Limite de memória para modelos + contextos. Antes de carregar, o consumo do novo
+    // modelo é estimado pelo cabeçalho GGUF e somado ao das instâncias vivas (numa troca
+    // a quente, a antiga convive com a nova até as requisições terminarem); se passar do
+    // orçamento, o carregamento é recusado e get_last_error() explica o motivo. 0 = sem limite.
+    void set_memory_budget(size_t budget_bytes);
+    // Memória por componente de cada instância viva e RSS do processo.
+    MemoryReport get_memory_report() const;
+    // Motivo da última falha de load_model()/reload_model().
+    std::string get_last_error() const;
 
 private:
-    llama_model* model_ = nullptr;
-    llama_context* ctx_ = nullptr;
+    // Modelo + contexto carregados juntos; definido em llm_engine.cpp.
+    // Cada requisição segura um shared_ptr para a instância que está usando, o que
+    // permite trocar o modelo atual sem invalidar as requisições em andamento.
+    struct ModelInstance;
+
+    static std::shared_ptr<ModelInstance> create_instance(const ModelLoadParams& params,
+                                                          const std::shared_ptr<ComputePools>& pools,
+                                                          std::string& error);
+    // Pools atuais se as opções não mudaram; senão, novos (os antigos seguem vivos enquanto
+    // alguma instância os usar).
+    std::shared_ptr<ComputePools> pools_for(const ModelLoadParams& params, std::string& error) const;
+    std::shared_ptr<ModelInstance> acquire_instance() const;
+    using LoraList = std::vector<std::pair<llama_adapter_lora*, float>>;
+    // Resolve os nomes pedidos entre os adaptadores carregados com a instância.
+    static bool resolve_loras(const ModelInstance& instance, const std::vector<LoraSelection>& selections,
+                              LoraList& loras, std::string& error);
+    // Aplica o conjunto ao contexto (ctx_mutex da instância precisa estar travado).
+    static bool apply_loras(ModelInstance& instance, const LoraList& loras);
+    bool check_memory_budget(const ModelLoadParams& params, std::string& error) const;
+    void set_last_error(const std::string& error);
+
+    std::shared_ptr<ModelInstance> instance_;
+    // Instâncias substituídas que ainda podem estar atendendo requisições (para o relatório de memória).
+    std::vector<std::weak_ptr<ModelInstance>> retired_instances_;
+    mutable std::mutex instance_mutex_; // Protege apenas a troca/leitura de instance_ e retired_instances_.
+
+    std::shared_ptr<ComputePools> pools_; // Pools da instância atual (protegido por instance_mutex_)
+
+    std::atomic<size_t> memory_budget_bytes_{0};
+    std::string last_error_;
+    mutable std::mutex error_mutex_;
 
-    std::string model_path_;
-    int n_ctx_ = 0;
-    // Adicionar mais parâmetros conforme necessário (n_threads, n_batch, etc.)
-    // int n_threads = 4; // Exemplo
+    ResponseCache response_cache_;
 
     // A função de callback estática para logs do llama.cpp será definida no .cpp
     // e usará ggml_log_level diretamente. Não precisa ser membro da classe.
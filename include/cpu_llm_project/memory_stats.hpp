@@ -0,0 +1,95 @@
+#ifndef CPU_LLM_PROJECT_MEMORY_STATS_HPP
+#define CPU_LLM_PROJECT_MEMORY_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace cpu_llm_project {
+
+// Memória de um modelo carregado e do seu contexto, por componente.
+struct MemoryUsage {
+    std::string model_path;
+    int n_ctx = 0;
+    bool active = true;                  // false = instância antiga terminando requisições após uma troca
+    size_t weights_bytes = 0;            // Tensores do modelo (mapeados do arquivo via mmap)
+    size_t weights_resident_bytes = 0;   // Parte dos pesos de fato na RAM (0 se não disponível)
+    size_t lora_bytes = 0;               // Adaptadores LoRA carregados junto com o modelo
+    size_t kv_allocated_bytes = 0;       // Cache KV alocado para n_ctx células
+    size_t kv_used_bytes = 0;            // Células ocupadas ao fim da última geração
+    size_t compute_bytes = 0;            // Buffers de computação e de saída (logits) do contexto
+
+    // Pior caso: todos os pesos residentes.
+    size_t total_bytes() const { return weights_bytes + lora_bytes + kv_allocated_bytes + compute_bytes; }
+};
+
+struct MemoryReport {
+    std::vector<MemoryUsage> models;     // A instância ativa primeiro
+    size_t process_rss_bytes = 0;        // RSS do processo inteiro (0 se não disponível)
+    size_t budget_bytes = 0;             // 0 = sem orçamento
+};
+
+// Previsão do que um modelo vai ocupar, calculada a partir do cabeçalho GGUF sem carregá-lo.
+struct MemoryEstimate {
+    size_t weights_bytes = 0;
+    size_t lora_bytes = 0;
+    size_t kv_bytes = 0;
+    size_t compute_bytes = 0;            // Aproximado: logits + matriz de atenção de um batch
+
+    size_t total_bytes() const { return weights_bytes + lora_bytes + kv_bytes + compute_bytes; }
+};
+
+namespace memory_stats {
+
+// RSS do processo (Linux: /proc/self/statm). 0 em outras plataformas.
+size_t process_rss_bytes();
+
+// Arquivo mapeado, identificado como em /proc/self/smaps: dispositivo (major << 32 | minor)
+// e inode. Ao contrário do caminho, continua valendo quando o arquivo é apagado ou
+// substituído por outro no mesmo caminho (o smaps passa a mostrar "caminho (deleted)").
+struct MappedFileId {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+
+    bool valid() const { return inode != 0; }
+    bool operator==(const MappedFileId& other) const { return device == other.device && inode == other.inode; }
+};
+
+// Dispositivo e inode do arquivo em path (Linux: stat). false se não der para ler.
+bool mapped_file_id(const std::string& path, MappedFileId& id);
+
+// Bytes residentes dos mapeamentos do arquivo (Linux: /proc/self/smaps). Mapeamentos do
+// mesmo trecho do arquivo (ex.: duas instâncias do mesmo modelo) dividem as páginas do
+// page cache e contam uma vez só.
+size_t mapped_file_resident_bytes(const MappedFileId& id);
+
+// O mesmo, a partir do conteúdo de um smaps (separado para os testes).
+size_t smaps_resident_bytes(std::istream& smaps, const MappedFileId& id);
+
+// Cache KV em f16 (o tipo padrão do llama.cpp) para n_ctx células.
+size_t kv_cache_bytes(size_t n_ctx, size_t n_layer, size_t n_head_kv, size_t head_dim_k, size_t head_dim_v);
+
+// Lê os metadados e o tamanho dos tensores do GGUF. Retorna false e preenche error se o
+// arquivo não puder ser lido ou faltar algum hiperparâmetro necessário.
+bool estimate_model_memory(const std::string& model_path, int n_ctx, int n_batch,
+                           MemoryEstimate& estimate, std::string& error);
+
+enum class BufferKind {
+    Kv,
+    Compute
+};
+
+// Interpreta as linhas de log do llama.cpp que informam buffers alocados
+// (ex.: "CPU KV buffer size = 416.00 MiB", "CPU compute buffer size = 300.01 MiB").
+bool parse_buffer_log_line(const char* text, BufferKind& kind, size_t& bytes);
+
+// Formata bytes em MiB com uma casa decimal, para mensagens de erro e logs.
+std::string format_mib(size_t bytes);
+
+} // namespace memory_stats
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_MEMORY_STATS_HPP
@@ -0,0 +1,73 @@
+#ifndef CPU_LLM_PROJECT_QUANTIZER_HPP
+#define CPU_LLM_PROJECT_QUANTIZER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpu_llm_project {
+
+// Conversão de um GGUF (f16/bf16/f32 ou já quantizado, com allow_requantize) para outro
+// tipo de quantização, usando a API de quantização do llama.cpp.
+struct QuantizeOptions {
+    std::string input_path;
+    std::string output_path;
+    std::string type = "Q4_K_M";    // Nome como no llama.cpp: Q4_K_M, Q5_K_M, Q8_0...
+    int threads = 0;                // 0 = todas as CPUs disponíveis
+    std::string imatrix_path;       // Matriz de importância (imatrix.dat ou .gguf), opcional
+    bool allow_requantize = false;  // Aceita entrada já quantizada (perde qualidade)
+    bool leave_output_tensor = false; // Mantém output.weight sem quantizar
+    bool pure = false;              // Sem as exceções por tensor das misturas _K_S/_K_M
+};
+
+struct QuantizeProgress {
+    int current = 0;                // 1..total
+    int total = 0;
+    std::string tensor_name;
+};
+
+struct QuantizeResult {
+    size_t input_bytes = 0;
+    size_t output_bytes = 0;
+    double seconds = 0.0;
+    int tensors = 0;
+    size_t imatrix_entries = 0;     // Tensores com dados de importância (0 = sem imatrix)
+
+    // Vazão da conversão, em MiB de entrada por segundo.
+    double input_mib_per_second() const;
+};
+
+// Dados por tensor no formato que llama_model_quantize_params::imatrix espera.
+using ImatrixData = std::unordered_map<std::string, std::vector<float>>;
+
+namespace quantizer {
+
+// Nomes aceitos em QuantizeOptions::type, na ordem em que aparecem na ajuda.
+std::vector<std::string> supported_types();
+
+// Converte o nome (sem diferenciar maiúsculas) para o llama_ftype correspondente.
+bool parse_quant_type(const std::string& name, int& ftype);
+
+// Tipos de 1-2 bits que o llama.cpp só quantiza com uma matriz de importância.
+bool requires_imatrix(const std::string& name);
+
+// Reconhece a linha "[  12/ 291]  blk.0.attn_q.weight - [...]" que o llama.cpp registra
+// ao começar cada tensor.
+bool parse_progress_line(const char* text, QuantizeProgress& progress);
+
+// Lê uma matriz de importância gerada pelo llama-imatrix, no formato legado (.dat) ou GGUF.
+// Os valores já saem normalizados pelo número de chamadas, como o llama.cpp espera.
+bool load_imatrix(const std::string& path, ImatrixData& data, std::string& error);
+
+// Bloqueia até o fim da conversão. on_progress é chamado a cada tensor, na thread chamadora.
+// O backend (llama_backend_init/llama_backend_free) é do chamador, e o callback de log
+// anterior é restaurado ao fim: dá para quantizar num processo que também serve um modelo.
+bool quantize_model(const QuantizeOptions& options, QuantizeResult& result, std::string& error,
+                    const std::function<void(const QuantizeProgress&)>& on_progress = {});
+
+} // namespace quantizer
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_QUANTIZER_HPP
@@ -0,0 +1,78 @@
+#ifndef CPU_LLM_PROJECT_RESPONSE_CACHE_HPP
+#define CPU_LLM_PROJECT_RESPONSE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace cpu_llm_project {
+
+// Constrói a chave do cache a partir dos campos que determinam a resposta
+// (caminho do modelo, tokens do prompt, parâmetros de amostragem, seed).
+// Usa FNV-1a de 64 bits; a chance de colisão é desprezível para o tamanho do cache.
+class CacheKeyBuilder {
+public:
+    CacheKeyBuilder& add_bytes(const void* data, size_t size);
+    CacheKeyBuilder& add(const std::string& value);
+
+    template <typename T>
+    CacheKeyBuilder& add_value(const T& value) {
+        return add_bytes(&value, sizeof(value));
+    }
+
+    uint64_t key() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ULL; // FNV offset basis
+};
+
+// Cache LRU de respostas em memória, limitado por bytes.
+// Thread-safe. Capacidade 0 desabilita o cache.
+class ResponseCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t capacity_bytes = 0;
+    };
+
+    explicit ResponseCache(size_t capacity_bytes = 0);
+
+    // Reduzir a capacidade descarta as entradas menos usadas; 0 esvazia e desabilita o cache.
+    void set_capacity(size_t capacity_bytes);
+    bool enabled() const;
+
+    // Retorna true e preenche value em caso de acerto (a entrada passa a ser a mais recente).
+    bool lookup(uint64_t key, std::string& value);
+    // Entradas maiores que a capacidade total são ignoradas.
+    void insert(uint64_t key, const std::string& value);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    // Custo aproximado de cada entrada além do texto (nó da lista + bucket do mapa).
+    static constexpr size_t kEntryOverhead = 96;
+
+    using Entry = std::pair<uint64_t, std::string>;
+    using EntryList = std::list<Entry>;
+
+    void evict_until_fits(size_t incoming_bytes); // Requer mutex_ travado
+
+    EntryList lru_; // Mais recente no início
+    std::unordered_map<uint64_t, EntryList::iterator> index_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_RESPONSE_CACHE_HPP
@@ -0,0 +1,98 @@
+#ifndef CPU_LLM_PROJECT_ROUTER_HPP
+#define CPU_LLM_PROJECT_ROUTER_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu_llm_project/api_server.hpp" // ServerOptions (front end HTTP do próprio roteador)
+#include "cpu_llm_project/hash_ring.hpp"
+
+// Forward declaration para classes do cpp-httplib
+namespace httplib {
+    class Server;
+    struct Request;
+    struct Response;
+}
+
+namespace cpu_llm_project {
+
+// Modo roteador: um endpoint na frente de N processos do motor ("workers"), cada um com
+// o seu modelo e contexto. Gerações são distribuídas por hashing consistente do corpo da
+// requisição, para que uma repetição idêntica caia no worker que já tem a resposta no cache;
+// se esse worker estiver saturado ou fora do ar, vai para o próximo livre. O resto (score,
+// "cache": false) vai direto para o menos ocupado.
+struct RouterOptions {
+    std::string host = "localhost";
+    int port = 8080;                   // 0 = uma porta livre escolhida pelo sistema (ver Router::port)
+    ServerOptions server;
+
+    // Workers já em execução: "unix:/caminho/do.sock" ou "host:porta".
+    std::vector<std::string> worker_addresses;
+
+    // Workers iniciados pelo próprio roteador (0 = nenhum). Cada um recebe uma fatia das CPUs,
+    // dentro de um mesmo nó NUMA quando possível, e escuta num Unix socket em socket_dir.
+    int spawn_workers = 0;
+    std::vector<std::string> worker_command; // argv base (executável + config); o roteador acrescenta host/porta/socket/threads
+    std::string socket_dir = "/tmp";
+
+    int max_inflight_per_worker = 2;   // Acima disso o worker é considerado saturado
+    int health_interval_ms = 1000;
+    int restart_after_failures = 5;    // Health checks seguidos com falha antes de reiniciar um worker iniciado aqui
+    int startup_grace_sec = 300;       // Tempo para um worker recém-iniciado carregar o modelo
+    time_t request_timeout_sec = 600;  // Gerações longas podem levar minutos
+};
+
+class Router {
+public:
+    explicit Router(const RouterOptions& options);
+    ~Router();
+
+    bool start(); // Inicia/conecta os workers e bloqueia atendendo até stop().
+    void stop();
+
+    // Porta em que o roteador escuta (a escolhida pelo sistema se options.port for 0);
+    // 0 até start() conseguir o bind.
+    int port() const { return port_; }
+
+private:
+    struct Worker;
+
+    void setup_routes();
+    bool spawn_worker(Worker& worker);
+    void stop_workers();
+    void health_loop();
+    void check_worker(Worker& worker);
+
+    // Escolhe o worker para a chave de roteamento e já reserva uma vaga nele (inflight + 1,
+    // que o chamador devolve); nullptr se nenhum estiver saudável.
+    Worker* pick_worker(const std::string& routing_key, bool& affinity_hit);
+    void forward(Worker& worker, const httplib::Request& req, httplib::Response& res, bool& connection_failed);
+    void proxy_request(const httplib::Request& req, httplib::Response& res);
+    void broadcast_reload(const httplib::Request& req, httplib::Response& res);
+    void get_metrics(const httplib::Request& req, httplib::Response& res);
+    void get_ps(const httplib::Request& req, httplib::Response& res);
+
+    RouterOptions options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    HashRing ring_;
+    std::unique_ptr<httplib::Server> server_;
+
+    std::thread health_thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<int> port_{0};
+    std::mutex spawn_mutex_; // Serializa (re)inícios de workers
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> affinity_hits_{0};
+    std::atomic<uint64_t> fallbacks_{0};       // Roteadas para outro worker (saturação ou falha)
+    std::atomic<uint64_t> balanced_{0};        // Sem chave de afinidade: para o menos ocupado
+    std::atomic<uint64_t> unavailable_{0};     // Respondidas com 503 (nenhum worker saudável)
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_ROUTER_HPP
@@ -0,0 +1,81 @@
+#ifndef CPU_LLM_PROJECT_SAMPLER_HPP
+#define CPU_LLM_PROJECT_SAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+
+#include "llama.h" // llama_token, LLAMA_DEFAULT_SEED
+
+namespace cpu_llm_project {
+
+// Kernels vetorizados usados pelo Sampler. A implementação (escalar, AVX, AVX2+FMA ou
+// AVX-512F) é escolhida uma vez em tempo de execução, conforme a CPU; o resto do projeto
+// continua compilado apenas com -mavx.
+namespace sampling_kernels {
+
+struct Candidate {
+    llama_token id;
+    float logit;
+};
+
+// Nome do conjunto de instruções selecionado ("avx512f", "avx2", "avx" ou "scalar").
+const char* backend_name();
+
+float max_value(const float* values, size_t n);
+size_t argmax(const float* values, size_t n);
+
+// out[i] = exp((in[i] - max_value) * scale); retorna a soma de out. in e out podem ser o mesmo buffer.
+float exp_shifted(const float* in, float* out, size_t n, float max_value, float scale);
+
+// log(sum(exp(values))), calculado de forma estável a partir do máximo; logprob de um
+// token = logit - log_sum_exp. scratch precisa de espaço para n floats.
+float log_sum_exp(const float* values, size_t n, float* scratch);
+
+// Os k maiores valores de logits (sem ordem definida). Varre o vetor comparando blocos
+// inteiros contra o menor candidato atual, então só os poucos valores que entram no
+// top-k passam pelo heap.
+void select_top_k(const float* logits, size_t n, size_t k, std::vector<Candidate>& out);
+
+} // namespace sampling_kernels
+
+struct SamplingParams {
+    float temperature = 0.8f;
+    int top_k = 40;
+    float top_p = 0.9f;
+    float repeat_penalty = 1.1f;
+    int penalty_last_n = 256;           // Janela de tokens recentes penalizados
+    uint32_t seed = LLAMA_DEFAULT_SEED; // LLAMA_DEFAULT_SEED = seed aleatória
+};
+
+// Amostrador de tokens sobre os logits do llama.cpp.
+// Ordem: penalidade de repetição -> (greedy se temperature <= 0) -> top-k -> softmax com
+// temperatura -> top-p -> sorteio. A penalidade só toca os tokens que estão na janela
+// recente, e o softmax roda apenas sobre os candidatos que sobraram do top-k.
+class Sampler {
+public:
+    explicit Sampler(const SamplingParams& params);
+
+    // Registra um token (do prompt ou gerado) na janela de penalidade.
+    void accept(llama_token token);
+
+    // Escolhe o próximo token. Os logits são modificados no lugar (penalidades).
+    llama_token sample(float* logits, int n_vocab);
+
+private:
+    void apply_penalties(float* logits, int n_vocab) const;
+
+    SamplingParams params_;
+    std::mt19937 rng_;
+    std::deque<llama_token> recent_tokens_;
+    std::unordered_map<llama_token, int> recent_counts_; // Tokens distintos da janela
+    std::vector<sampling_kernels::Candidate> candidates_;
+    std::vector<float> probs_;
+};
+
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_SAMPLER_HPP
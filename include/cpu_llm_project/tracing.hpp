@@ -0,0 +1,104 @@
+#ifndef CPU_LLM_PROJECT_TRACING_HPP
+#define CPU_LLM_PROJECT_TRACING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cpu_llm_project {
+namespace tracing {
+
+// Rastreamento por requisição. Os spans são gravados em ring buffers por thread (sem
+// alocação no caminho quente) e, ao fim de uma requisição amostrada, exportados por uma
+// thread em segundo plano para um arquivo JSON no formato Chrome trace-event
+// (chrome://tracing, Perfetto) ou OTLP/JSON.
+// Spans de um trace ainda não exportado que o ring sobrescreveu aparecem no arquivo como
+// "dropped_spans". Sem trace ativo na thread, criar um Span custa uma leitura de thread_local.
+
+enum class ExportFormat {
+    ChromeTrace,
+    Otlp
+};
+
+struct Config {
+    double sample_rate = 0.0;           // Fração das requisições rastreadas (0 = só as forçadas)
+    std::string output_dir = "./traces";
+    ExportFormat format = ExportFormat::ChromeTrace;
+    size_t ring_capacity = 4096;        // Spans guardados por thread antes de sobrescrever
+    bool allow_forced = true;           // false = o header "X-Trace: 1" é ignorado (só a amostragem)
+    size_t max_files = 100;             // Arquivos trace-* mantidos em output_dir; os mais antigos são apagados (0 = sem limite)
+};
+
+void configure(const Config& config);
+Config current_config();
+
+// "chrome" ou "otlp"; retorna false para outros valores.
+bool parse_export_format(const std::string& name, ExportFormat& format);
+
+// Bloqueia até a thread exportadora gravar todos os traces já encerrados.
+void flush();
+
+// Id do trace ativo na thread atual (0 se nenhum).
+uint64_t current_trace_id();
+// Id do span aberto mais interno na thread atual (a raiz do trace, se nenhum; 0 sem trace).
+uint64_t current_span_id();
+
+// Inicia um trace para a requisição corrente nesta thread, se ela for amostrada
+// (pela taxa configurada ou por force, se Config::allow_forced). Ao ser destruído,
+// enfileira o trace para exportação, a menos que defer_export() tenha sido chamado.
+class TraceScope {
+public:
+    TraceScope(const char* root_name, bool force);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    bool active() const { return trace_id_ != 0; }
+    uint64_t trace_id() const { return trace_id_; }
+
+    // Adia a exportação para finish_trace(), para incluir trabalho que acontece depois
+    // que o escopo termina (ex.: a escrita da resposta HTTP).
+    void defer_export() { deferred_ = true; }
+
+private:
+    uint64_t trace_id_ = 0;
+    uint64_t root_span_id_ = 0;
+    uint64_t previous_trace_id_ = 0;
+    uint64_t previous_span_id_ = 0;
+    int64_t start_ns_ = 0;
+    const char* root_name_;
+    bool deferred_ = false;
+};
+
+// Grava um span final que vai do fim do TraceScope adiado até agora e enfileira o trace.
+void finish_trace(uint64_t trace_id, const char* final_span_name);
+
+// Span RAII. Não faz nada se não houver trace ativo na thread.
+// name deve ter duração estática (literal de string).
+class Span {
+public:
+    explicit Span(const char* name, int64_t value = -1);
+    // Grava no trace indicado, como filho de parent_span_id, para trabalho feito em outra
+    // thread em nome da requisição (ids obtidos com current_trace_id/current_span_id).
+    Span(uint64_t trace_id, uint64_t parent_span_id, const char* name, int64_t value = -1);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    uint64_t trace_id_ = 0;
+    uint64_t span_id_ = 0;
+    uint64_t parent_id_ = 0;
+    uint64_t previous_span_id_ = 0;
+    int64_t start_ns_ = 0;
+    int64_t value_ = -1;
+    const char* name_ = nullptr;
+    bool on_current_thread_ = false;
+};
+
+} // namespace tracing
+} // namespace cpu_llm_project
+
+#endif // CPU_LLM_PROJECT_TRACING_HPP
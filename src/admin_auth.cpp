@@ -0,0 +1,37 @@
+#include "cpu_llm_project/admin_auth.hpp"
+
+namespace cpu_llm_project {
+
+namespace {
+
+// Compara sem sair no primeiro byte diferente, para o tempo não revelar o prefixo certo.
+bool constant_time_equals(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) { return false; }
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+} // namespace
+
+bool authorize_admin_request(const std::string& admin_token, const std::string& authorization_header,
+                             bool via_unix_socket, int& status, std::string& error) {
+    if (via_unix_socket) { return true; }
+    if (admin_token.empty()) {
+        status = 403;
+        error = "Admin routes are only available on the Unix socket unless admin_token is configured.";
+        return false;
+    }
+    static const std::string scheme = "Bearer ";
+    if (authorization_header.compare(0, scheme.size(), scheme) != 0 ||
+        !constant_time_equals(authorization_header.substr(scheme.size()), admin_token)) {
+        status = 401;
+        error = "Missing or invalid admin token.";
+        return false;
+    }
+    return true;
+}
+
+} // namespace cpu_llm_project
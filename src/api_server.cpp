@@ -1,5 +1,8 @@
 #include "cpu_llm_project/api_server.hpp"
+#include "cpu_llm_project/admin_auth.hpp"
+#include "cpu_llm_project/connection_queue.hpp"
 #include "cpu_llm_project/llm_engine.hpp" // Definição completa do LlmEngine
+#include "cpu_llm_project/tracing.hpp"
 
 // Definir CPPHTTPLIB_OPENSSL_SUPPORT ou CPPHTTPLIB_ZLIB_SUPPORT aqui se necessário
 // ANTES de incluir httplib.h, e garantir que as bibliotecas estejam linkadas.
@@ -11,6 +14,15 @@
 #include <thread>   // Para std::thread, se rodarmos o servidor em background
 #include <chrono>   // Para timestamps
 #include <iomanip>  // Para std::put_time
+#include <algorithm>
+#include <cstdlib>  // Para std::strtoull
+#include <cerrno>
+#include <cstdio>   // Para std::remove (arquivo do Unix socket)
+#include <cstring>  // Para std::memcpy, std::strerror
+#include <sys/socket.h> // Para AF_UNIX
+#include <sys/stat.h>
+#include <sys/un.h>     // Para sockaddr_un
+#include <unistd.h>     // Para close
 
 // Para conveniência
 using json = nlohmann::json;
@@ -30,25 +42,158 @@ std::string get_iso_timestamp() {
     return ss.str();
 }
 
+namespace {
 
-ApiServer::ApiServer(LlmEngine& engine, const std::string& host, int port)
-    : engine_(engine), host_(host), port_(port) {
+// Um Unix socket que já existe no caminho só é apagado se ninguém atender nele (sobra de
+// uma execução que morreu sem removê-lo). Outro servidor vivo no mesmo caminho, ou um
+// arquivo que não é socket, é erro: apagá-lo roubaria o endereço de quem está nele.
+bool remove_stale_unix_socket(const std::string& path, std::string& error) {
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0) { return true; } // Não existe
+    if (!S_ISSOCK(st.st_mode)) {
+        error = path + " exists and is not a socket";
+        return false;
+    }
+    sockaddr_un addr = {};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "Unix socket path too long: " + path;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("socket() failed: ") + std::strerror(errno);
+        return false;
+    }
+    const bool in_use = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    const int connect_errno = errno;
+    ::close(fd);
+    if (in_use) {
+        error = "another server is already listening on " + path;
+        return false;
+    }
+    if (connect_errno == ENOENT) { return true; } // Removido entre o lstat e o connect
+    if (connect_errno != ECONNREFUSED) {
+        error = "cannot check Unix socket " + path + ": " + std::strerror(connect_errno);
+        return false;
+    }
+    if (std::remove(path.c_str()) != 0) {
+        error = "cannot remove stale Unix socket " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Lê o campo "lora" (nomes ou {"name", "scale"}) contra os adaptadores carregados.
+bool parse_lora_selections(const json& lora_json, const std::vector<LoraAdapterSpec>& available,
+                           std::vector<LoraSelection>& selections, std::string& error) {
+    if (!lora_json.is_array()) {
+        error = "'lora' must be an array of adapter names or {\"name\", \"scale\"} objects";
+        return false;
+    }
+    std::vector<LoraSelection> parsed;
+    for (const json& item : lora_json) {
+        LoraSelection selection;
+        if (item.is_string()) {
+            selection.name = item.get<std::string>();
+        } else if (item.is_object() && item.contains("name") && item["name"].is_string()) {
+            selection.name = item["name"].get<std::string>();
+        } else {
+            error = "Invalid entry in 'lora': expected a name or {\"name\", \"scale\"}";
+            return false;
+        }
+        auto it = std::find_if(available.begin(), available.end(),
+                               [&](const LoraAdapterSpec& adapter) { return adapter.name == selection.name; });
+        if (it == available.end()) {
+            error = "Unknown LoRA adapter '" + selection.name + "'";
+            return false;
+        }
+        selection.scale = it->scale;
+        if (item.is_object() && item.contains("scale")) {
+            // value() lançaria json::type_error (500) com um scale que não é número.
+            if (!item["scale"].is_number()) {
+                error = "'scale' of LoRA adapter '" + selection.name + "' must be a number";
+                return false;
+            }
+            selection.scale = item["scale"].get<float>();
+        }
+        parsed.push_back(selection);
+    }
+    selections = parsed;
+    return true;
+}
+
+} // namespace
+
+ApiServer::ApiServer(LlmEngine& engine, const std::string& host, int port, const ServerOptions& options)
+    : engine_(engine), options_(options), host_(host), port_(port) {
     server_ = std::make_unique<httplib::Server>();
-    setup_routes();
+    configure_server(*server_);
+    setup_routes(*server_, false);
+
+    if (!options_.unix_socket_path.empty()) {
+        unix_server_ = std::make_unique<httplib::Server>();
+        unix_server_->set_address_family(AF_UNIX);
+        configure_server(*unix_server_);
+        setup_routes(*unix_server_, true);
+    }
 }
 
 ApiServer::~ApiServer() {
     stop(); // Garante que o servidor pare se estiver rodando.
 }
 
-void ApiServer::setup_routes() {
-    if (!server_) return;
+void ApiServer::configure_server(httplib::Server& server) {
+    // 0 fica com o padrão do próprio httplib (max(8, núcleos - 1)): uma geração longa
+    // ocupa uma thread, e em máquinas pequenas o número de núcleos deixaria /health na fila.
+    const size_t threads = options_.worker_threads > 0 ? static_cast<size_t>(options_.worker_threads) : 0;
+    server.new_task_queue = [this, threads]() -> httplib::TaskQueue* {
+        return new BoundedConnectionQueue(threads, options_.max_queued, options_.max_connections,
+                                          counters_.accepted, counters_.rejected,
+                                          counters_.active, counters_.peak_active);
+    };
+
+    server.set_read_timeout(options_.read_timeout_sec);
+    server.set_write_timeout(options_.write_timeout_sec);
+    server.set_keep_alive_timeout(options_.keep_alive_timeout_sec);
+    server.set_keep_alive_max_count(options_.keep_alive_max_requests);
+    if (options_.payload_max_bytes > 0) {
+        server.set_payload_max_length(options_.payload_max_bytes);
+    }
 
-    server_->Post("/api/generate", [this](const httplib::Request& req, httplib::Response& res) {
+    // O logger do httplib roda depois que a resposta foi escrita no socket: é aí que os
+    // traces adiados por post_generate ganham o span "response_write" e são exportados.
+    server.set_logger([this](const httplib::Request& /*req*/, const httplib::Response& res) {
+        counters_.requests.fetch_add(1);
+        if (!res.has_header("X-Trace-Id")) { return; }
+        const std::string trace_id = res.get_header_value("X-Trace-Id");
+        tracing::finish_trace(std::strtoull(trace_id.c_str(), nullptr, 16), "response_write");
+    });
+}
+
+void ApiServer::setup_routes(httplib::Server& server, bool via_unix_socket) {
+    server.Post("/api/generate", [this](const httplib::Request& req, httplib::Response& res) {
         this->post_generate(req, res);
     });
 
-    server_->Get("/health", [](const httplib::Request& /*req*/, httplib::Response& res) {
+    server.Post("/api/score", [this](const httplib::Request& req, httplib::Response& res) {
+        this->post_score(req, res);
+    });
+
+    server.Post("/api/admin/reload", [this, via_unix_socket](const httplib::Request& req, httplib::Response& res) {
+        this->post_admin_reload(req, res, via_unix_socket);
+    });
+
+    server.Get("/api/metrics", [this](const httplib::Request& req, httplib::Response& res) {
+        this->get_metrics(req, res);
+    });
+
+    server.Get("/api/ps", [this](const httplib::Request& req, httplib::Response& res) {
+        this->get_ps(req, res);
+    });
+
+    server.Get("/health", [](const httplib::Request& /*req*/, httplib::Response& res) {
         json response_json;
         response_json["status"] = "ok";
         res.set_content(response_json.dump(), "application/json");
@@ -66,12 +211,52 @@ bool ApiServer::start() {
         return true;
     }
 
-    std::cout << "ApiServer: Starting to listen on http://" << host_ << ":" << port_ << " ..." << std::endl;
+    // O listener do Unix socket roda numa thread própria; o TCP continua bloqueando esta.
+    std::thread unix_thread;
+    if (unix_server_) {
+        const std::string& path = options_.unix_socket_path;
+        std::string error;
+        if (!remove_stale_unix_socket(path, error)) {
+            std::cerr << "ApiServer::start: " << error << std::endl;
+            return false;
+        }
+        // Com AF_UNIX, o httplib usa o "host" como caminho do socket e ignora a porta.
+        if (!unix_server_->bind_to_port(path, 80)) {
+            std::cerr << "ApiServer::start: Failed to bind Unix socket " << path << std::endl;
+            return false;
+        }
+        // Só o usuário do servidor conecta: pelo Unix socket as rotas administrativas não
+        // pedem token. Entre o bind e o chmod o arquivo tem o modo dado pelo umask; para
+        // fechar essa janela, use um diretório acessível só a esse usuário.
+        if (::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+            std::cerr << "ApiServer::start: Failed to chmod Unix socket " << path << ": " << std::strerror(errno) << std::endl;
+            std::remove(path.c_str());
+            return false;
+        }
+        std::cout << "ApiServer: Listening on unix:" << path << std::endl;
+        unix_thread = std::thread([this]() { unix_server_->listen_after_bind(); });
+    }
 
-    // Rodar o servidor de forma bloqueante nesta thread.
-    // Para rodar em background, precisaríamos de std::thread e um mecanismo de parada mais robusto.
-    if (!server_->listen(host_.c_str(), port_)) {
+    // Porta 0: o sistema escolhe uma livre, exposta por port().
+    const int port = port_ == 0 ? server_->bind_to_any_port(host_)
+                                : (server_->bind_to_port(host_, port_) ? port_ : -1);
+    bool listened = false;
+    if (port > 0) {
+        bound_port_ = port;
+        std::cout << "ApiServer: Starting to listen on http://" << host_ << ":" << port << " ..." << std::endl;
+        // Rodar o servidor de forma bloqueante nesta thread.
+        listened = server_->listen_after_bind();
+    }
+    if (!listened) {
         std::cerr << "ApiServer::start: Failed to listen on " << host_ << ":" << port_ << std::endl;
+    }
+
+    if (unix_thread.joinable()) {
+        unix_server_->stop();
+        unix_thread.join();
+        std::remove(options_.unix_socket_path.c_str());
+    }
+    if (!listened) {
         return false;
     }
     // Se listen() retornar, o servidor parou (ou falhou ao iniciar).
@@ -80,6 +265,9 @@ bool ApiServer::start() {
 }
 
 void ApiServer::stop() {
+    if (unix_server_ && unix_server_->is_running()) {
+        unix_server_->stop();
+    }
     if (server_ && server_->is_running()) {
         std::cout << "ApiServer: Stopping server..." << std::endl;
         server_->stop();
@@ -87,9 +275,31 @@ void ApiServer::stop() {
     }
 }
 
+void ApiServer::set_persona_defaults(const std::string& system_prompt, const GenerationParams& params) {
+    std::lock_guard<std::mutex> lock(defaults_mutex_);
+    default_system_prompt_ = system_prompt;
+    default_params_ = params;
+}
+
+void ApiServer::set_reload_handler(ReloadHandler handler) {
+    std::lock_guard<std::mutex> lock(defaults_mutex_);
+    reload_handler_ = std::move(handler);
+}
+
 void ApiServer::post_generate(const httplib::Request& req, httplib::Response& res) {
+    // Requisições com o header "X-Trace: 1" são sempre rastreadas; as demais seguem a
+    // taxa de amostragem configurada (trace_sample_rate).
+    tracing::TraceScope trace("post_generate", req.get_header_value("X-Trace") == "1");
+    if (trace.active()) {
+        char trace_id[17];
+        snprintf(trace_id, sizeof(trace_id), "%016llx", static_cast<unsigned long long>(trace.trace_id()));
+        res.set_header("X-Trace-Id", trace_id);
+        trace.defer_export();
+    }
+
     json request_json;
     try {
+        tracing::Span span("json_parse", static_cast<int64_t>(req.body.size()));
         request_json = json::parse(req.body);
     } catch (json::parse_error& e) {
         res.status = 400; // Bad Request
@@ -124,34 +334,81 @@ void ApiServer::post_generate(const httplib::Request& req, httplib::Response& re
 
     std::string prompt = request_json["prompt"].get<std::string>();
 
-    // Parâmetros de amostragem (com padrões do LlmEngine ou da requisição)
-    int max_tokens = request_json.value("max_tokens", 128);
-    float temp = request_json.value("temperature", 0.8f);
-    int top_k = request_json.value("top_k", 40);
-    float top_p = request_json.value("top_p", 0.9f);
-    float repeat_penalty = request_json.value("repeat_penalty", 1.1f);
+    // Cópia dos padrões da persona: uma recarga concorrente não afeta esta requisição.
+    GenerationParams params;
+    std::string system_prompt_req;
+    {
+        std::lock_guard<std::mutex> lock(defaults_mutex_);
+        params = default_params_;
+        system_prompt_req = default_system_prompt_;
+    }
+
+    // Parâmetros de amostragem (com padrões da persona ou da requisição)
+    params.max_tokens = request_json.value("max_tokens", params.max_tokens);
+    params.temperature = request_json.value("temperature", params.temperature);
+    params.top_k = request_json.value("top_k", params.top_k);
+    params.top_p = request_json.value("top_p", params.top_p);
+    params.repeat_penalty = request_json.value("repeat_penalty", params.repeat_penalty);
+    params.seed = request_json.value("seed", params.seed);
+    params.use_cache = request_json.value("cache", params.use_cache);
+    params.n = request_json.value("n", 1);
+    if (params.n < 1 || params.n > engine_.get_max_sequences()) {
+        res.status = 400;
+        json error_json = {{"error", "'n' must be between 1 and " + std::to_string(engine_.get_max_sequences()) +
+                                     " (max_sequences of the loaded model)"}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+    // "lora": lista de nomes ou de {"name", "scale"} entre os adaptadores da persona;
+    // [] usa só o modelo base. Ausente = adaptadores padrão da persona.
+    if (request_json.contains("lora") && !request_json["lora"].is_null()) {
+        std::string lora_error;
+        if (!parse_lora_selections(request_json["lora"], engine_.get_lora_adapters(), params.lora_adapters, lora_error)) {
+            res.status = 400;
+            json error_json = {{"error", lora_error}};
+            res.set_content(error_json.dump(), "application/json");
+            return;
+        }
+    }
     // bool stream = request_json.value("stream", false); // Streaming não implementado ainda
-    std::string system_prompt_req = request_json.value("system_prompt", ""); // Novo campo opcional
+    system_prompt_req = request_json.value("system_prompt", system_prompt_req); // Campo opcional
 
     std::cout << "ApiServer::post_generate: Received prompt: \"" << prompt << "\"" << std::endl;
     if (!system_prompt_req.empty()) {
         std::cout << "ApiServer::post_generate: Using system prompt: \"" << system_prompt_req << "\"" << std::endl;
     }
     // Passar o system_prompt para engine_.predict()
-    // Se system_prompt_req estiver vazio, o LlmEngine usará seu próprio padrão (se houver) ou nada.
-    std::string generated_text = engine_.predict(prompt,
-                                                 system_prompt_req,
-                                                 max_tokens,
-                                                 temp,
-                                                 top_k,
-                                                 top_p,
-                                                 repeat_penalty);
+    // Se system_prompt_req estiver vazio, nenhum system prompt é usado.
+    // Com n > 1 o prompt é processado uma vez e as n completações são decodificadas juntas.
+    std::vector<std::string> completions = engine_.predict_n(prompt, system_prompt_req, params);
+    // Erros vêm como um único "[Error: ...]" e nunca saem como texto gerado com 200. Um
+    // prompt + n * max_tokens maior que o contexto é erro do cliente; o resto, do servidor.
+    const std::string kErrorPrefix = "[Error: ";
+    if (completions.size() == 1 && completions.front().rfind(kErrorPrefix, 0) == 0) {
+        std::string message = completions.front().substr(kErrorPrefix.size());
+        if (!message.empty() && message.back() == ']') { message.pop_back(); }
+        res.status = message.find("exceed the context") != std::string::npos ? 400 : 500;
+        json error_json = {{"error", message}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+    const std::string& generated_text = completions.front();
     std::cout << "ApiServer::post_generate: Generated response: \"" << generated_text << "\"" << std::endl;
 
     json response_data;
     response_data["model"] = engine_.get_model_path(); // Usa o getter
     response_data["created_at"] = get_iso_timestamp();
     response_data["response"] = generated_text;
+    if (!params.lora_adapters.empty()) {
+        json lora_json = json::array();
+        for (const LoraSelection& selection : params.lora_adapters) {
+            lora_json.push_back({{"name", selection.name}, {"scale", selection.scale}});
+        }
+        response_data["lora"] = lora_json;
+    }
+    if (params.n > 1) {
+        response_data["responses"] = completions;
+    }
     response_data["done"] = true; // Para compatibilidade com API Ollama (non-streaming)
     // TODO: Adicionar "total_duration", "load_duration", "prompt_eval_duration", "eval_duration" como Ollama faz.
     // response_data["context"] = ...; // Para follow-up se não for streaming
@@ -160,4 +417,282 @@ void ApiServer::post_generate(const httplib::Request& req, httplib::Response& re
     res.status = 200;
 }
 
+// Log-verossimilhança de continuações dado um prompt (reranking/classificação), sem gerar texto.
+// Corpo: {"items": [{"prompt", "continuation"}, ...]} ou {"prompt", "continuations": [...]}.
+void ApiServer::post_score(const httplib::Request& req, httplib::Response& res) {
+    tracing::TraceScope trace("post_score", req.get_header_value("X-Trace") == "1");
+    if (trace.active()) {
+        char trace_id[17];
+        snprintf(trace_id, sizeof(trace_id), "%016llx", static_cast<unsigned long long>(trace.trace_id()));
+        res.set_header("X-Trace-Id", trace_id);
+        trace.defer_export();
+    }
+
+    auto send_error = [&res](int status, const std::string& message) {
+        res.status = status;
+        json error_json = {{"error", message}};
+        res.set_content(error_json.dump(), "application/json");
+    };
+
+    json request_json;
+    try {
+        tracing::Span span("json_parse", static_cast<int64_t>(req.body.size()));
+        request_json = json::parse(req.body);
+    } catch (json::parse_error& e) {
+        send_error(400, "Invalid JSON format: " + std::string(e.what()));
+        return;
+    }
+
+    std::vector<ScoreItem> items;
+    if (request_json.contains("items")) {
+        const json& items_json = request_json["items"];
+        if (!items_json.is_array()) {
+            send_error(400, "'items' must be an array of {\"prompt\", \"continuation\"} objects");
+            return;
+        }
+        for (const json& item : items_json) {
+            if (!item.is_object() || !item.contains("prompt") || !item["prompt"].is_string()
+                || !item.contains("continuation") || !item["continuation"].is_string()) {
+                send_error(400, "Each entry in 'items' needs 'prompt' and 'continuation' strings");
+                return;
+            }
+            items.push_back({item["prompt"].get<std::string>(), item["continuation"].get<std::string>()});
+        }
+    } else if (request_json.contains("prompt") && request_json["prompt"].is_string()
+               && request_json.contains("continuations") && request_json["continuations"].is_array()) {
+        // Forma curta: um prompt e várias continuações candidatas.
+        const std::string prompt = request_json["prompt"].get<std::string>();
+        for (const json& continuation : request_json["continuations"]) {
+            if (!continuation.is_string()) {
+                send_error(400, "'continuations' must be an array of strings");
+                return;
+            }
+            items.push_back({prompt, continuation.get<std::string>()});
+        }
+    } else {
+        send_error(400, "Missing 'items' (array) or 'prompt' + 'continuations' fields in request JSON");
+        return;
+    }
+    if (items.empty()) {
+        send_error(400, "Nothing to score: no items given");
+        return;
+    }
+
+    if (!engine_.is_model_loaded()) {
+        send_error(503, "No model is currently loaded in the engine. Load a model first.");
+        return;
+    }
+
+    ScoreParams params;
+    std::string default_system_prompt;
+    {
+        std::lock_guard<std::mutex> lock(defaults_mutex_);
+        params.lora_adapters = default_params_.lora_adapters;
+        default_system_prompt = default_system_prompt_;
+    }
+    params.top_logprobs = request_json.value("top_logprobs", 0);
+    if (params.top_logprobs < 0 || params.top_logprobs > 20) {
+        send_error(400, "'top_logprobs' must be between 0 and 20");
+        return;
+    }
+    // Por padrão o texto é pontuado cru; com "chat_template" o prompt passa pelo mesmo
+    // template de /api/generate (e pelo system prompt da persona, se não vier outro).
+    params.chat_template = request_json.value("chat_template", false);
+    if (params.chat_template) {
+        params.system_prompt = request_json.value("system_prompt", default_system_prompt);
+    }
+    if (request_json.contains("lora") && !request_json["lora"].is_null()) {
+        std::string lora_error;
+        if (!parse_lora_selections(request_json["lora"], engine_.get_lora_adapters(), params.lora_adapters, lora_error)) {
+            send_error(400, lora_error);
+            return;
+        }
+    }
+
+    ScoreBatch scored = engine_.score(items, params);
+    if (!scored.error.empty()) {
+        send_error(500, scored.error);
+        return;
+    }
+
+    json results_json = json::array();
+    for (const ScoreResult& result : scored.results) {
+        json result_json;
+        if (!result.error.empty()) {
+            result_json["error"] = result.error;
+            results_json.push_back(result_json);
+            continue;
+        }
+        json tokens_json = json::array();
+        for (const TokenLogprob& token : result.tokens) {
+            json token_json = {{"token", token.text}, {"id", token.id}, {"logprob", token.logprob}};
+            if (params.top_logprobs > 0) {
+                json top_json = json::array();
+                for (const auto& alternative : token.top) {
+                    top_json.push_back({{"token", alternative.first}, {"logprob", alternative.second}});
+                }
+                token_json["top_logprobs"] = top_json;
+            }
+            tokens_json.push_back(token_json);
+        }
+        result_json["total_logprob"] = result.total_logprob;
+        result_json["tokens"] = tokens_json;
+        results_json.push_back(result_json);
+    }
+
+    json response_data;
+    response_data["model"] = engine_.get_model_path();
+    response_data["created_at"] = get_iso_timestamp();
+    response_data["results"] = results_json;
+    response_data["decode_calls"] = scored.decode_calls;
+    response_data["evaluated_tokens"] = scored.evaluated_tokens;
+    response_data["done"] = true;
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
+ConnectionStats ApiServer::get_connection_stats() const {
+    ConnectionStats stats;
+    stats.accepted = counters_.accepted.load();
+    stats.rejected = counters_.rejected.load();
+    stats.active = counters_.active.load();
+    stats.peak_active = counters_.peak_active.load();
+    stats.requests = counters_.requests.load();
+    return stats;
+}
+
+void ApiServer::get_metrics(const httplib::Request& /*req*/, httplib::Response& res) {
+    ResponseCache::Stats cache_stats = engine_.get_response_cache_stats();
+    ConnectionStats connection_stats = get_connection_stats();
+    MemoryReport memory = engine_.get_memory_report();
+    size_t weights_bytes = 0, weights_resident_bytes = 0, kv_allocated_bytes = 0, kv_used_bytes = 0, compute_bytes = 0;
+    for (const MemoryUsage& usage : memory.models) {
+        weights_bytes += usage.weights_bytes;
+        weights_resident_bytes += usage.weights_resident_bytes;
+        kv_allocated_bytes += usage.kv_allocated_bytes;
+        kv_used_bytes += usage.kv_used_bytes;
+        compute_bytes += usage.compute_bytes;
+    }
+    json response_data;
+    response_data["memory"] = {
+        {"process_rss_bytes", memory.process_rss_bytes},
+        {"budget_bytes", memory.budget_bytes},
+        {"models_loaded", memory.models.size()},
+        {"weights_bytes", weights_bytes},
+        {"weights_resident_bytes", weights_resident_bytes},
+        {"kv_allocated_bytes", kv_allocated_bytes},
+        {"kv_used_bytes", kv_used_bytes},
+        {"compute_bytes", compute_bytes}
+    };
+    response_data["http"] = {
+        {"connections_accepted", connection_stats.accepted},
+        {"connections_rejected", connection_stats.rejected},
+        {"connections_active", connection_stats.active},
+        {"connections_peak", connection_stats.peak_active},
+        {"requests", connection_stats.requests},
+        {"max_connections", options_.max_connections},
+        {"unix_socket", options_.unix_socket_path}
+    };
+    response_data["response_cache"] = {
+        {"enabled", cache_stats.capacity_bytes > 0},
+        {"hits", cache_stats.hits},
+        {"misses", cache_stats.misses},
+        {"insertions", cache_stats.insertions},
+        {"evictions", cache_stats.evictions},
+        {"entries", cache_stats.entries},
+        {"bytes", cache_stats.bytes},
+        {"capacity_bytes", cache_stats.capacity_bytes}
+    };
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
+// Modelos carregados e sua memória por componente (inspirado no /api/ps do Ollama).
+void ApiServer::get_ps(const httplib::Request& /*req*/, httplib::Response& res) {
+    MemoryReport memory = engine_.get_memory_report();
+    json models = json::array();
+    size_t accounted_resident_bytes = 0;
+    for (const MemoryUsage& usage : memory.models) {
+        models.push_back({
+            {"model", usage.model_path},
+            {"status", usage.active ? "active" : "draining"}, // draining = substituído, terminando requisições
+            {"n_ctx", usage.n_ctx},
+            {"size", usage.total_bytes()},
+            {"memory", {
+                {"weights_bytes", usage.weights_bytes},
+                {"weights_resident_bytes", usage.weights_resident_bytes},
+                {"lora_bytes", usage.lora_bytes},
+                {"kv_allocated_bytes", usage.kv_allocated_bytes},
+                {"kv_used_bytes", usage.kv_used_bytes},
+                {"compute_bytes", usage.compute_bytes}
+            }}
+        });
+        accounted_resident_bytes += usage.weights_resident_bytes + usage.kv_allocated_bytes + usage.compute_bytes;
+    }
+
+    json response_data;
+    response_data["models"] = models;
+    response_data["process_rss_bytes"] = memory.process_rss_bytes;
+    // O que o processo ocupa além dos modelos: servidor, caches, alocador, bibliotecas.
+    response_data["other_bytes"] = memory.process_rss_bytes > accounted_resident_bytes
+        ? memory.process_rss_bytes - accounted_resident_bytes : 0;
+    response_data["budget_bytes"] = memory.budget_bytes;
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
+void ApiServer::post_admin_reload(const httplib::Request& req, httplib::Response& res, bool via_unix_socket) {
+    int status = 0;
+    std::string auth_error;
+    if (!authorize_admin_request(options_.admin_token, req.get_header_value("Authorization"), via_unix_socket,
+                                 status, auth_error)) {
+        res.status = status;
+        json error_json = {{"error", auth_error}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+
+    bool force_model_reload = false;
+    if (!req.body.empty()) {
+        try {
+            force_model_reload = json::parse(req.body).value("reload_model", false);
+        } catch (json::exception& e) {
+            res.status = 400;
+            json error_json = {{"error", "Invalid JSON format: " + std::string(e.what())}};
+            res.set_content(error_json.dump(), "application/json");
+            return;
+        }
+    }
+
+    ReloadHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(defaults_mutex_);
+        handler = reload_handler_;
+    }
+    if (!handler) {
+        res.status = 501; // Not Implemented
+        json error_json = {{"error", "Reload is not available in this server configuration."}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+
+    std::cout << "ApiServer::post_admin_reload: Reload requested (reload_model=" << force_model_reload << ")" << std::endl;
+    std::string message;
+    // O handler pode carregar um modelo novo (demorado); as outras requisições continuam
+    // sendo atendidas pelo modelo atual enquanto isso.
+    if (!handler(force_model_reload, message)) {
+        res.status = 500;
+        json error_json = {{"error", message}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+
+    json response_data;
+    response_data["status"] = "reloaded";
+    response_data["message"] = message;
+    response_data["model"] = engine_.get_model_path();
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
 } // namespace cpu_llm_project
@@ -0,0 +1,360 @@
+#include "cpu_llm_project/autotune.hpp"
+#include "cpu_llm_project/llama_log.hpp"
+#include "cpu_llm_project/compute_pool.hpp"
+#include "cpu_llm_project/llm_engine.hpp" // parse_kv_cache_type
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h> // sysconf
+
+#include "llama.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_LLM_AUTOTUNE_X86 1
+#include <cpuid.h>
+#endif
+
+namespace cpu_llm_project {
+
+namespace {
+
+constexpr double kNegInf = -std::numeric_limits<double>::infinity();
+
+std::string collapse_spaces(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == ' ' && (out.empty() || out.back() == ' ')) { continue; }
+        out += c;
+    }
+    while (!out.empty() && out.back() == ' ') { out.pop_back(); }
+    return out;
+}
+
+std::string cpu_model_name() {
+#if defined(CPU_LLM_AUTOTUNE_X86)
+    unsigned int regs[12] = {0};
+    if (__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3]) && regs[0] >= 0x80000004) {
+        for (unsigned int leaf = 0; leaf < 3; ++leaf) {
+            __get_cpuid(0x80000002 + leaf, &regs[leaf * 4], &regs[leaf * 4 + 1], &regs[leaf * 4 + 2], &regs[leaf * 4 + 3]);
+        }
+        char brand[49] = {0};
+        std::memcpy(brand, regs, sizeof(regs));
+        const std::string name = collapse_spaces(brand);
+        if (!name.empty()) { return name; }
+    }
+#endif
+    // Outras arquiteturas (ou CPUs sem brand string): o que o kernel informar.
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0 || line.rfind("Model", 0) == 0 || line.rfind("Hardware", 0) == 0) {
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos) { return collapse_spaces(line.substr(colon + 2)); }
+        }
+    }
+    return "unknown-cpu";
+}
+
+const char* simd_level() {
+#if defined(CPU_LLM_AUTOTUNE_X86)
+    if (__builtin_cpu_supports("avx512f")) { return "avx512f"; }
+    if (__builtin_cpu_supports("avx2")) { return "avx2"; }
+    if (__builtin_cpu_supports("avx")) { return "avx"; }
+    return "sse";
+#elif defined(__aarch64__)
+    return "neon";
+#else
+    return "generic";
+#endif
+}
+
+// Só mostra erros e avisos do llama.cpp: cada tentativa recria o contexto e o log
+// informativo repetiria as mesmas linhas dezenas de vezes.
+void autotune_log_callback(ggml_log_level level, const char* text, void* /*user_data*/) {
+    if (level == GGML_LOG_LEVEL_ERROR || level == GGML_LOG_LEVEL_WARN) {
+        fprintf(stderr, "[LlamaLog] %s", text);
+        fflush(stderr);
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Mede uma combinação num modelo já carregado.
+TuneMeasurement measure_config(llama_model* model, const AutotuneOptions& options,
+                               const std::vector<llama_token>& tokens, const TuneConfig& config) {
+    TuneMeasurement measurement;
+
+    ggml_type kv_type = GGML_TYPE_F16;
+    if (!parse_kv_cache_type(config.kv_cache_type, kv_type)) {
+        measurement.error = "tipo de cache KV desconhecido";
+        return measurement;
+    }
+    ComputePoolOptions pool_options;
+    pool_options.prefill_threads = config.prefill_threads;
+    pool_options.decode_threads = config.decode_threads;
+    pool_options.poll = options.threadpool_poll;
+    std::shared_ptr<ComputePools> pools = ComputePools::create(pool_options, measurement.error);
+    if (!pools) { return measurement; }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = static_cast<uint32_t>(std::max(options.n_ctx, options.prefill_tokens + options.decode_tokens + 1));
+    ctx_params.n_batch = config.n_batch;
+    ctx_params.n_ubatch = config.n_ubatch;
+    // Mesmo formato de contexto do motor (create_instance): com n_seq_max > 1 o llama.cpp
+    // reserva buffers de saída e grafos maiores, e o melhor n_batch/n_ubatch pode mudar.
+    ctx_params.n_seq_max = static_cast<uint32_t>(std::max(1, options.n_seq_max));
+    ctx_params.kv_unified = true;
+    ctx_params.n_threads = pools->decode_threads();
+    ctx_params.n_threads_batch = pools->prefill_threads();
+    ctx_params.type_k = kv_type;
+    ctx_params.type_v = kv_type;
+    // O bool do YAML vira ligado/desligado explícito (o padrão do llama.cpp é "auto").
+    ctx_params.flash_attn_type = config.flash_attn ? LLAMA_FLASH_ATTN_TYPE_ENABLED : LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    ctx_params.no_perf = true;
+    llama_context* ctx = llama_init_from_model(model, ctx_params);
+    if (!ctx) {
+        measurement.error = "o llama.cpp recusou a combinação";
+        return measurement;
+    }
+    pools->attach(ctx);
+
+    llama_batch batch = llama_batch_init(config.n_batch, 0, 1);
+    auto prefill = [&](int n_tokens) {
+        for (int start = 0; start < n_tokens; start += config.n_batch) {
+            const int end = std::min(start + config.n_batch, n_tokens);
+            batch.n_tokens = 0;
+            for (int i = start; i < end; ++i) {
+                batch.token[batch.n_tokens] = tokens[i % tokens.size()];
+                batch.pos[batch.n_tokens] = i;
+                batch.n_seq_id[batch.n_tokens] = 1;
+                batch.seq_id[batch.n_tokens][0] = 0;
+                batch.logits[batch.n_tokens] = i == n_tokens - 1;
+                batch.n_tokens++;
+            }
+            if (llama_decode(ctx, batch) != 0) { return false; }
+        }
+        return true;
+    };
+    auto decode = [&](int first_pos, int n_steps) {
+        for (int i = 0; i < n_steps; ++i) {
+            batch.n_tokens = 1;
+            batch.token[0] = tokens[(first_pos + i) % tokens.size()];
+            batch.pos[0] = first_pos + i;
+            batch.n_seq_id[0] = 1;
+            batch.seq_id[0][0] = 0;
+            batch.logits[0] = true;
+            if (llama_decode(ctx, batch) != 0) { return false; }
+        }
+        return true;
+    };
+
+    // Aquecimento: páginas do modelo na memória e buffers alocados antes de medir.
+    bool ok = prefill(std::min(options.prefill_tokens, 32)) && decode(std::min(options.prefill_tokens, 32), 2);
+    double best_prefill = std::numeric_limits<double>::infinity();
+    double best_decode = std::numeric_limits<double>::infinity();
+    for (int rep = 0; ok && rep < std::max(1, options.repetitions); ++rep) {
+        llama_memory_clear(llama_get_memory(ctx), true);
+        auto started = std::chrono::steady_clock::now();
+        ok = prefill(options.prefill_tokens);
+        best_prefill = std::min(best_prefill, seconds_since(started));
+        started = std::chrono::steady_clock::now();
+        ok = ok && decode(options.prefill_tokens, options.decode_tokens);
+        best_decode = std::min(best_decode, seconds_since(started));
+    }
+    llama_batch_free(batch);
+    llama_free(ctx);
+
+    if (!ok) {
+        measurement.error = "llama_decode falhou";
+        return measurement;
+    }
+    measurement.ok = true;
+    measurement.prefill_tok_s = options.prefill_tokens / std::max(best_prefill, 1e-9);
+    measurement.decode_tok_s = options.decode_tokens / std::max(best_decode, 1e-9);
+    measurement.ttft_ms = best_prefill * 1000.0;
+    return measurement;
+}
+
+} // namespace
+
+std::string TuneConfig::to_string() const {
+    std::ostringstream out;
+    out << "prefill_threads=" << prefill_threads << " decode_threads=" << decode_threads
+        << " n_batch=" << n_batch << " n_ubatch=" << n_ubatch
+        << " kv=" << kv_cache_type << " flash_attn=" << (flash_attn ? "on" : "off");
+    return out.str();
+}
+
+namespace autotune {
+
+std::string hardware_fingerprint() {
+    // CPUs online da máquina, não as do cpuset do processo: o mesmo servidor rodando num
+    // container com --cpus diferente, ou sob taskset, continua casando com o seu perfil.
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpus < 1) { n_cpus = static_cast<long>(std::max(1u, std::thread::hardware_concurrency())); }
+    return cpu_model_name() + " | " + std::to_string(n_cpus) + " CPUs | " + simd_level();
+}
+
+bool parse_objective(const std::string& name, TuneObjective& objective) {
+    if (name == "decode") { objective = TuneObjective::DecodeThroughput; return true; }
+    if (name == "prefill") { objective = TuneObjective::PrefillThroughput; return true; }
+    if (name == "ttft") { objective = TuneObjective::TimeToFirstToken; return true; }
+    return false;
+}
+
+const char* objective_name(TuneObjective objective) {
+    switch (objective) {
+        case TuneObjective::DecodeThroughput: return "decode";
+        case TuneObjective::PrefillThroughput: return "prefill";
+        case TuneObjective::TimeToFirstToken: return "ttft";
+    }
+    return "decode";
+}
+
+double objective_score(TuneObjective objective, const TuneMeasurement& measurement) {
+    if (!measurement.ok) { return kNegInf; }
+    switch (objective) {
+        case TuneObjective::DecodeThroughput: return measurement.decode_tok_s;
+        case TuneObjective::PrefillThroughput: return measurement.prefill_tok_s;
+        case TuneObjective::TimeToFirstToken: return -measurement.ttft_ms;
+    }
+    return kNegInf;
+}
+
+TuneSearchSpace default_search_space(int n_cpus) {
+    TuneSearchSpace space;
+    n_cpus = std::max(1, n_cpus);
+    for (int quarter = 1; quarter <= 4; ++quarter) {
+        const int threads = std::max(1, n_cpus * quarter / 4);
+        if (std::find(space.threads.begin(), space.threads.end(), threads) == space.threads.end()) {
+            space.threads.push_back(threads);
+        }
+    }
+    space.n_batch = {256, 512, 1024, 2048};
+    space.n_ubatch = {128, 256, 512};
+    space.kv_cache_types = {"f16", "q8_0"};
+    space.flash_attn = {false, true};
+    return space;
+}
+
+TuneConfig coordinate_descent(const TuneSearchSpace& space, const TuneConfig& start, TuneObjective objective,
+                              int max_passes, const MeasureFunction& measure, AutotuneResult& result) {
+    std::map<std::string, TuneMeasurement> seen;
+    auto measured = [&](const TuneConfig& config) -> const TuneMeasurement& {
+        const std::string key = config.to_string();
+        auto it = seen.find(key);
+        if (it == seen.end()) {
+            it = seen.emplace(key, measure(config)).first;
+            result.trials++;
+        }
+        return it->second;
+    };
+
+    // Cada parâmetro é julgado pela métrica da fase que ele afeta: as threads de decode só
+    // mudam a geração, e as de prefill e os batches só o processamento do prompt. Assim,
+    // com objetivo "decode", os parâmetros de prefill ainda saem ajustados (pela vazão de
+    // prefill) em vez de ficarem com o valor que o ruído da medição favoreceu.
+    const TuneObjective prefill_objective =
+        objective == TuneObjective::DecodeThroughput ? TuneObjective::PrefillThroughput : objective;
+    struct Dimension {
+        size_t count;
+        std::function<void(TuneConfig&, size_t)> apply;
+        TuneObjective judged_by;
+    };
+    const std::vector<Dimension> dimensions = {
+        {space.threads.size(), [&](TuneConfig& c, size_t i) { c.decode_threads = space.threads[i]; }, TuneObjective::DecodeThroughput},
+        {space.threads.size(), [&](TuneConfig& c, size_t i) { c.prefill_threads = space.threads[i]; }, prefill_objective},
+        {space.n_batch.size(), [&](TuneConfig& c, size_t i) { c.n_batch = space.n_batch[i]; }, prefill_objective},
+        {space.n_ubatch.size(), [&](TuneConfig& c, size_t i) { c.n_ubatch = space.n_ubatch[i]; }, prefill_objective},
+        {space.kv_cache_types.size(), [&](TuneConfig& c, size_t i) { c.kv_cache_type = space.kv_cache_types[i]; }, objective},
+        {space.flash_attn.size(), [&](TuneConfig& c, size_t i) { c.flash_attn = space.flash_attn[i]; }, objective},
+    };
+
+    TuneConfig best = start;
+    measured(best);
+    for (int pass = 0; pass < std::max(1, max_passes); ++pass) {
+        bool improved = false;
+        for (const Dimension& dimension : dimensions) {
+            for (size_t i = 0; i < dimension.count; ++i) {
+                TuneConfig candidate = best;
+                dimension.apply(candidate, i);
+                if (candidate.n_ubatch > candidate.n_batch) { continue; }
+                const TuneMeasurement& current = measured(best);
+                const TuneMeasurement& trial = measured(candidate);
+                // Uma combinação que roda sempre vence uma que falhou, qualquer que seja a métrica.
+                if (!current.ok ? trial.ok
+                                : objective_score(dimension.judged_by, trial) > objective_score(dimension.judged_by, current)) {
+                    best = candidate;
+                    improved = true;
+                }
+            }
+        }
+        if (!improved) { break; }
+    }
+    result.best = best;
+    result.best_measurement = measured(best);
+    return best;
+}
+
+bool run(const AutotuneOptions& options, AutotuneResult& result, std::string& error,
+         const std::function<void(const TuneConfig&, const TuneMeasurement&)>& on_trial) {
+    result = AutotuneResult();
+    result.fingerprint = hardware_fingerprint();
+    if (options.prefill_tokens < 1 || options.decode_tokens < 1) {
+        error = "prefill_tokens e decode_tokens precisam ser positivos";
+        return false;
+    }
+
+    // Só avisos e erros durante a medição; o callback de quem chamou volta ao fim.
+    llama_log::ScopedCallback log_callback(autotune_log_callback, nullptr);
+    llama_model* model = llama_model_load_from_file(options.model_path.c_str(), llama_model_default_params());
+    if (!model) {
+        error = "falha ao carregar o modelo '" + options.model_path + "'";
+        return false;
+    }
+
+    // Prompt sintético: tokens aleatórios (seed fixa, então toda combinação vê o mesmo),
+    // longe dos ids baixos onde costumam ficar os tokens especiais.
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(std::min(100, n_vocab - 1), n_vocab - 1);
+    std::vector<llama_token> tokens(static_cast<size_t>(options.prefill_tokens + options.decode_tokens));
+    for (llama_token& token : tokens) { token = dist(rng); }
+
+    const int n_cpus = static_cast<int>(ComputePools::available_cpus().size());
+    TuneConfig start; // Equivalente ao comportamento sem ajuste: todas as CPUs, batch 512, f16
+    start.prefill_threads = n_cpus;
+    start.decode_threads = n_cpus;
+
+    coordinate_descent(default_search_space(n_cpus), start, options.objective, options.max_passes,
+                       [&](const TuneConfig& config) {
+                           TuneMeasurement measurement = measure_config(model, options, tokens, config);
+                           if (on_trial) { on_trial(config, measurement); }
+                           return measurement;
+                       },
+                       result);
+
+    llama_model_free(model);
+
+    if (!result.best_measurement.ok) {
+        error = "nenhuma combinação conseguiu rodar: " + result.best_measurement.error;
+        return false;
+    }
+    return true;
+}
+
+} // namespace autotune
+} // namespace cpu_llm_project
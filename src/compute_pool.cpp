@@ -0,0 +1,130 @@
+#include "cpu_llm_project/compute_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "ggml-cpu.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace cpu_llm_project {
+
+namespace {
+
+ggml_threadpool_t new_pool(int n_threads, uint32_t poll, const std::vector<int>& cpus) {
+    ggml_threadpool_params params = ggml_threadpool_params_default(n_threads);
+    params.poll = poll;
+    if (!cpus.empty()) {
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < GGML_MAX_N_THREADS) { params.cpumask[cpu] = true; }
+        }
+        params.strict_cpu = true; // Uma thread por CPU da máscara
+    }
+    return ggml_threadpool_new(&params);
+}
+
+} // namespace
+
+std::vector<int> ComputePools::available_cpus() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        const int n = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < n; ++cpu) { cpus.push_back(cpu); }
+    }
+    return cpus;
+}
+
+std::shared_ptr<ComputePools> ComputePools::create(const ComputePoolOptions& options, std::string& error) {
+    std::shared_ptr<ComputePools> pools(new ComputePools());
+    pools->requested_ = options;
+
+    const std::vector<int> cpus = available_cpus();
+    const int n_cpus = static_cast<int>(cpus.size());
+    pools->prefill_threads_ = std::min(options.prefill_threads > 0 ? options.prefill_threads : n_cpus, GGML_MAX_N_THREADS);
+    pools->decode_threads_ = std::min(options.decode_threads > 0 ? options.decode_threads : n_cpus, GGML_MAX_N_THREADS);
+
+    // Partição: prefill nas primeiras CPUs permitidas, decode nas seguintes. Só faz sentido
+    // se as duas couberem sem se sobrepor; caso contrário as threads ficam sem afinidade.
+    std::vector<int> prefill_cpus, decode_cpus;
+    if (options.partition_cpus) {
+        if (pools->prefill_threads_ + pools->decode_threads_ <= n_cpus) {
+            prefill_cpus.assign(cpus.begin(), cpus.begin() + pools->prefill_threads_);
+            decode_cpus.assign(cpus.begin() + pools->prefill_threads_,
+                               cpus.begin() + pools->prefill_threads_ + pools->decode_threads_);
+            pools->partitioned_ = true;
+        } else {
+            std::cerr << "ComputePools: prefill_threads (" << pools->prefill_threads_ << ") + decode_threads ("
+                      << pools->decode_threads_ << ") > " << n_cpus << " CPUs disponíveis; pools sem partição." << std::endl;
+        }
+    }
+
+    pools->prefill_pool_ = new_pool(pools->prefill_threads_, options.poll, prefill_cpus);
+    pools->decode_pool_ = new_pool(pools->decode_threads_, options.poll, decode_cpus);
+    if (!pools->prefill_pool_ || !pools->decode_pool_) {
+        error = "Falha ao criar os pools de threads de computação (prefill " + std::to_string(pools->prefill_threads_) +
+                ", decode " + std::to_string(pools->decode_threads_) + ").";
+        return nullptr; // O destrutor libera o pool que tiver sido criado.
+    }
+    return pools;
+}
+
+ComputePools::~ComputePools() {
+    if (prefill_pool_) { ggml_threadpool_free(prefill_pool_); }
+    if (decode_pool_) { ggml_threadpool_free(decode_pool_); }
+}
+
+void ComputePools::attach(llama_context* ctx) const {
+    llama_attach_threadpool(ctx, decode_pool_, prefill_pool_);
+}
+
+void ComputePools::attach(llama_context* ctx, Pool pool) const {
+    ggml_threadpool_t tp = pool == Pool::Prefill ? prefill_pool_ : decode_pool_;
+    llama_attach_threadpool(ctx, tp, tp);
+}
+
+void ComputePools::pools_for_batch(int n_tokens, int n_ubatch, bool& uses_prefill, bool& uses_decode) {
+    n_ubatch = std::max(1, n_ubatch);
+    if (n_tokens <= 1 || n_ubatch == 1) {
+        uses_prefill = false;
+        uses_decode = true;
+        return;
+    }
+    uses_prefill = true;
+    // Um batch maior que n_ubatch vira vários micro-batches, e qualquer um deles pode ficar
+    // com um token: não só o último (513 tokens com n_ubatch 512), mas também os do meio
+    // quando o split_equal separa as sequências de um batch com várias.
+    uses_decode = n_tokens > n_ubatch;
+}
+
+void ComputePools::Lease::lock(ComputePools& pools, bool prefill, bool decode) {
+    // Sem partição, os dois pools usam todas as CPUs: um grafo de prefill e outro de decode
+    // ao mesmo tempo teriam o dobro de threads dos núcleos. Então cada Lease trava os dois.
+    if (!pools.partitioned_) { prefill = decode = true; }
+    // Sempre na mesma ordem (prefill, depois decode), para que dois Leases não se travem.
+    if (prefill) { prefill_lock_ = std::unique_lock<std::mutex>(pools.prefill_mutex_); }
+    if (decode) { decode_lock_ = std::unique_lock<std::mutex>(pools.decode_mutex_); }
+}
+
+ComputePools::Lease::Lease(ComputePools& pools, int n_tokens, int n_ubatch) {
+    bool uses_prefill = false, uses_decode = false;
+    pools_for_batch(n_tokens, n_ubatch, uses_prefill, uses_decode);
+    lock(pools, uses_prefill, uses_decode);
+}
+
+ComputePools::Lease::Lease(ComputePools& pools, Pool pool) {
+    lock(pools, pool == Pool::Prefill, pool == Pool::Decode);
+}
+
+} // namespace cpu_llm_project
@@ -0,0 +1,38 @@
+#include "cpu_llm_project/connection_queue.hpp"
+
+namespace cpu_llm_project {
+
+BoundedConnectionQueue::BoundedConnectionQueue(size_t threads, size_t max_queued, size_t max_connections,
+                                               std::atomic<uint64_t>& accepted, std::atomic<uint64_t>& rejected,
+                                               std::atomic<uint64_t>& active, std::atomic<uint64_t>& peak_active)
+    : pool_(threads > 0 ? threads : CPPHTTPLIB_THREAD_POOL_COUNT, max_queued), max_connections_(max_connections),
+      accepted_(accepted), rejected_(rejected), active_(active), peak_active_(peak_active) {}
+
+bool BoundedConnectionQueue::enqueue(std::function<void()> fn) {
+    const uint64_t now_active = active_.fetch_add(1) + 1;
+    if (max_connections_ > 0 && now_active > max_connections_) {
+        active_.fetch_sub(1);
+        rejected_.fetch_add(1);
+        return false;
+    }
+    uint64_t peak = peak_active_.load();
+    while (now_active > peak && !peak_active_.compare_exchange_weak(peak, now_active)) {}
+
+    std::atomic<uint64_t>& active = active_;
+    if (!pool_.enqueue([fn = std::move(fn), &active]() {
+            fn();
+            active.fetch_sub(1);
+        })) {
+        active_.fetch_sub(1);
+        rejected_.fetch_add(1);
+        return false;
+    }
+    accepted_.fetch_add(1);
+    return true;
+}
+
+void BoundedConnectionQueue::shutdown() {
+    pool_.shutdown();
+}
+
+} // namespace cpu_llm_project
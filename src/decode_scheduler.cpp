@@ -0,0 +1,318 @@
+#include "cpu_llm_project/decode_scheduler.hpp"
+#include "cpu_llm_project/tracing.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace cpu_llm_project {
+
+SlotTable::SlotTable(int n_slots, int n_cells)
+    : used_(static_cast<size_t>(std::max(1, n_slots)), false),
+      n_slots_(std::max(1, n_slots)),
+      n_cells_(std::max(0, n_cells)) {}
+
+bool SlotTable::reserve(int n_seqs, int cells, std::vector<llama_seq_id>& seq_ids) {
+    seq_ids.clear();
+    if (n_seqs < 1 || n_seqs > free_slots() || cells > free_cells()) { return false; }
+    for (size_t i = 0; i < used_.size() && static_cast<int>(seq_ids.size()) < n_seqs; ++i) {
+        if (!used_[i]) {
+            used_[i] = true;
+            seq_ids.push_back(static_cast<llama_seq_id>(i));
+        }
+    }
+    used_cells_ += cells;
+    return true;
+}
+
+void SlotTable::release(const std::vector<llama_seq_id>& seq_ids, int cells) {
+    for (llama_seq_id id : seq_ids) {
+        if (id >= 0 && static_cast<size_t>(id) < used_.size()) { used_[id] = false; }
+    }
+    used_cells_ = std::max(0, used_cells_ - cells);
+}
+
+int SlotTable::free_slots() const {
+    return static_cast<int>(std::count(used_.begin(), used_.end(), false));
+}
+
+int32_t kv_cells_in_use(llama_memory_t memory, const std::vector<llama_seq_id>& seq_ids, int32_t n_shared_prefix) {
+    int32_t cells = 0;
+    int32_t live = 0;
+    for (llama_seq_id id : seq_ids) {
+        const llama_pos pos_max = llama_memory_seq_pos_max(memory, id);
+        if (pos_max < 0) { continue; } // Sequência vazia
+        cells += pos_max - llama_memory_seq_pos_min(memory, id) + 1;
+        ++live;
+    }
+    if (live > 1) { cells -= (live - 1) * n_shared_prefix; }
+    return std::max(0, cells);
+}
+
+DecodeScheduler::DecodeScheduler(llama_context* ctx, const llama_vocab* vocab, int n_slots, int n_cells,
+                                 DecodeFunction decode, std::atomic<int32_t>& kv_used_cells,
+                                 size_t restore_bytes_per_step)
+    : ctx_(ctx),
+      vocab_(vocab),
+      n_vocab_(llama_vocab_n_tokens(vocab)),
+      decode_(std::move(decode)),
+      kv_used_cells_(kv_used_cells),
+      restore_bytes_per_step_(restore_bytes_per_step),
+      slots_(n_slots, n_cells) {
+    thread_ = std::thread(&DecodeScheduler::loop, this);
+}
+
+DecodeScheduler::~DecodeScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_one();
+    if (thread_.joinable()) { thread_.join(); }
+}
+
+void DecodeScheduler::run(DecodeJob& job) {
+    job.ok = false;
+    job.error.clear();
+    job.tokens.clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(&job);
+    work_cv_.notify_one();
+    done_cv_.wait(lock, [&] { return std::find(finished_.begin(), finished_.end(), &job) != finished_.end(); });
+    finished_.erase(std::find(finished_.begin(), finished_.end(), &job));
+}
+
+namespace {
+
+void complete(std::mutex& mutex, std::condition_variable& done_cv, std::vector<DecodeJob*>& finished,
+              DecodeJob* job, bool ok, const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->ok = ok;
+        job->error = error;
+        finished.push_back(job);
+    }
+    done_cv.notify_all();
+}
+
+} // namespace
+
+bool DecodeScheduler::apply_loras(const std::vector<std::pair<llama_adapter_lora*, float>>& loras) {
+    if (loras == applied_loras_) { return true; }
+    llama_clear_adapter_lora(ctx_);
+    applied_loras_.clear();
+    for (const auto& lora : loras) {
+        if (llama_set_adapter_lora(ctx_, lora.first, lora.second) != 0) {
+            llama_clear_adapter_lora(ctx_);
+            return false;
+        }
+    }
+    applied_loras_ = loras;
+    return true;
+}
+
+void DecodeScheduler::finish(Active& active, bool ok, const std::string& error) {
+    for (llama_seq_id id : active.seq_ids) {
+        llama_memory_seq_rm(llama_get_memory(ctx_), id, -1, -1);
+    }
+    slots_.release(active.seq_ids, active.cells);
+    sequences_.erase(std::remove_if(sequences_.begin(), sequences_.end(),
+                                    [&](const Sequence& seq) { return seq.job == active.job; }),
+                     sequences_.end());
+    complete(mutex_, done_cv_, finished_, active.job, ok, error);
+}
+
+void DecodeScheduler::remove_pending(DecodeJob* job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.erase(std::find(pending_.begin(), pending_.end(), job));
+}
+
+void DecodeScheduler::admit() {
+    // Só esta thread remove de pending_, e run() só acrescenta no fim: os índices abaixo
+    // continuam válidos entre uma trava e outra.
+    size_t index = 0;
+    size_t restored_bytes = 0;
+    const bool idle = active_.empty(); // Sem sequências ativas, ninguém espera pela restauração
+    for (;;) {
+        DecodeJob* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (index >= pending_.size()) { return; }
+            job = pending_[index];
+        }
+        auto drop = [&](const std::string& error) {
+            remove_pending(job);
+            if (job == blocked_head_) { blocked_head_ = nullptr; }
+            complete(mutex_, done_cv_, finished_, job, false, error);
+        };
+
+        // O último token de cada completação não passa pelo modelo: não ocupa célula.
+        const int n_seqs = static_cast<int>(job->samplers.size());
+        const int cells = job->n_prompt_tokens + n_seqs * std::max(0, job->max_tokens - 1);
+        if (!slots_.fits(n_seqs, cells)) {
+            // Rodar mesmo assim esgotaria o cache no meio e devolveria completações truncadas.
+            drop("prompt + n * max_tokens exceed the decode context");
+            continue;
+        }
+        // Os adaptadores LoRA valem para o contexto inteiro: só gerações com o mesmo
+        // conjunto dividem os passos de decode. Uma geração com outro conjunto espera as
+        // ativas terminarem, mas não segura a fila: as compatíveis atrás dela entram. Para
+        // ela não esperar para sempre, no máximo n_slots gerações passam na sua frente.
+        if (!active_.empty() && job->loras != applied_loras_) {
+            if (index == 0) {
+                if (blocked_head_ != job) {
+                    blocked_head_ = job;
+                    overtaken_ = 0;
+                }
+                if (overtaken_ >= slots_.n_slots()) { return; }
+            }
+            ++index;
+            continue;
+        }
+        // Cada restauração atrasa as sequências ativas: limita os bytes por intervalo.
+        if (!idle && restored_bytes > 0 &&
+            restored_bytes + job->prompt_state.size() > restore_bytes_per_step_) {
+            return;
+        }
+
+        std::vector<llama_seq_id> seq_ids;
+        // Sem células agora: espera alguma geração terminar, sem deixar as menores passarem.
+        if (!slots_.reserve(n_seqs, cells, seq_ids)) { return; }
+        if (!apply_loras(job->loras)) {
+            slots_.release(seq_ids, cells);
+            drop("failed to apply LoRA adapter");
+            continue;
+        }
+
+        size_t restored = 0;
+        {
+            tracing::Span span(job->trace_id, job->parent_span_id, "kv_restore", static_cast<int64_t>(job->prompt_state.size()));
+            restored = llama_state_seq_set_data(ctx_, job->prompt_state.data(), job->prompt_state.size(), seq_ids[0]);
+        }
+        if (restored == 0) {
+            // Células livres suficientes, mas não contíguas: espera alguma geração liberar as suas.
+            llama_memory_seq_rm(llama_get_memory(ctx_), seq_ids[0], -1, -1);
+            slots_.release(seq_ids, cells);
+            if (active_.empty()) {
+                drop("failed to restore the prompt state in the decode context");
+                continue;
+            }
+            return;
+        }
+        restored_bytes += job->prompt_state.size();
+        for (size_t i = 1; i < seq_ids.size(); ++i) {
+            llama_memory_seq_cp(llama_get_memory(ctx_), seq_ids[0], seq_ids[i], -1, -1);
+        }
+        remove_pending(job);
+        if (index > 0) { ++overtaken_; }
+        if (job == blocked_head_) { blocked_head_ = nullptr; }
+        std::vector<uint8_t>().swap(job->prompt_state); // O estado pode ter centenas de MB
+        job->tokens.assign(seq_ids.size(), {});
+        active_.push_back({job, seq_ids, cells});
+        for (size_t i = 0; i < seq_ids.size(); ++i) {
+            Sequence seq;
+            seq.job = job;
+            seq.index = i;
+            seq.seq_id = seq_ids[i];
+            seq.pos = job->n_prompt_tokens;
+            seq.done = job->max_tokens <= 0;
+            sequences_.push_back(seq);
+        }
+    }
+}
+
+void DecodeScheduler::loop() {
+    llama_batch batch = llama_batch_init(slots_.n_slots(), 0, 1);
+    std::vector<float> first_logits;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] { return stop_ || !pending_.empty() || !active_.empty(); });
+            if (stop_) { break; }
+        }
+        admit();
+        if (active_.empty()) { continue; }
+
+        // Um token por sequência ativa. Gerações que acabaram de entrar amostram dos
+        // logits do prompt, calculados no contexto de prefill.
+        batch.n_tokens = 0;
+        for (Sequence& seq : sequences_) {
+            if (seq.done) { continue; }
+            DecodeJob& job = *seq.job;
+            float* logits = nullptr;
+            if (seq.logits_index < 0) {
+                // O Sampler modifica os logits; cada completação amostra de uma cópia.
+                first_logits = job.prompt_logits;
+                logits = first_logits.data();
+            } else {
+                logits = llama_get_logits_ith(ctx_, seq.logits_index);
+            }
+            Sampler& sampler = job.samplers[seq.index];
+            const llama_token token = sampler.sample(logits, n_vocab_);
+            sampler.accept(token);
+            if (llama_vocab_is_eog(vocab_, token)) {
+                seq.done = true;
+                continue;
+            }
+            std::vector<llama_token>& generated = job.tokens[seq.index];
+            generated.push_back(token);
+            if (static_cast<int>(generated.size()) >= job.max_tokens) {
+                seq.done = true; // Não precisa decodificar o último token
+                continue;
+            }
+            seq.logits_index = batch.n_tokens;
+            batch.token[batch.n_tokens] = token;
+            batch.pos[batch.n_tokens] = seq.pos++;
+            batch.n_seq_id[batch.n_tokens] = 1;
+            batch.seq_id[batch.n_tokens][0] = seq.seq_id;
+            batch.logits[batch.n_tokens] = true;
+            batch.n_tokens++;
+        }
+
+        for (size_t i = 0; i < active_.size();) {
+            const DecodeJob* job = active_[i].job;
+            const bool all_done = std::none_of(sequences_.begin(), sequences_.end(),
+                                               [&](const Sequence& seq) { return seq.job == job && !seq.done; });
+            if (all_done) {
+                finish(active_[i], true, std::string());
+                active_.erase(active_.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+
+        if (batch.n_tokens > 0) {
+            // Um span por requisição rastreada: o passo é compartilhado, mas cada trace mostra
+            // quanto do seu tempo de geração foi de decode.
+            std::vector<std::unique_ptr<tracing::Span>> spans;
+            for (const Active& active : active_) {
+                if (active.job->trace_id != 0) {
+                    spans.emplace_back(new tracing::Span(active.job->trace_id, active.job->parent_span_id, "decode_step", batch.n_tokens));
+                }
+            }
+            const int32_t rc = decode_(batch);
+            spans.clear();
+            if (rc != 0) {
+                for (Active& active : active_) { finish(active, false, "llama_decode failed"); }
+                active_.clear();
+            }
+        }
+        int32_t used_cells = 0;
+        for (const Active& active : active_) {
+            used_cells += kv_cells_in_use(llama_get_memory(ctx_), active.seq_ids, active.job->n_prompt_tokens);
+        }
+        kv_used_cells_ = used_cells;
+    }
+
+    for (Active& active : active_) { finish(active, false, "decode scheduler stopped"); }
+    active_.clear();
+    std::deque<DecodeJob*> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(pending_);
+    }
+    for (DecodeJob* job : pending) { complete(mutex_, done_cv_, finished_, job, false, "decode scheduler stopped"); }
+    llama_batch_free(batch);
+}
+
+} // namespace cpu_llm_project
@@ -0,0 +1,55 @@
+#include "cpu_llm_project/hash_ring.hpp"
+#include "cpu_llm_project/response_cache.hpp" // CacheKeyBuilder (FNV-1a)
+
+#include <algorithm>
+
+namespace cpu_llm_project {
+
+HashRing::HashRing(int virtual_nodes) : virtual_nodes_(std::max(1, virtual_nodes)) {}
+
+uint64_t HashRing::hash(const std::string& value) {
+    uint64_t h = CacheKeyBuilder().add(value).key();
+    // Finalizador do splitmix64: o FNV-1a de strings parecidas ("worker-1#0", "worker-1#1")
+    // não se espalha bem pelo anel sem essa mistura.
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void HashRing::add_node(int node_id) {
+    for (int replica = 0; replica < virtual_nodes_; ++replica) {
+        ring_[hash("node-" + std::to_string(node_id) + "#" + std::to_string(replica))] = node_id;
+    }
+}
+
+void HashRing::remove_node(int node_id) {
+    for (auto it = ring_.begin(); it != ring_.end();) {
+        it = it->second == node_id ? ring_.erase(it) : std::next(it);
+    }
+}
+
+int HashRing::node_for(const std::string& key) const {
+    if (ring_.empty()) { return -1; }
+    auto it = ring_.lower_bound(hash(key));
+    return it == ring_.end() ? ring_.begin()->second : it->second;
+}
+
+std::vector<int> HashRing::nodes_for(const std::string& key) const {
+    std::vector<int> nodes;
+    if (ring_.empty()) { return nodes; }
+    auto start = ring_.lower_bound(hash(key));
+    if (start == ring_.end()) { start = ring_.begin(); }
+    auto it = start;
+    do {
+        if (std::find(nodes.begin(), nodes.end(), it->second) == nodes.end()) {
+            nodes.push_back(it->second);
+        }
+        if (++it == ring_.end()) { it = ring_.begin(); }
+    } while (it != start);
+    return nodes;
+}
+
+} // namespace cpu_llm_project
@@ -0,0 +1,39 @@
+#include "cpu_llm_project/llama_log.hpp"
+
+#include <mutex>
+
+#include "llama.h"
+
+namespace cpu_llm_project {
+namespace llama_log {
+
+namespace {
+
+std::mutex g_mutex;
+ggml_log_callback g_callback = nullptr; // nullptr = o padrão do llama.cpp (stderr)
+void* g_user_data = nullptr;
+
+} // namespace
+
+void set_callback(ggml_log_callback callback, void* user_data) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_callback = callback;
+    g_user_data = user_data;
+    llama_log_set(callback, user_data);
+}
+
+ScopedCallback::ScopedCallback(ggml_log_callback callback, void* user_data) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    previous_callback_ = g_callback;
+    previous_user_data_ = g_user_data;
+    g_callback = callback;
+    g_user_data = user_data;
+    llama_log_set(callback, user_data);
+}
+
+ScopedCallback::~ScopedCallback() {
+    set_callback(previous_callback_, previous_user_data_);
+}
+
+} // namespace llama_log
+} // namespace cpu_llm_project
@@ -1,16 +1,39 @@
 #include "cpu_llm_project/llm_engine.hpp"
+#include "cpu_llm_project/sampler.hpp"
+#include "cpu_llm_project/decode_scheduler.hpp"
+#include "cpu_llm_project/tracing.hpp"
+#include "cpu_llm_project/llama_log.hpp"
 #include <iostream>
 #include <vector>
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <cctype>
 #include <string.h>
 #include <thread>
+#include <mutex>
+#include <filesystem>
+#include <map>
 
 #include "llama.h" // Incluir o header principal do llama.cpp diretamente aqui
 
+// Enquanto create_instance() cria um contexto, os tamanhos de buffer que o llama.cpp
+// informa no log são somados aqui (medição real, em vez de estimativa).
+static thread_local cpu_llm_project::MemoryUsage* t_memory_capture = nullptr;
+
 static void LlmEngine_static_llama_log_callback(ggml_log_level level, const char *text, void *user_data) {
     (void)user_data;
+    if (t_memory_capture) {
+        cpu_llm_project::memory_stats::BufferKind kind;
+        size_t bytes = 0;
+        if (cpu_llm_project::memory_stats::parse_buffer_log_line(text, kind, bytes)) {
+            if (kind == cpu_llm_project::memory_stats::BufferKind::Kv) {
+                t_memory_capture->kv_allocated_bytes += bytes;
+            } else {
+                t_memory_capture->compute_bytes += bytes;
+            }
+        }
+    }
     if (level == GGML_LOG_LEVEL_ERROR || level == GGML_LOG_LEVEL_WARN) {
         fprintf(stderr, "[LlamaLog] %s", text);
         fflush(stderr);
@@ -19,8 +42,88 @@ static void LlmEngine_static_llama_log_callback(ggml_log_level level, const char
 
 namespace cpu_llm_project {
 
+bool parse_kv_cache_type(const std::string& name, ggml_type& type) {
+    static const std::pair<const char*, ggml_type> kTypes[] = {
+        {"f16", GGML_TYPE_F16}, {"bf16", GGML_TYPE_BF16}, {"q8_0", GGML_TYPE_Q8_0},
+        {"q4_0", GGML_TYPE_Q4_0}, {"f32", GGML_TYPE_F32},
+    };
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const auto& entry : kTypes) {
+        if (lower == entry.first) {
+            type = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Guarda uma referência fraca à instância substituída, descartando as que já foram liberadas.
+std::atomic<uint64_t> g_next_instance_generation{1};
+
+template <typename Instance>
+void retire_instance(std::vector<std::weak_ptr<Instance>>& retired, const std::shared_ptr<Instance>& instance) {
+    retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                 [](const std::weak_ptr<Instance>& entry) { return entry.expired(); }),
+                  retired.end());
+    if (instance) { retired.push_back(instance); }
+}
+
+} // namespace
+
+struct LlmEngine::ModelInstance {
+    llama_model* model = nullptr;
+    // Contexto dos prompts e de score(); sem disaggregate_prefill, também o da geração.
+    llama_context* ctx = nullptr;
+    // Modo desagregado: contexto da geração, usado só pela thread do escalonador.
+    llama_context* decode_ctx = nullptr;
+    std::unique_ptr<DecodeScheduler> scheduler;
+    std::string model_path;
+    // Única por carregamento (mesmo caminho recarregado = outra geração): entra na chave do
+    // cache de respostas, que não pode servir saídas de um GGUF substituído no lugar.
+    uint64_t generation = 0;
+    int n_ctx = 0;
+    MemoryUsage memory;                     // Preenchido no carregamento
+    memory_stats::MappedFileId model_file;  // GGUF mapeado, para achá-lo no smaps mesmo se substituído
+    std::atomic<int32_t> kv_used_cells{0};  // Atualizado ao fim de cada geração
+    std::shared_ptr<ComputePools> pools;    // Compartilhados com as demais instâncias
+
+    struct LoraAdapter {
+        LoraAdapterSpec spec;
+        llama_adapter_lora* adapter = nullptr;
+    };
+    std::vector<LoraAdapter> lora_adapters;
+    // Adaptadores aplicados ao contexto agora (protegido por ctx_mutex); evita reaplicar
+    // quando requisições seguidas usam o mesmo conjunto.
+    std::vector<std::pair<llama_adapter_lora*, float>> applied_loras;
+    // O llama_context não é thread-safe: as gerações numa mesma instância são serializadas.
+    std::mutex ctx_mutex;
+
+    // llama_decode em ctx com os pools de computação travados (um grafo por vez em cada pool).
+    int32_t decode(llama_batch& batch) {
+        if (decode_ctx) {
+            ComputePools::Lease lease(*pools, ComputePools::Pool::Prefill);
+            return llama_decode(ctx, batch);
+        }
+        ComputePools::Lease lease(*pools, batch.n_tokens, static_cast<int>(llama_n_ubatch(ctx)));
+        return llama_decode(ctx, batch);
+    }
+
+    ~ModelInstance() {
+        scheduler.reset(); // Para a thread antes de liberar o contexto que ela usa
+        if (decode_ctx) { llama_free(decode_ctx); }
+        if (ctx) { llama_free(ctx); }
+        for (LoraAdapter& lora : lora_adapters) {
+            llama_adapter_lora_free(lora.adapter);
+        }
+        if (model) { llama_model_free(model); }
+    }
+};
+
 LlmEngine::LlmEngine() {
-    llama_log_set(LlmEngine_static_llama_log_callback, nullptr);
+    llama_log::set_callback(LlmEngine_static_llama_log_callback, nullptr);
     llama_backend_init();
 }
 
@@ -29,43 +132,324 @@ LlmEngine::~LlmEngine() {
     llama_backend_free();
 }
 
-bool LlmEngine::load_model(const std::string& model_path, int n_ctx_req, int n_gpu_layers, int num_threads_param) {
-    if (is_model_loaded()) { return false; }
-    model_path_ = model_path;
-    n_ctx_ = n_ctx_req > 0 ? n_ctx_req : 2048;
+std::shared_ptr<ComputePools> LlmEngine::pools_for(const ModelLoadParams& params, std::string& error) const {
+    ComputePoolOptions options;
+    options.prefill_threads = params.prefill_threads > 0 ? params.prefill_threads : params.num_threads;
+    options.decode_threads = params.decode_threads > 0 ? params.decode_threads : params.num_threads;
+    options.poll = std::min<uint32_t>(params.threadpool_poll, 100);
+    options.partition_cpus = params.threadpool_partition;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex_);
+        if (pools_ && pools_->requested_options() == options) { return pools_; }
+    }
+    return ComputePools::create(options, error);
+}
+
+std::shared_ptr<LlmEngine::ModelInstance> LlmEngine::create_instance(const ModelLoadParams& params,
+                                                                     const std::shared_ptr<ComputePools>& pools,
+                                                                     std::string& error) {
+    auto instance = std::make_shared<ModelInstance>();
+    instance->pools = pools;
+    instance->model_path = params.model_path;
+    instance->generation = g_next_instance_generation++;
+    instance->n_ctx = params.n_ctx > 0 ? params.n_ctx : 2048;
     llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = n_gpu_layers;
-    model_ = llama_model_load_from_file(model_path_.c_str(), model_params);
-    if (!model_) {
-        llama_model_free(model_);
-        model_ = nullptr;
-        return false;
+    model_params.n_gpu_layers = params.n_gpu_layers;
+    instance->model = llama_model_load_from_file(instance->model_path.c_str(), model_params);
+    if (!instance->model) {
+        error = "Falha ao carregar o modelo '" + params.model_path + "'.";
+        return nullptr;
+    }
+    ggml_type kv_type = GGML_TYPE_F16;
+    if (!parse_kv_cache_type(params.kv_cache_type, kv_type)) {
+        error = "Tipo de cache KV desconhecido: '" + params.kv_cache_type + "' (use f16, bf16, q8_0, q4_0 ou f32).";
+        return nullptr;
     }
     llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = n_ctx_;
-    ctx_params.n_batch = 512;
-    ctx_params.n_threads = num_threads_param > 0 ? num_threads_param : std::thread::hardware_concurrency();
-    ctx_params.n_threads_batch = ctx_params.n_threads;
-    ctx_ = llama_init_from_model(model_, ctx_params);
-    if (!ctx_) {
-        llama_model_free(model_);
-        model_ = nullptr;
+    ctx_params.n_ctx = instance->n_ctx;
+    ctx_params.n_batch = std::max(1, params.n_batch);
+    ctx_params.n_ubatch = std::max(1, std::min(params.n_ubatch, params.n_batch));
+    ctx_params.type_k = kv_type;
+    ctx_params.type_v = kv_type;
+    // O bool do YAML vira ligado/desligado explícito (o padrão do llama.cpp é "auto").
+    ctx_params.flash_attn_type = params.flash_attn ? LLAMA_FLASH_ATTN_TYPE_ENABLED : LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    ctx_params.n_seq_max = std::max(1, params.max_sequences);
+    // Cache KV único para todas as sequências: sem isso o llama.cpp dá a cada uma só
+    // n_ctx / n_seq_max células, e uma geração com n = 1 perderia o resto do contexto.
+    // Também é o que permite um token marcado com várias sequências (prompt comum de score()).
+    ctx_params.kv_unified = true;
+    // As threads vêm dos pools compartilhados, anexados logo após criar o contexto. No modo
+    // desagregado, ctx só processa prompts e fica inteiro no pool de prefill.
+    ctx_params.n_threads = params.disaggregate_prefill ? pools->prefill_threads() : pools->decode_threads();
+    ctx_params.n_threads_batch = pools->prefill_threads();
+
+    MemoryUsage& memory = instance->memory;
+    memory.model_path = params.model_path;
+    memory.weights_bytes = llama_model_size(instance->model);
+    memory_stats::mapped_file_id(params.model_path, instance->model_file);
+
+    // Os adaptadores ficam na instância: o modelo base é carregado uma única vez e cada
+    // requisição escolhe quais aplicar.
+    for (const LoraAdapterSpec& spec : params.lora_adapters) {
+        llama_adapter_lora* adapter = llama_adapter_lora_init(instance->model, spec.path.c_str());
+        if (!adapter) {
+            error = "Falha ao carregar o adaptador LoRA '" + spec.name + "' de '" + spec.path + "'.";
+            return nullptr;
+        }
+        instance->lora_adapters.push_back({spec, adapter});
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(spec.path, ec);
+        memory.lora_bytes += ec ? 0 : static_cast<size_t>(size);
+    }
+    t_memory_capture = &memory;
+    instance->ctx = llama_init_from_model(instance->model, ctx_params);
+    t_memory_capture = nullptr;
+    if (!instance->ctx) {
+        error = "Falha ao criar o contexto (n_ctx " + std::to_string(instance->n_ctx) + ") para '" + params.model_path + "'.";
+        return nullptr; // O destrutor de ModelInstance libera o modelo.
+    }
+    if (!params.disaggregate_prefill) {
+        pools->attach(instance->ctx);
+    } else {
+        // Segundo contexto, com cache KV próprio, só para a geração: passos de um token por
+        // sequência, no pool de decode, sem nunca esperar um prompt longo.
+        pools->attach(instance->ctx, ComputePools::Pool::Prefill);
+        llama_context_params decode_params = ctx_params;
+        decode_params.n_threads = pools->decode_threads();
+        decode_params.n_threads_batch = pools->decode_threads();
+        t_memory_capture = &memory;
+        instance->decode_ctx = llama_init_from_model(instance->model, decode_params);
+        t_memory_capture = nullptr;
+        if (!instance->decode_ctx) {
+            error = "Falha ao criar o contexto de decode (n_ctx " + std::to_string(instance->n_ctx) + ") para '" + params.model_path + "'.";
+            return nullptr;
+        }
+        pools->attach(instance->decode_ctx, ComputePools::Pool::Decode);
+        ModelInstance* raw = instance.get();
+        instance->scheduler.reset(new DecodeScheduler(
+            instance->decode_ctx, llama_model_get_vocab(instance->model),
+            static_cast<int>(llama_n_seq_max(instance->decode_ctx)), static_cast<int>(llama_n_ctx(instance->decode_ctx)),
+            [raw](llama_batch& batch) {
+                ComputePools::Lease lease(*raw->pools, ComputePools::Pool::Decode);
+                return llama_decode(raw->decode_ctx, batch);
+            },
+            instance->kv_used_cells));
+        if (!pools->partitioned()) {
+            std::cerr << "LlmEngine: Aviso: disaggregate_prefill sem threadpool_partition; prefill e decode "
+                      << "disputam os mesmos núcleos e a latência entre tokens pode oscilar." << std::endl;
+        }
+    }
+    memory.n_ctx = static_cast<int>(llama_n_ctx(instance->ctx));
+    if (memory.kv_allocated_bytes == 0) {
+        // O log não trouxe os tamanhos (formato mudou?): estima pelos hiperparâmetros.
+        const int32_t n_head = std::max(1, llama_model_n_head(instance->model));
+        const size_t head_dim = static_cast<size_t>(llama_model_n_embd(instance->model) / n_head);
+        memory.kv_allocated_bytes = memory_stats::kv_cache_bytes(
+            memory.n_ctx, llama_model_n_layer(instance->model), llama_model_n_head_kv(instance->model), head_dim, head_dim);
+        if (instance->decode_ctx) { memory.kv_allocated_bytes *= 2; }
+    }
+    std::cout << "LlmEngine: '" << params.model_path << "' carregado. Memória: pesos "
+              << memory_stats::format_mib(memory.weights_bytes) << ", LoRA "
+              << memory_stats::format_mib(memory.lora_bytes) << " (" << instance->lora_adapters.size() << "), KV "
+              << memory_stats::format_mib(memory.kv_allocated_bytes) << " (n_ctx " << memory.n_ctx << "), buffers "
+              << memory_stats::format_mib(memory.compute_bytes) << "; threads prefill " << pools->prefill_threads()
+              << ", decode " << pools->decode_threads() << (pools->partitioned() ? " (CPUs separadas)" : "")
+              << (instance->decode_ctx ? "; prefill e decode em contextos separados" : "") << std::endl;
+    return instance;
+}
+
+bool LlmEngine::check_memory_budget(const ModelLoadParams& params, std::string& error) const {
+    const size_t budget = memory_budget_bytes_;
+    if (budget == 0) { return true; }
+
+    const int n_ctx = params.n_ctx > 0 ? params.n_ctx : 2048;
+    MemoryEstimate estimate;
+    std::string estimate_error;
+    if (!memory_stats::estimate_model_memory(params.model_path, n_ctx, params.n_batch, estimate, estimate_error)) {
+        error = "Orçamento de memória configurado, mas não foi possível estimar o consumo: " + estimate_error + ".";
+        return false;
+    }
+    for (const LoraAdapterSpec& spec : params.lora_adapters) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(spec.path, ec);
+        estimate.lora_bytes += ec ? 0 : static_cast<size_t>(size);
+    }
+    // A estimativa do cache KV é em f16 (2 bytes por elemento); ajusta para o tipo configurado.
+    ggml_type kv_type = GGML_TYPE_F16;
+    if (parse_kv_cache_type(params.kv_cache_type, kv_type) && kv_type != GGML_TYPE_F16) {
+        estimate.kv_bytes = estimate.kv_bytes / 2 * ggml_row_size(kv_type, 1024) / 1024;
+    }
+    if (params.disaggregate_prefill) {
+        // Dois contextos: cache KV e buffers de computação em dobro.
+        estimate.kv_bytes *= 2;
+        estimate.compute_bytes *= 2;
+    }
+
+    // O novo modelo convive com as instâncias vivas: a atual (numa troca a quente) e as
+    // antigas que ainda terminam requisições.
+    size_t in_use = 0;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex_);
+        if (instance_) { in_use += instance_->memory.total_bytes(); }
+        for (const auto& retired : retired_instances_) {
+            if (auto instance = retired.lock()) { in_use += instance->memory.total_bytes(); }
+        }
+    }
+
+    if (in_use + estimate.total_bytes() > budget) {
+        error = "Orçamento de memória excedido: '" + params.model_path + "' (n_ctx " + std::to_string(n_ctx) +
+                ") precisa de ~" + memory_stats::format_mib(estimate.total_bytes()) +
+                " (pesos " + memory_stats::format_mib(estimate.weights_bytes) +
+                ", LoRA " + memory_stats::format_mib(estimate.lora_bytes) +
+                ", KV " + memory_stats::format_mib(estimate.kv_bytes) +
+                ", buffers " + memory_stats::format_mib(estimate.compute_bytes) +
+                "); em uso: " + memory_stats::format_mib(in_use) +
+                "; orçamento: " + memory_stats::format_mib(budget) + ".";
         return false;
     }
     return true;
 }
 
+void LlmEngine::set_last_error(const std::string& error) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    last_error_ = error;
+}
+
+std::string LlmEngine::get_last_error() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+void LlmEngine::set_memory_budget(size_t budget_bytes) {
+    memory_budget_bytes_ = budget_bytes;
+}
+
+MemoryReport LlmEngine::get_memory_report() const {
+    std::vector<std::shared_ptr<ModelInstance>> instances;
+    bool has_active = false;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex_);
+        has_active = instance_ != nullptr;
+        if (instance_) { instances.push_back(instance_); }
+        for (const auto& retired : retired_instances_) {
+            if (auto instance = retired.lock()) { instances.push_back(std::move(instance)); }
+        }
+    }
+
+    MemoryReport report;
+    report.budget_bytes = memory_budget_bytes_;
+    report.process_rss_bytes = memory_stats::process_rss_bytes();
+    std::vector<memory_stats::MappedFileId> counted_files;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const ModelInstance& instance = *instances[i];
+        MemoryUsage usage = instance.memory;
+        usage.active = has_active && i == 0;
+        // Duas instâncias do mesmo arquivo (recarga no mesmo caminho) dividem as páginas:
+        // só a primeira as conta, para a soma dos modelos não passar do RSS.
+        if (std::find(counted_files.begin(), counted_files.end(), instance.model_file) == counted_files.end()) {
+            usage.weights_resident_bytes = memory_stats::mapped_file_resident_bytes(instance.model_file);
+            counted_files.push_back(instance.model_file);
+        }
+        if (usage.n_ctx > 0) {
+            usage.kv_used_bytes = usage.kv_allocated_bytes / usage.n_ctx * static_cast<size_t>(instance.kv_used_cells.load());
+        }
+        report.models.push_back(std::move(usage));
+    }
+    return report;
+}
+
+std::shared_ptr<LlmEngine::ModelInstance> LlmEngine::acquire_instance() const {
+    std::lock_guard<std::mutex> lock(instance_mutex_);
+    return instance_;
+}
+
+bool LlmEngine::load_model(const std::string& model_path, int n_ctx_req, int n_gpu_layers, int num_threads_param) {
+    ModelLoadParams params;
+    params.model_path = model_path;
+    params.n_ctx = n_ctx_req;
+    params.n_gpu_layers = n_gpu_layers;
+    params.num_threads = num_threads_param;
+    return load_model(params);
+}
+
+bool LlmEngine::load_model(const ModelLoadParams& params) {
+    if (is_model_loaded()) {
+        set_last_error("Já existe um modelo carregado; use reload_model() para trocá-lo.");
+        return false;
+    }
+    std::string error;
+    if (!check_memory_budget(params, error)) {
+        std::cerr << "LlmEngine::load_model: " << error << std::endl;
+        set_last_error(error);
+        return false;
+    }
+    auto pools = pools_for(params, error);
+    auto instance = pools ? create_instance(params, pools, error) : nullptr;
+    if (!instance) {
+        set_last_error(error);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(instance_mutex_);
+    instance_ = std::move(instance);
+    pools_ = std::move(pools);
+    return true;
+}
+
+bool LlmEngine::reload_model(const ModelLoadParams& params) {
+    std::string error;
+    if (!check_memory_budget(params, error)) {
+        std::cerr << "LlmEngine::reload_model: " << error << " Mantendo o modelo atual." << std::endl;
+        set_last_error(error);
+        return false;
+    }
+    // O carregamento acontece fora de instance_mutex_, então predict() continua
+    // atendendo com o modelo atual enquanto o novo é lido do disco.
+    auto pools = pools_for(params, error);
+    auto instance = pools ? create_instance(params, pools, error) : nullptr;
+    if (!instance) {
+        std::cerr << "LlmEngine::reload_model: " << error << " Mantendo o modelo atual." << std::endl;
+        set_last_error(error);
+        return false;
+    }
+    std::shared_ptr<ModelInstance> previous;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex_);
+        previous = std::move(instance_);
+        instance_ = std::move(instance);
+        pools_ = std::move(pools);
+        retire_instance(retired_instances_, previous);
+    }
+    // Respostas do modelo antigo não valem para o novo (o GGUF pode ter sido trocado no mesmo
+    // caminho). A chave já leva a geração da instância; limpar só devolve a memória. Gerações
+    // do modelo antigo ainda em andamento não inserem nada (veja predict_n).
+    response_cache_.clear();
+    // 'previous' é liberado aqui ou, se ainda houver requisições usando o modelo antigo,
+    // quando a última delas terminar.
+    return true;
+}
+
 void LlmEngine::unload_model() {
-    if (ctx_) { llama_free(ctx_); ctx_ = nullptr; }
-    if (model_) { llama_model_free(model_); model_ = nullptr; }
+    std::lock_guard<std::mutex> lock(instance_mutex_);
+    retire_instance(retired_instances_, instance_);
+    instance_.reset();
+    pools_.reset(); // As threads terminam quando a última instância que as usa for liberada
 }
 
 bool LlmEngine::is_model_loaded() const {
-    return model_ != nullptr;
+    return acquire_instance() != nullptr;
 }
 
 std::string LlmEngine::get_model_path() const {
-    return model_path_;
+    auto instance = acquire_instance();
+    return instance ? instance->model_path : std::string();
+}
+
+void LlmEngine::set_response_cache_capacity(size_t capacity_bytes) {
+    response_cache_.set_capacity(capacity_bytes);
+}
+
+ResponseCache::Stats LlmEngine::get_response_cache_stats() const {
+    return response_cache_.stats();
 }
 
 std::string LlmEngine::predict(const std::string& user_prompt,
@@ -75,91 +459,612 @@ std::string LlmEngine::predict(const std::string& user_prompt,
                                int top_k_param,
                                float top_p_param,
                                float repeat_penalty_param) {
-    if (!is_model_loaded()) { return "[Error: Model not loaded]"; }
+    GenerationParams params;
+    params.max_tokens = max_tokens_to_generate;
+    params.temperature = temp_param;
+    params.top_k = top_k_param;
+    params.top_p = top_p_param;
+    params.repeat_penalty = repeat_penalty_param;
+    return predict(user_prompt, system_prompt, params);
+}
+
+std::string LlmEngine::predict(const std::string& user_prompt,
+                               const std::string& system_prompt,
+                               const GenerationParams& params) {
+    GenerationParams single = params;
+    single.n = 1;
+    return predict_n(user_prompt, system_prompt, single).front();
+}
+
+namespace {
 
-    std::string final_prompt_text = "<start_of_turn>user\n" + user_prompt + "<end_of_turn>\n<start_of_turn>model";
+std::string token_to_piece(const llama_vocab* vocab, llama_token token) {
+    char buffer[64];
+    int len = llama_token_to_piece(vocab, token, buffer, sizeof(buffer), 0, true);
+    if (len >= 0) {
+        return std::string(buffer, len);
+    }
+    // Peça maior que o buffer: llama_token_to_piece retorna -(tamanho necessário).
+    std::string piece(-len, '\0');
+    len = llama_token_to_piece(vocab, token, &piece[0], piece.size(), 0, true);
+    return len >= 0 ? piece.substr(0, len) : std::string();
+}
+
+std::string build_chat_prompt(const std::string& user_prompt, const std::string& system_prompt) {
+    std::string text = "<start_of_turn>user\n" + user_prompt + "<end_of_turn>\n<start_of_turn>model";
     if (!system_prompt.empty()) {
-        final_prompt_text = system_prompt + "\n" + final_prompt_text;
+        text = system_prompt + "\n" + text;
+    }
+    return text;
+}
+
+std::vector<llama_token> tokenize(const llama_vocab* vocab, const std::string& text, bool add_special, bool parse_special) {
+    std::vector<llama_token> tokens(text.length() + 16);
+    int n = llama_tokenize(vocab, text.c_str(), text.length(), tokens.data(), tokens.size(), add_special, parse_special);
+    if (n < 0) {
+        // Buffer pequeno: llama_tokenize retorna -(tokens necessários).
+        tokens.resize(-n);
+        n = llama_tokenize(vocab, text.c_str(), text.length(), tokens.data(), tokens.size(), add_special, parse_special);
+    }
+    tokens.resize(std::max(n, 0));
+    return tokens;
+}
+
+void batch_add(llama_batch& batch, llama_token token, llama_pos pos, llama_seq_id seq_id, bool logits) {
+    batch.token[batch.n_tokens] = token;
+    batch.pos[batch.n_tokens] = pos;
+    batch.n_seq_id[batch.n_tokens] = 1;
+    batch.seq_id[batch.n_tokens][0] = seq_id;
+    batch.logits[batch.n_tokens] = logits;
+    batch.n_tokens++;
+}
+
+// Token compartilhado por várias sequências (o prompt comum a itens de score()).
+void batch_add_shared(llama_batch& batch, llama_token token, llama_pos pos,
+                      const std::vector<llama_seq_id>& seq_ids, bool logits) {
+    batch.token[batch.n_tokens] = token;
+    batch.pos[batch.n_tokens] = pos;
+    batch.n_seq_id[batch.n_tokens] = static_cast<int32_t>(seq_ids.size());
+    for (size_t i = 0; i < seq_ids.size(); ++i) {
+        batch.seq_id[batch.n_tokens][i] = seq_ids[i];
+    }
+    batch.logits[batch.n_tokens] = logits;
+    batch.n_tokens++;
+}
+
+// Um Sampler por completação, com os tokens do prompt já na janela de penalidade. Com seed
+// fixa, cada completação recebe uma seed diferente, mas reprodutível.
+std::vector<Sampler> make_samplers(const GenerationParams& params, int n_seq, const std::vector<llama_token>& prompt_tokens) {
+    // Amostrador próprio (kernels SIMD sobre os logits); veja sampler.hpp.
+    SamplingParams sparams;
+    sparams.temperature = params.temperature;
+    sparams.top_k = params.top_k;
+    sparams.top_p = params.top_p;
+    sparams.repeat_penalty = params.repeat_penalty;
+
+    std::vector<Sampler> samplers;
+    samplers.reserve(n_seq);
+    for (int s = 0; s < n_seq; ++s) {
+        sparams.seed = params.seed == LLAMA_DEFAULT_SEED ? LLAMA_DEFAULT_SEED : params.seed + s;
+        samplers.emplace_back(sparams);
+        for (auto token : prompt_tokens) {
+            samplers.back().accept(token);
+        }
+    }
+    return samplers;
+}
+
+// O cache de respostas guarda uma string por entrada; n completações são serializadas
+// com o tamanho de cada uma na frente.
+std::string encode_completions(const std::vector<std::string>& completions) {
+    std::string encoded;
+    for (const std::string& text : completions) {
+        encoded += std::to_string(text.size()) + ":" + text;
+    }
+    return encoded;
+}
+
+std::vector<std::string> decode_completions(const std::string& encoded) {
+    std::vector<std::string> completions;
+    size_t pos = 0;
+    while (pos < encoded.size()) {
+        size_t colon = encoded.find(':', pos);
+        if (colon == std::string::npos) { break; }
+        size_t len = std::stoul(encoded.substr(pos, colon - pos));
+        completions.push_back(encoded.substr(colon + 1, len));
+        pos = colon + 1 + len;
+    }
+    return completions;
+}
+
+} // namespace
+
+int LlmEngine::get_max_sequences() const {
+    auto instance = acquire_instance();
+    return instance ? static_cast<int>(llama_n_seq_max(instance->ctx)) : 0;
+}
+
+std::vector<LoraAdapterSpec> LlmEngine::get_lora_adapters() const {
+    std::vector<LoraAdapterSpec> adapters;
+    if (auto instance = acquire_instance()) {
+        for (const auto& lora : instance->lora_adapters) {
+            adapters.push_back(lora.spec);
+        }
+    }
+    return adapters;
+}
+
+bool LlmEngine::resolve_loras(const ModelInstance& instance, const std::vector<LoraSelection>& selections,
+                              LoraList& loras, std::string& error) {
+    loras.clear();
+    for (const LoraSelection& selection : selections) {
+        auto it = std::find_if(instance.lora_adapters.begin(), instance.lora_adapters.end(),
+                               [&](const ModelInstance::LoraAdapter& lora) { return lora.spec.name == selection.name; });
+        if (it == instance.lora_adapters.end()) {
+            error = "Unknown LoRA adapter '" + selection.name + "'";
+            return false;
+        }
+        loras.emplace_back(it->adapter, selection.scale);
+    }
+    return true;
+}
+
+bool LlmEngine::apply_loras(ModelInstance& instance, const LoraList& loras) {
+    // Os adaptadores valem para o contexto inteiro; como as gerações numa instância são
+    // serializadas por ctx_mutex, cada requisição aplica o seu conjunto aqui.
+    if (loras == instance.applied_loras) { return true; }
+    llama_clear_adapter_lora(instance.ctx);
+    for (const auto& lora : loras) {
+        if (llama_set_adapter_lora(instance.ctx, lora.first, lora.second) != 0) {
+            instance.applied_loras.clear();
+            llama_clear_adapter_lora(instance.ctx);
+            return false;
+        }
+    }
+    instance.applied_loras = loras;
+    return true;
+}
+
+std::vector<std::string> LlmEngine::predict_n(const std::string& user_prompt,
+                                              const std::string& system_prompt,
+                                              const GenerationParams& params) {
+    // Mantém a instância viva durante toda a geração, mesmo que reload_model() a substitua.
+    std::shared_ptr<ModelInstance> instance = acquire_instance();
+    if (!instance) { return {"[Error: Model not loaded]"}; }
+
+    const int n_seq = params.n;
+    const int n_seq_max = static_cast<int>(llama_n_seq_max(instance->ctx));
+    if (n_seq < 1 || n_seq > n_seq_max) {
+        return {"[Error: n must be between 1 and " + std::to_string(n_seq_max) + "]"};
+    }
+
+    LoraList loras;
+    std::string lora_error;
+    if (!resolve_loras(*instance, params.lora_adapters, loras, lora_error)) {
+        return {"[Error: " + lora_error + "]"};
     }
 
-    const auto * vocab = llama_model_get_vocab(model_);
+    const std::string final_prompt_text = build_chat_prompt(user_prompt, system_prompt);
+
+    const auto * vocab = llama_model_get_vocab(instance->model);
     std::vector<llama_token> prompt_tokens(final_prompt_text.length() + 16);
-    int n_prompt_tokens = llama_tokenize(
-        vocab,
-        final_prompt_text.c_str(), final_prompt_text.length(),
-        prompt_tokens.data(), prompt_tokens.size(), true, true);
+    int n_prompt_tokens = 0;
+    {
+        tracing::Span span("tokenize");
+        n_prompt_tokens = llama_tokenize(
+            vocab,
+            final_prompt_text.c_str(), final_prompt_text.length(),
+            prompt_tokens.data(), prompt_tokens.size(), true, true);
+    }
 
-    if (n_prompt_tokens < 0) { return "[Error: Tokenization failed]"; }
+    if (n_prompt_tokens <= 0) { return {"[Error: Tokenization failed]"}; }
     prompt_tokens.resize(n_prompt_tokens);
 
-    llama_kv_self_clear(ctx_);
+    // O cache KV é unificado: o prompt e as n continuações dividem as n_ctx células (o último
+    // token de cada continuação não passa pelo modelo). Sem isso, o cache enche no meio da
+    // geração e as completações sairiam truncadas.
+    const int n_ctx = static_cast<int>(llama_n_ctx(instance->ctx));
+    const long long cells_needed = static_cast<long long>(n_prompt_tokens) +
+                                   static_cast<long long>(n_seq) * std::max(0, params.max_tokens - 1);
+    if (cells_needed > n_ctx) {
+        return {"[Error: Prompt (" + std::to_string(n_prompt_tokens) + " tokens) + n * max_tokens exceed the context (n_ctx " +
+                std::to_string(n_ctx) + ")]"};
+    }
 
-    llama_batch batch = llama_batch_init(512, 0, 1);
-    for (int i = 0; i < n_prompt_tokens; ++i) {
-        batch.token[batch.n_tokens] = prompt_tokens[i];
-        batch.pos[batch.n_tokens] = i;
-        batch.n_seq_id[batch.n_tokens] = 1;
-        batch.seq_id[batch.n_tokens][0] = 0;
-        batch.logits[batch.n_tokens] = (i == n_prompt_tokens - 1);
-        batch.n_tokens++;
+    // A consulta ao cache acontece antes de travar o contexto: um acerto não espera
+    // pela geração que estiver em andamento.
+    const bool cacheable = params.use_cache && params.is_deterministic() && response_cache_.enabled();
+    uint64_t cache_key = 0;
+    if (cacheable) {
+        CacheKeyBuilder key_builder;
+        key_builder.add(instance->model_path)
+                   .add_value(instance->generation)
+                   .add_value(prompt_tokens.size())
+                   .add_bytes(prompt_tokens.data(), prompt_tokens.size() * sizeof(llama_token))
+                   .add_value(params.max_tokens)
+                   .add_value(params.temperature)
+                   .add_value(params.top_k)
+                   .add_value(params.top_p)
+                   .add_value(params.repeat_penalty)
+                   .add_value(params.seed)
+                   .add_value(n_seq)
+                   .add_value(params.lora_adapters.size());
+        for (const LoraSelection& selection : params.lora_adapters) {
+            key_builder.add(selection.name).add_value(selection.scale);
+        }
+        cache_key = key_builder.key();
+        std::string cached;
+        if (response_cache_.lookup(cache_key, cached)) {
+            return decode_completions(cached);
+        }
     }
 
-    if (llama_decode(ctx_, batch) != 0) { return "[Error: Decode failed]"; }
+    std::unique_lock<std::mutex> ctx_lock(instance->ctx_mutex, std::defer_lock);
+    {
+        tracing::Span span("queue_wait"); // Tempo esperando outra geração liberar o contexto
+        ctx_lock.lock();
+    }
+    llama_context* ctx = instance->ctx;
 
-    std::string result_text = "";
-    int n_cur = n_prompt_tokens;
+    if (!apply_loras(*instance, loras)) {
+        return {"[Error: Failed to apply LoRA adapter]"};
+    }
 
-    // Usar a API llama_sampler_chain
-    llama_sampler_chain_params sparams = llama_sampler_chain_default_params();
-    struct llama_sampler * sampler = llama_sampler_chain_init(sparams);
+    llama_memory_clear(llama_get_memory(ctx), true);
 
-    // Adicionar samplers individuais
-    if (temp_param > 0) {
-        llama_sampler_chain_add(sampler, llama_sampler_init_temp(temp_param));
+    // Prefill do prompt (uma vez só, na seq 0), em pedaços de até n_batch tokens.
+    const int n_batch = static_cast<int>(llama_n_batch(ctx));
+    llama_batch batch = llama_batch_init(std::max(n_batch, n_seq), 0, 1);
+    for (int start = 0; start < n_prompt_tokens; start += n_batch) {
+        const int end = std::min(start + n_batch, n_prompt_tokens);
+        batch.n_tokens = 0;
+        for (int i = start; i < end; ++i) {
+            batch_add(batch, prompt_tokens[i], i, 0, i == n_prompt_tokens - 1);
+        }
+        tracing::Span span("prefill_chunk", end - start);
+        if (instance->decode(batch) != 0) {
+            llama_batch_free(batch);
+            return {"[Error: Decode failed]"};
+        }
     }
-    if (top_k_param > 0) {
-        llama_sampler_chain_add(sampler, llama_sampler_init_top_k(top_k_param));
+
+    if (instance->scheduler) {
+        // Modo desagregado: o estado KV do prompt vai para o contexto de decode e ctx fica
+        // livre para o próximo prompt enquanto esta geração avança junto com as outras.
+        DecodeJob job;
+        const float* prompt_logits = llama_get_logits_ith(ctx, -1);
+        job.prompt_logits.assign(prompt_logits, prompt_logits + llama_vocab_n_tokens(vocab));
+        {
+            tracing::Span span("kv_export");
+            job.prompt_state.resize(llama_state_seq_get_size(ctx, 0));
+            job.prompt_state.resize(llama_state_seq_get_data(ctx, job.prompt_state.data(), job.prompt_state.size(), 0));
+        }
+        llama_batch_free(batch);
+        ctx_lock.unlock();
+        if (job.prompt_state.empty()) { return {"[Error: Failed to export the prompt state]"}; }
+
+        job.n_prompt_tokens = n_prompt_tokens;
+        job.max_tokens = params.max_tokens;
+        job.samplers = make_samplers(params, n_seq, prompt_tokens);
+        job.loras = loras;
+        {
+            tracing::Span span("generate"); // Fila do escalonador + passos de decode
+            job.trace_id = tracing::current_trace_id();
+            job.parent_span_id = tracing::current_span_id();
+            instance->scheduler->run(job);
+        }
+
+        std::vector<std::string> completions;
+        {
+            tracing::Span span("detokenize");
+            for (const std::vector<llama_token>& tokens : job.tokens) {
+                std::string text;
+                for (llama_token token : tokens) { text += token_to_piece(vocab, token); }
+                completions.push_back(std::move(text));
+            }
+        }
+        if (!job.ok) { return {"[Error: " + job.error + "]"}; } // Nunca devolve completações truncadas
+        // Gerações de um modelo já substituído não são guardadas.
+        if (cacheable && acquire_instance() == instance) {
+            response_cache_.insert(cache_key, encode_completions(completions));
+        }
+        return completions;
     }
-    if (top_p_param > 0) {
-        llama_sampler_chain_add(sampler, llama_sampler_init_top_p(top_p_param, 1)); // min_keep = 1
+
+    // Bifurca a sequência: as demais completações reutilizam o cache KV do prompt.
+    for (llama_seq_id s = 1; s < n_seq; ++s) {
+        llama_memory_seq_cp(llama_get_memory(ctx), 0, s, -1, -1);
     }
-    if (repeat_penalty_param != 1.0f) {
-        llama_sampler_chain_add(sampler, llama_sampler_init_penalties(256, repeat_penalty_param, 0.0f, 0.0f)); // penalty_last_n = 256, freq_penalty = 0, present_penalty = 0
+
+    struct SequenceState {
+        Sampler sampler;
+        std::string text;
+        int32_t logits_index = -1; // Posição no último batch com os logits desta sequência
+        bool done = false;
+        explicit SequenceState(Sampler&& s) : sampler(std::move(s)) {}
+    };
+
+    std::vector<SequenceState> sequences;
+    sequences.reserve(n_seq);
+    for (Sampler& sampler : make_samplers(params, n_seq, prompt_tokens)) {
+        sequences.emplace_back(std::move(sampler));
     }
-    // Adicionar um sampler final para selecionar o token (greedy ou dist)
-    llama_sampler_chain_add(sampler, llama_sampler_init_greedy());
 
-    for(auto token : prompt_tokens) {
-        llama_sampler_accept(sampler, token);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    // No primeiro passo todas as sequências partem dos mesmos logits do prompt; como o
+    // Sampler aplica penalidades no lugar, cada uma amostra de uma cópia.
+    std::vector<float> shared_logits;
+    bool generation_ok = true;
+
+    for (int n_generated = 0; n_generated < params.max_tokens; ++n_generated) {
+        const bool first_step = n_generated == 0;
+        batch.n_tokens = 0;
+        for (int s = 0; s < n_seq; ++s) {
+            SequenceState& seq = sequences[s];
+            if (seq.done) { continue; }
+
+            float* logits = llama_get_logits_ith(ctx, seq.logits_index);
+            if (first_step && n_seq > 1) {
+                shared_logits.assign(logits, logits + n_vocab);
+                logits = shared_logits.data();
+            }
+            llama_token new_token_id = 0;
+            {
+                tracing::Span span("sample");
+                new_token_id = seq.sampler.sample(logits, n_vocab);
+                seq.sampler.accept(new_token_id);
+            }
+
+            if (llama_vocab_is_eog(vocab, new_token_id)) {
+                seq.done = true;
+                continue;
+            }
+            {
+                tracing::Span span("detokenize");
+                seq.text += token_to_piece(vocab, new_token_id);
+            }
+
+            seq.logits_index = batch.n_tokens;
+            batch_add(batch, new_token_id, n_prompt_tokens + n_generated, s, true);
+        }
+
+        if (batch.n_tokens == 0) { break; } // Todas as sequências terminaram
+        if (n_generated + 1 == params.max_tokens) { break; } // Não precisa decodificar o último token
+        tracing::Span span("decode_step", batch.n_tokens);
+        if (instance->decode(batch) != 0) {
+            generation_ok = false;
+            break;
+        }
     }
 
-    while (n_cur <= max_tokens_to_generate) {
-        llama_token new_token_id = llama_sampler_sample(sampler, ctx_, 0);
-        llama_sampler_accept(sampler, new_token_id);
+    std::vector<llama_seq_id> seq_ids(n_seq);
+    for (llama_seq_id s = 0; s < n_seq; ++s) { seq_ids[s] = s; }
+    instance->kv_used_cells = kv_cells_in_use(llama_get_memory(ctx), seq_ids, n_prompt_tokens);
+    llama_batch_free(batch);
 
-        if (new_token_id == llama_vocab_eos(vocab)) { break; }
+    if (!generation_ok) { return {"[Error: Decode failed]"}; }
 
-        char piece_buffer[64];
-        int len = llama_token_to_piece(vocab, new_token_id, piece_buffer, sizeof(piece_buffer), 0, true);
-        if (len > 0) { result_text.append(piece_buffer, len); }
+    std::vector<std::string> completions;
+    completions.reserve(n_seq);
+    for (SequenceState& seq : sequences) {
+        completions.push_back(std::move(seq.text));
+    }
 
-        llama_batch_free(batch);
-        batch = llama_batch_init(512, 0, 1);
-        batch.token[batch.n_tokens] = new_token_id;
-        batch.pos[batch.n_tokens] = n_cur;
-        batch.n_seq_id[batch.n_tokens] = 1;
-        batch.seq_id[batch.n_tokens][0] = 0;
-        batch.logits[batch.n_tokens] = true;
-        batch.n_tokens++;
+    // Gerações de um modelo que reload_model() substituiu durante a geração não são
+    // guardadas: o cache já foi limpo para o novo.
+    if (cacheable && acquire_instance() == instance) {
+        response_cache_.insert(cache_key, encode_completions(completions));
+    }
+    return completions;
+}
+
+ScoreBatch LlmEngine::score(const std::vector<ScoreItem>& items, const ScoreParams& params) {
+    ScoreBatch batch_result;
+    std::shared_ptr<ModelInstance> instance = acquire_instance();
+    if (!instance) {
+        batch_result.error = "Model not loaded";
+        return batch_result;
+    }
+    if (items.empty()) {
+        batch_result.error = "No items to score";
+        return batch_result;
+    }
+    LoraList loras;
+    if (!resolve_loras(*instance, params.lora_adapters, loras, batch_result.error)) {
+        return batch_result;
+    }
+
+    const llama_vocab* vocab = llama_model_get_vocab(instance->model);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const int n_ctx = static_cast<int>(llama_n_ctx(instance->ctx));
+    const int n_batch = static_cast<int>(llama_n_batch(instance->ctx));
+    const int n_seq_max = static_cast<int>(llama_n_seq_max(instance->ctx));
+
+    // Itens com o mesmo prompt apontam para o mesmo grupo; os tokens do grupo entram no
+    // batch uma vez só, marcados com as sequências de todos esses itens.
+    std::vector<std::vector<llama_token>> prompt_groups;
+    std::vector<int> group_of_item(items.size(), -1); // -1 = nada a avaliar (erro ou continuação vazia)
+    std::vector<std::vector<llama_token>> continuations(items.size());
+    batch_result.results.resize(items.size());
+    {
+        tracing::Span span("tokenize", static_cast<int64_t>(items.size()));
+        std::map<std::string, int> group_of_prompt;
+        for (size_t i = 0; i < items.size(); ++i) {
+            ScoreResult& result = batch_result.results[i];
+            const std::string prompt_text = params.chat_template
+                ? build_chat_prompt(items[i].prompt, params.system_prompt) : items[i].prompt;
+            auto found = group_of_prompt.find(prompt_text);
+            if (found == group_of_prompt.end()) {
+                std::vector<llama_token> prompt_tokens = tokenize(vocab, prompt_text, true, params.chat_template);
+                if (prompt_tokens.empty()) {
+                    result.error = "Prompt produced no tokens";
+                    continue;
+                }
+                found = group_of_prompt.emplace(prompt_text, static_cast<int>(prompt_groups.size())).first;
+                prompt_groups.push_back(std::move(prompt_tokens));
+            }
+            // A continuação é tokenizada à parte, para que a fronteira com o prompt seja exata.
+            continuations[i] = tokenize(vocab, items[i].continuation, false, false);
+            if (continuations[i].empty()) { continue; } // Nada a pontuar: total 0
+            const size_t cells = prompt_groups[found->second].size() + continuations[i].size() - 1;
+            if (cells > static_cast<size_t>(n_ctx)) {
+                result.error = "Prompt + continuation exceed the context (n_ctx " + std::to_string(n_ctx) + ")";
+                continue;
+            }
+            group_of_item[i] = found->second;
+        }
+    }
+
+    // Rodadas: até n_seq_max itens cujos tokens cabem juntos no cache KV. Os itens vão em
+    // ordem de grupo, para que os que compartilham prompt caiam na mesma rodada. O cache é
+    // unificado (kv_unified em create_instance): as n_ctx células valem para a rodada
+    // inteira, e um token do prompt pode pertencer a várias sequências do mesmo batch.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (group_of_item[i] >= 0) { order.push_back(i); }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return group_of_item[a] < group_of_item[b]; });
+    std::vector<std::vector<size_t>> rounds;
+    size_t round_cells = 0;
+    int round_last_group = -1;
+    for (size_t item : order) {
+        const int group = group_of_item[item];
+        size_t cells = continuations[item].size() - 1;
+        if (rounds.empty() || group != round_last_group) { cells += prompt_groups[group].size(); }
+        if (rounds.empty() || rounds.back().size() >= static_cast<size_t>(n_seq_max)
+            || round_cells + cells > static_cast<size_t>(n_ctx)) {
+            rounds.emplace_back();
+            round_cells = prompt_groups[group].size() + continuations[item].size() - 1;
+        } else {
+            round_cells += cells;
+        }
+        rounds.back().push_back(item);
+        round_last_group = group;
+    }
 
-        if (llama_decode(ctx_, batch) != 0) { break; }
-        n_cur++;
+    std::unique_lock<std::mutex> ctx_lock(instance->ctx_mutex, std::defer_lock);
+    {
+        tracing::Span span("queue_wait");
+        ctx_lock.lock();
+    }
+    llama_context* ctx = instance->ctx;
+    if (!apply_loras(*instance, loras)) {
+        batch_result.error = "Failed to apply LoRA adapter";
+        return batch_result;
     }
 
-    llama_sampler_free(sampler);
+    // Uma posição do batch com logits e os tokens de continuação que ela prevê:
+    // (item, índice do token na continuação).
+    struct Entry {
+        llama_token token;
+        llama_pos pos;
+        std::vector<llama_seq_id> seq_ids;
+        std::vector<std::pair<size_t, size_t>> targets;
+    };
+
+    llama_batch batch = llama_batch_init(n_batch, 0, n_seq_max);
+    std::vector<float> scratch(n_vocab);
+    std::vector<sampling_kernels::Candidate> top;
+    int32_t used_cells = 0; // Da última rodada, a que fica no cache
+    for (const std::vector<size_t>& round : rounds) {
+        llama_memory_clear(llama_get_memory(ctx), true);
+
+        std::vector<Entry> entries;
+        // Sequências de cada grupo e o tamanho do prompt que elas dividem.
+        std::vector<std::pair<std::vector<llama_seq_id>, int32_t>> round_groups;
+        for (size_t first = 0; first < round.size();) {
+            const int group = group_of_item[round[first]];
+            size_t last = first;
+            std::vector<llama_seq_id> seq_ids;
+            std::vector<std::pair<size_t, size_t>> first_targets;
+            for (; last < round.size() && group_of_item[round[last]] == group; ++last) {
+                seq_ids.push_back(static_cast<llama_seq_id>(last));
+                first_targets.emplace_back(round[last], 0);
+            }
+            const std::vector<llama_token>& prompt_tokens = prompt_groups[group];
+            round_groups.emplace_back(seq_ids, static_cast<int32_t>(prompt_tokens.size()));
+            for (size_t p = 0; p < prompt_tokens.size(); ++p) {
+                // Só o último token do prompt precisa de logits: ele prevê o 1º da continuação.
+                entries.push_back({prompt_tokens[p], static_cast<llama_pos>(p), seq_ids,
+                                   p + 1 == prompt_tokens.size() ? first_targets : std::vector<std::pair<size_t, size_t>>()});
+            }
+            for (size_t s = first; s < last; ++s) {
+                const std::vector<llama_token>& continuation = continuations[round[s]];
+                // O último token da continuação não prevê nada que interesse: não entra no batch.
+                for (size_t j = 0; j + 1 < continuation.size(); ++j) {
+                    entries.push_back({continuation[j], static_cast<llama_pos>(prompt_tokens.size() + j),
+                                       {static_cast<llama_seq_id>(s)}, {{round[s], j + 1}}});
+                }
+            }
+            first = last;
+        }
+
+        bool round_ok = true;
+        for (size_t start = 0; start < entries.size() && round_ok; start += n_batch) {
+            const size_t end = std::min(entries.size(), start + static_cast<size_t>(n_batch));
+            batch.n_tokens = 0;
+            for (size_t e = start; e < end; ++e) {
+                batch_add_shared(batch, entries[e].token, entries[e].pos, entries[e].seq_ids, !entries[e].targets.empty());
+            }
+            {
+                tracing::Span span("score_decode", batch.n_tokens);
+                if (instance->decode(batch) != 0) {
+                    round_ok = false;
+                    break;
+                }
+            }
+            batch_result.decode_calls++;
+            batch_result.evaluated_tokens += batch.n_tokens;
+
+            // Os logits valem só até o próximo llama_decode: consome agora.
+            tracing::Span span("logprobs", batch.n_tokens);
+            for (size_t e = start; e < end; ++e) {
+                if (entries[e].targets.empty()) { continue; }
+                const float* logits = llama_get_logits_ith(ctx, static_cast<int32_t>(e - start));
+                const float lse = sampling_kernels::log_sum_exp(logits, n_vocab, scratch.data());
+                top.clear();
+                if (params.top_logprobs > 0) {
+                    sampling_kernels::select_top_k(logits, n_vocab, params.top_logprobs, top);
+                    std::sort(top.begin(), top.end(), [](const sampling_kernels::Candidate& a, const sampling_kernels::Candidate& b) {
+                        return a.logit > b.logit;
+                    });
+                }
+                for (const auto& target : entries[e].targets) {
+                    TokenLogprob token;
+                    token.id = continuations[target.first][target.second];
+                    token.text = token_to_piece(vocab, token.id);
+                    token.logprob = logits[token.id] - lse;
+                    for (const auto& candidate : top) {
+                        token.top.emplace_back(token_to_piece(vocab, candidate.id), candidate.logit - lse);
+                    }
+                    batch_result.results[target.first].tokens.push_back(std::move(token));
+                }
+            }
+        }
+        if (!round_ok) {
+            for (size_t item : round) {
+                batch_result.results[item].tokens.clear();
+                batch_result.results[item].error = "Decode failed";
+            }
+        }
+        used_cells = 0;
+        for (const auto& group : round_groups) {
+            used_cells += kv_cells_in_use(llama_get_memory(ctx), group.first, group.second);
+        }
+    }
+    if (!instance->scheduler) { // No modo desagregado, quem informa é o contexto de decode
+        instance->kv_used_cells = used_cells;
+    }
     llama_batch_free(batch);
 
-    return result_text;
+    for (ScoreResult& result : batch_result.results) {
+        // As entradas de um item são emitidas em ordem de posição, então os tokens já estão em ordem.
+        for (const TokenLogprob& token : result.tokens) {
+            result.total_logprob += token.logprob;
+        }
+    }
+    return batch_result;
 }
 
 } // namespace
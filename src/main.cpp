@@ -6,12 +6,26 @@
 #include "cpu_llm_project/dummy.hpp"
 #include "cpu_llm_project/llm_engine.hpp" // Nosso novo motor LLM
 #include "cpu_llm_project/api_server.hpp" // Nosso servidor API
+#include "cpu_llm_project/tracing.hpp"
+#include "cpu_llm_project/router.hpp"
+#include "cpu_llm_project/quantizer.hpp"
+#include "cpu_llm_project/autotune.hpp"
 #include <fstream>      // Para std::ifstream
 #include <sstream>      // Para std::ostringstream
 #include <map>          // Para std::map (usado para carregar .env)
 #include <algorithm>    // Para std::remove, std::isspace
 #include "yaml-cpp/yaml.h" // Para parsing de YAML
 #include <cstdlib>     // Para getenv
+#include <csignal>     // Para SIGHUP (recarga da persona)
+#include <atomic>
+#include <chrono>
+#include <cstdio>      // Para std::remove(const char*)
+#include <cstdint>     // Para std::uintmax_t
+#include <ctime>
+#include <filesystem>  // Para detectar troca do arquivo do modelo
+#include <functional>
+#include <mutex>
+#include <thread>
 
 // Para checagem de AVX em tempo de execução (exemplo)
 #if defined(__GNUC__) || defined(__clang__)
@@ -85,19 +99,82 @@ struct AppConfig {
     std::string system_prompt = "Você é um assistente de IA prestativo e conciso.";
     int n_ctx = 2048;
     int num_threads = 0; // 0 para LlmEngine usar lógica padrão
+    int max_sequences = 4; // Sequências simultâneas no contexto (limite do parâmetro 'n')
+    int prefill_threads = 0;       // 0 = num_threads
+    int decode_threads = 0;        // 0 = num_threads
+    int threadpool_poll = 50;      // 0-100
+    bool threadpool_partition = false;
+    bool disaggregate_prefill = false; // Prompts e geração em contextos separados
+    int n_batch = 512;             // Tokens por llama_decode no prompt
+    int n_ubatch = 512;            // Micro-batch computado de uma vez (<= n_batch)
+    std::string kv_cache_type = "f16"; // f16, bf16, q8_0, q4_0 ou f32
+    bool flash_attn = false;
+    std::string hardware_profile;  // Chave de hardware_profiles aplicada (vazio = nenhuma)
+    std::vector<cpu_llm_project::LoraAdapterSpec> lora_adapters; // Fine-tunes aplicados sobre o modelo base
     float model_temperature = 0.8f;
     int model_top_k = 40;
     float model_top_p = 0.9f;
     float model_repeat_penalty = 1.1f;
     int max_tokens = 128;
+    uint32_t seed = LLAMA_DEFAULT_SEED; // Seed fixa torna a geração reprodutível (e cacheável)
+    size_t response_cache_mb = 0;       // 0 desabilita o cache de respostas
+    size_t memory_budget_mb = 0;        // Limite para modelos + contextos; 0 = sem limite
+
+    // Rastreamento por requisição (veja tracing.hpp)
+    double trace_sample_rate = 0.0;     // 0 = só requisições com o header "X-Trace: 1"
+    std::string trace_dir = "./traces";
+    std::string trace_format = "chrome"; // "chrome" ou "otlp"
+    bool trace_allow_header = true;     // false = o header "X-Trace: 1" é ignorado
+    size_t trace_max_files = 100;       // Arquivos de trace mantidos em trace_dir (0 = sem limite)
 
     std::string api_host = "localhost";
     int api_port = 8080;
+    cpu_llm_project::ServerOptions server_options; // Front end HTTP (chaves http_*, unix_socket_path e admin_token)
+
+    // Modo roteador (--router). Lidos só pelo processo roteador; os workers ignoram.
+    int router_workers = 0;                         // Workers iniciados pelo roteador
+    std::vector<std::string> router_worker_addresses; // Workers externos ("unix:/x.sock" ou "host:porta")
+    int router_max_inflight = 2;
+    int router_health_interval_ms = 1000;
+    int router_restart_after_failures = 5;
+    std::string router_socket_dir = "/tmp";
 
     // Adicionar outros campos conforme necessário (nome da persona, etc.)
     std::string persona_name;
 };
 
+// Aplica a entrada de 'hardware_profiles' gravada pelo subcomando autotune para esta máquina,
+// por cima das chaves de topo. Um perfil medido com outro modelo é ignorado.
+void apply_hardware_profile(const YAML::Node& yaml_config, AppConfig& config) {
+    const YAML::Node profiles = yaml_config["hardware_profiles"];
+    if (!profiles || !profiles.IsMap()) { return; }
+    const std::string fingerprint = cpu_llm_project::autotune::hardware_fingerprint();
+    const YAML::Node profile = profiles[fingerprint];
+    if (!profile || !profile.IsMap()) {
+        // Um perfil gravado noutra máquina (ou antes de trocar a CPU) não vale aqui; avisa
+        // para que um fingerprint diferente do esperado não passe despercebido.
+        std::cout << "Info: Nenhum perfil de hardware para '" << fingerprint << "' (" << profiles.size()
+                  << " gravado(s)); usando as chaves de topo. Rode o subcomando autotune nesta máquina para criar um." << std::endl;
+        return;
+    }
+    if (profile["model"]) {
+        const std::string tuned_model = profile["model"].as<std::string>();
+        if (tuned_model != std::filesystem::path(config.model_gguf_path).filename().string()) {
+            std::cout << "Info: Perfil de hardware '" << fingerprint << "' foi ajustado para '" << tuned_model
+                      << "', não para o modelo atual; ignorado." << std::endl;
+            return;
+        }
+    }
+    if (profile["prefill_threads"]) config.prefill_threads = profile["prefill_threads"].as<int>(config.prefill_threads);
+    if (profile["decode_threads"]) config.decode_threads = profile["decode_threads"].as<int>(config.decode_threads);
+    if (profile["n_batch"]) config.n_batch = profile["n_batch"].as<int>(config.n_batch);
+    if (profile["n_ubatch"]) config.n_ubatch = profile["n_ubatch"].as<int>(config.n_ubatch);
+    if (profile["kv_cache_type"]) config.kv_cache_type = profile["kv_cache_type"].as<std::string>(config.kv_cache_type);
+    if (profile["flash_attn"]) config.flash_attn = profile["flash_attn"].as<bool>(config.flash_attn);
+    config.hardware_profile = fingerprint;
+    std::cout << "Info: Perfil de hardware aplicado: " << fingerprint << std::endl;
+}
+
 // Função para carregar e parsear o arquivo YAML de configuração da persona/modelo
 bool load_config_from_yaml(const std::string& yaml_path, AppConfig& config) {
     try {
@@ -113,17 +190,69 @@ bool load_config_from_yaml(const std::string& yaml_path, AppConfig& config) {
         if (yaml_config["name"]) config.persona_name = yaml_config["name"].as<std::string>();
         if (yaml_config["n_ctx"]) config.n_ctx = yaml_config["n_ctx"].as<int>(config.n_ctx);
         if (yaml_config["num_threads"]) config.num_threads = yaml_config["num_threads"].as<int>(config.num_threads);
+        if (yaml_config["max_sequences"]) config.max_sequences = yaml_config["max_sequences"].as<int>(config.max_sequences);
+        if (yaml_config["prefill_threads"]) config.prefill_threads = yaml_config["prefill_threads"].as<int>(config.prefill_threads);
+        if (yaml_config["decode_threads"]) config.decode_threads = yaml_config["decode_threads"].as<int>(config.decode_threads);
+        if (yaml_config["threadpool_poll"]) config.threadpool_poll = yaml_config["threadpool_poll"].as<int>(config.threadpool_poll);
+        if (yaml_config["threadpool_partition"]) config.threadpool_partition = yaml_config["threadpool_partition"].as<bool>(config.threadpool_partition);
+        if (yaml_config["disaggregate_prefill"]) config.disaggregate_prefill = yaml_config["disaggregate_prefill"].as<bool>(config.disaggregate_prefill);
+        if (yaml_config["n_batch"]) config.n_batch = yaml_config["n_batch"].as<int>(config.n_batch);
+        if (yaml_config["n_ubatch"]) config.n_ubatch = yaml_config["n_ubatch"].as<int>(config.n_ubatch);
+        if (yaml_config["kv_cache_type"]) config.kv_cache_type = yaml_config["kv_cache_type"].as<std::string>(config.kv_cache_type);
+        if (yaml_config["flash_attn"]) config.flash_attn = yaml_config["flash_attn"].as<bool>(config.flash_attn);
+        apply_hardware_profile(yaml_config, config);
+        if (yaml_config["lora_adapters"]) {
+            // Lista de {name, path, scale}. Sem name, usa o nome do arquivo.
+            for (const auto& node : yaml_config["lora_adapters"]) {
+                cpu_llm_project::LoraAdapterSpec adapter;
+                if (!node["path"]) {
+                    std::cerr << "Erro: item de 'lora_adapters' sem 'path' no arquivo YAML: " << yaml_path << std::endl;
+                    return false;
+                }
+                adapter.path = node["path"].as<std::string>();
+                adapter.name = node["name"] ? node["name"].as<std::string>()
+                                            : std::filesystem::path(adapter.path).stem().string();
+                if (node["scale"]) adapter.scale = node["scale"].as<float>(adapter.scale);
+                config.lora_adapters.push_back(adapter);
+            }
+        }
         if (yaml_config["system_prompt"]) config.system_prompt = yaml_config["system_prompt"].as<std::string>();
         if (yaml_config["max_tokens"]) config.max_tokens = yaml_config["max_tokens"].as<int>(config.max_tokens);
         if (yaml_config["temperature"]) config.model_temperature = yaml_config["temperature"].as<float>(config.model_temperature);
         if (yaml_config["top_k"]) config.model_top_k = yaml_config["top_k"].as<int>(config.model_top_k);
         if (yaml_config["top_p"]) config.model_top_p = yaml_config["top_p"].as<float>(config.model_top_p);
         if (yaml_config["repeat_penalty"]) config.model_repeat_penalty = yaml_config["repeat_penalty"].as<float>(config.model_repeat_penalty);
+        if (yaml_config["seed"]) config.seed = yaml_config["seed"].as<uint32_t>(config.seed);
+        if (yaml_config["response_cache_mb"]) config.response_cache_mb = yaml_config["response_cache_mb"].as<size_t>(config.response_cache_mb);
+        if (yaml_config["memory_budget_mb"]) config.memory_budget_mb = yaml_config["memory_budget_mb"].as<size_t>(config.memory_budget_mb);
+        if (yaml_config["trace_sample_rate"]) config.trace_sample_rate = yaml_config["trace_sample_rate"].as<double>(config.trace_sample_rate);
+        if (yaml_config["trace_dir"]) config.trace_dir = yaml_config["trace_dir"].as<std::string>(config.trace_dir);
+        if (yaml_config["trace_format"]) config.trace_format = yaml_config["trace_format"].as<std::string>(config.trace_format);
+        if (yaml_config["trace_allow_header"]) config.trace_allow_header = yaml_config["trace_allow_header"].as<bool>(config.trace_allow_header);
+        if (yaml_config["trace_max_files"]) config.trace_max_files = yaml_config["trace_max_files"].as<size_t>(config.trace_max_files);
 
         // API_HOST e API_PORT não são tipicamente por persona, mas podem ser lidos se presentes
         if (yaml_config["api_host"]) config.api_host = yaml_config["api_host"].as<std::string>(config.api_host);
         if (yaml_config["api_port"]) config.api_port = yaml_config["api_port"].as<int>(config.api_port);
 
+        cpu_llm_project::ServerOptions& http = config.server_options;
+        if (yaml_config["http_threads"]) http.worker_threads = yaml_config["http_threads"].as<int>(http.worker_threads);
+        if (yaml_config["http_max_connections"]) http.max_connections = yaml_config["http_max_connections"].as<size_t>(http.max_connections);
+        if (yaml_config["http_max_queued"]) http.max_queued = yaml_config["http_max_queued"].as<size_t>(http.max_queued);
+        if (yaml_config["http_read_timeout_sec"]) http.read_timeout_sec = yaml_config["http_read_timeout_sec"].as<time_t>(http.read_timeout_sec);
+        if (yaml_config["http_write_timeout_sec"]) http.write_timeout_sec = yaml_config["http_write_timeout_sec"].as<time_t>(http.write_timeout_sec);
+        if (yaml_config["http_keep_alive_timeout_sec"]) http.keep_alive_timeout_sec = yaml_config["http_keep_alive_timeout_sec"].as<time_t>(http.keep_alive_timeout_sec);
+        if (yaml_config["http_keep_alive_max_requests"]) http.keep_alive_max_requests = yaml_config["http_keep_alive_max_requests"].as<size_t>(http.keep_alive_max_requests);
+        if (yaml_config["http_max_body_bytes"]) http.payload_max_bytes = yaml_config["http_max_body_bytes"].as<size_t>(http.payload_max_bytes);
+        if (yaml_config["router_workers"]) config.router_workers = yaml_config["router_workers"].as<int>(config.router_workers);
+        if (yaml_config["router_worker_addresses"]) config.router_worker_addresses = yaml_config["router_worker_addresses"].as<std::vector<std::string>>();
+        if (yaml_config["router_max_inflight"]) config.router_max_inflight = yaml_config["router_max_inflight"].as<int>(config.router_max_inflight);
+        if (yaml_config["router_health_interval_ms"]) config.router_health_interval_ms = yaml_config["router_health_interval_ms"].as<int>(config.router_health_interval_ms);
+        if (yaml_config["router_restart_after_failures"]) config.router_restart_after_failures = yaml_config["router_restart_after_failures"].as<int>(config.router_restart_after_failures);
+        if (yaml_config["router_socket_dir"]) config.router_socket_dir = yaml_config["router_socket_dir"].as<std::string>(config.router_socket_dir);
+        if (yaml_config["unix_socket_path"]) http.unix_socket_path = yaml_config["unix_socket_path"].as<std::string>(http.unix_socket_path);
+        if (yaml_config["admin_token"]) http.admin_token = yaml_config["admin_token"].as<std::string>(http.admin_token);
+
 
         std::cout << "Info: Configuração YAML '" << yaml_path << "' carregada." << std::endl;
         if (!config.persona_name.empty()) {
@@ -136,6 +265,485 @@ bool load_config_from_yaml(const std::string& yaml_path, AppConfig& config) {
     }
 }
 
+// Expande ~ para o diretório home do usuário, se aplicável
+void expand_home_path(std::string& path) {
+    if (path.empty() || path[0] != '~') {
+        return;
+    }
+    const char* home_dir = getenv("HOME");
+    if (home_dir) {
+        path.replace(0, 1, home_dir);
+        std::cout << "Info: Caminho do modelo expandido para: " << path << std::endl;
+    } else {
+        std::cerr << "Aviso: Não foi possível expandir '~' no caminho do modelo porque a variável de ambiente HOME não está definida. Tentando usar o caminho como está." << std::endl;
+    }
+}
+
+cpu_llm_project::ModelLoadParams make_load_params(const AppConfig& config) {
+    cpu_llm_project::ModelLoadParams params;
+    params.model_path = config.model_gguf_path;
+    params.n_ctx = config.n_ctx;
+    params.n_gpu_layers = 0;
+    params.num_threads = config.num_threads;
+    params.max_sequences = config.max_sequences;
+    params.prefill_threads = config.prefill_threads;
+    params.decode_threads = config.decode_threads;
+    params.threadpool_poll = static_cast<uint32_t>(std::max(0, std::min(config.threadpool_poll, 100)));
+    params.threadpool_partition = config.threadpool_partition;
+    params.disaggregate_prefill = config.disaggregate_prefill;
+    params.n_batch = config.n_batch;
+    params.n_ubatch = config.n_ubatch;
+    params.kv_cache_type = config.kv_cache_type;
+    params.flash_attn = config.flash_attn;
+    params.lora_adapters = config.lora_adapters;
+    return params;
+}
+
+cpu_llm_project::GenerationParams make_generation_params(const AppConfig& config) {
+    cpu_llm_project::GenerationParams params;
+    params.max_tokens = config.max_tokens;
+    params.temperature = config.model_temperature;
+    params.top_k = config.model_top_k;
+    params.top_p = config.model_top_p;
+    params.repeat_penalty = config.model_repeat_penalty;
+    params.seed = config.seed;
+    // Por padrão as requisições usam todos os adaptadores da persona, com as escalas do YAML.
+    for (const auto& adapter : config.lora_adapters) {
+        params.lora_adapters.push_back({adapter.name, adapter.scale});
+    }
+    return params;
+}
+
+void apply_trace_config(const AppConfig& config) {
+    cpu_llm_project::tracing::Config trace_config;
+    trace_config.sample_rate = config.trace_sample_rate;
+    trace_config.output_dir = config.trace_dir;
+    trace_config.allow_forced = config.trace_allow_header;
+    trace_config.max_files = config.trace_max_files;
+    if (!cpu_llm_project::tracing::parse_export_format(config.trace_format, trace_config.format)) {
+        std::cerr << "Aviso: trace_format '" << config.trace_format << "' desconhecido (use 'chrome' ou 'otlp'). Usando 'chrome'." << std::endl;
+    }
+    cpu_llm_project::tracing::configure(trace_config);
+}
+
+// Expande ~ no caminho do modelo e dos adaptadores LoRA.
+void expand_config_paths(AppConfig& config) {
+    expand_home_path(config.model_gguf_path);
+    for (auto& adapter : config.lora_adapters) {
+        expand_home_path(adapter.path);
+    }
+}
+
+// Adaptadores carregados com o modelo; mudar nomes ou caminhos exige recarregar a instância
+// (só mudar a escala, não: ela é aplicada por requisição). Arquivos substituídos no mesmo
+// caminho são detectados por loaded_file_stamps.
+bool same_lora_files(const AppConfig& a, const AppConfig& b) {
+    if (a.lora_adapters.size() != b.lora_adapters.size()) { return false; }
+    for (size_t i = 0; i < a.lora_adapters.size(); ++i) {
+        if (a.lora_adapters[i].name != b.lora_adapters[i].name || a.lora_adapters[i].path != b.lora_adapters[i].path) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Data de modificação e tamanho de um arquivo; usados para detectar um GGUF substituído no
+// mesmo caminho (a data sozinha não basta quando a cópia preserva o mtime, ex.: cp -p, rsync -t).
+struct FileStamp {
+    std::filesystem::file_time_type time = std::filesystem::file_time_type::min();
+    std::uintmax_t size = 0;
+
+    bool operator==(const FileStamp& other) const { return time == other.time && size == other.size; }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+FileStamp file_stamp(const std::string& path) {
+    FileStamp stamp;
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (!ec) { stamp.time = time; }
+    auto size = std::filesystem::file_size(path, ec);
+    if (!ec) { stamp.size = size; }
+    return stamp;
+}
+
+// Carimbos do modelo e de cada adaptador LoRA, nessa ordem.
+std::vector<FileStamp> loaded_file_stamps(const AppConfig& config) {
+    std::vector<FileStamp> stamps;
+    stamps.push_back(file_stamp(config.model_gguf_path));
+    for (const auto& adapter : config.lora_adapters) {
+        stamps.push_back(file_stamp(adapter.path));
+    }
+    return stamps;
+}
+
+// Relê o YAML da persona e aplica as mudanças sem reiniciar o processo.
+// O modelo só é recarregado se o caminho, os parâmetros do contexto ou os próprios arquivos
+// (modelo ou adaptadores LoRA) mudaram
+// (ou se force_model_reload for true). A troca é feita por LlmEngine::reload_model, que
+// mantém as requisições em andamento no modelo antigo até terminarem.
+bool reload_persona(const std::string& yaml_path,
+                    const std::function<void(AppConfig&)>& apply_cli_overrides,
+                    bool force_model_reload,
+                    AppConfig& config,
+                    std::vector<FileStamp>& loaded_files,
+                    cpu_llm_project::LlmEngine& engine,
+                    std::string& message) {
+    if (yaml_path.empty()) {
+        message = "Nenhum arquivo YAML de persona em uso; nada para recarregar.";
+        return false;
+    }
+
+    AppConfig new_config;
+    if (!load_config_from_yaml(yaml_path, new_config)) {
+        message = "Falha ao carregar configuração de " + yaml_path + "; configuração atual mantida.";
+        return false;
+    }
+    apply_cli_overrides(new_config);
+    expand_config_paths(new_config);
+
+    auto new_files = loaded_file_stamps(new_config);
+    bool model_changed = force_model_reload
+        || new_config.model_gguf_path != config.model_gguf_path
+        || new_config.n_ctx != config.n_ctx
+        || new_config.num_threads != config.num_threads
+        || new_config.max_sequences != config.max_sequences
+        || new_config.prefill_threads != config.prefill_threads
+        || new_config.decode_threads != config.decode_threads
+        || new_config.threadpool_poll != config.threadpool_poll
+        || new_config.threadpool_partition != config.threadpool_partition
+        || new_config.disaggregate_prefill != config.disaggregate_prefill
+        || new_config.n_batch != config.n_batch
+        || new_config.n_ubatch != config.n_ubatch
+        || new_config.kv_cache_type != config.kv_cache_type
+        || new_config.flash_attn != config.flash_attn
+        || !same_lora_files(new_config, config)
+        || new_files != loaded_files;
+
+    if (model_changed) {
+        std::cout << "Info: Carregando modelo '" << new_config.model_gguf_path << "' em segundo plano..." << std::endl;
+        // O orçamento novo já vale para a checagem do novo modelo.
+        engine.set_memory_budget(new_config.memory_budget_mb * 1024 * 1024);
+        if (!engine.reload_model(make_load_params(new_config))) {
+            engine.set_memory_budget(config.memory_budget_mb * 1024 * 1024);
+            message = engine.get_last_error() + " Modelo atual mantido.";
+            return false;
+        }
+        loaded_files = new_files;
+        message = "Persona e modelo recarregados.";
+    } else {
+        message = "Persona recarregada (modelo inalterado).";
+    }
+
+    engine.set_response_cache_capacity(new_config.response_cache_mb * 1024 * 1024);
+    engine.set_memory_budget(new_config.memory_budget_mb * 1024 * 1024);
+    apply_trace_config(new_config);
+    config = new_config;
+    return true;
+}
+
+// Subcomando "quantize": converte um GGUF para outro tipo de quantização e sai.
+// Uso: quantize <entrada.gguf> <saida.gguf> [tipo] [--threads N] [--imatrix arquivo]
+//               [--allow-requantize] [--leave-output-tensor] [--pure]
+int run_quantize_command(int argc, char* argv[]) {
+    cpu_llm_project::QuantizeOptions options;
+    std::vector<std::string> positional;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads") {
+            if (i + 1 < argc) {
+                try { options.threads = std::stoi(argv[++i]); } catch (...) { std::cerr << "Aviso: Valor inválido para --threads: " << argv[i] << std::endl; }
+            } else { std::cerr << "Aviso: Flag --threads requer um argumento." << std::endl; }
+        } else if (arg == "--imatrix") {
+            if (i + 1 < argc) { options.imatrix_path = argv[++i]; } else { std::cerr << "Aviso: Flag --imatrix requer um arquivo." << std::endl; }
+        } else if (arg == "--allow-requantize") {
+            options.allow_requantize = true;
+        } else if (arg == "--leave-output-tensor") {
+            options.leave_output_tensor = true;
+        } else if (arg == "--pure") {
+            options.pure = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Aviso: Flag desconhecida ignorada: " << arg << std::endl;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2 || positional.size() > 3) {
+        std::cerr << "Uso: " << argv[0] << " quantize <entrada.gguf> <saida.gguf> [tipo] [--threads N] [--imatrix arquivo]"
+                  << " [--allow-requantize] [--leave-output-tensor] [--pure]" << std::endl;
+        std::cerr << "Tipos:";
+        for (const std::string& type : cpu_llm_project::quantizer::supported_types()) { std::cerr << " " << type; }
+        std::cerr << " (padrão: " << options.type << ")" << std::endl;
+        return 1;
+    }
+    options.input_path = positional[0];
+    options.output_path = positional[1];
+    if (positional.size() == 3) { options.type = positional[2]; }
+
+    std::cout << "Info: Quantizando '" << options.input_path << "' -> '" << options.output_path << "' (" << options.type
+              << ", " << (options.threads > 0 ? std::to_string(options.threads) : std::string("todas as")) << " threads"
+              << (options.imatrix_path.empty() ? std::string() : ", imatrix '" + options.imatrix_path + "'") << ")" << std::endl;
+
+    auto report_progress = [](const cpu_llm_project::QuantizeProgress& progress) {
+        std::cout << "\r[" << progress.current << "/" << progress.total << "] "
+                  << (100 * progress.current / progress.total) << "% " << progress.tensor_name << "\x1b[K" << std::flush;
+    };
+
+    cpu_llm_project::QuantizeResult result;
+    std::string error;
+    llama_backend_init(); // quantize_model deixa o backend a cargo de quem chama
+    const bool quantized = cpu_llm_project::quantizer::quantize_model(options, result, error, report_progress);
+    llama_backend_free();
+    if (!quantized) {
+        std::cout << std::endl;
+        std::cerr << "Erro: Falha na quantização: " << error << std::endl;
+        return 1;
+    }
+    std::cout << std::endl;
+
+    const double ratio = result.input_bytes > 0 ? static_cast<double>(result.output_bytes) / static_cast<double>(result.input_bytes) : 0.0;
+    std::ostringstream summary;
+    summary.setf(std::ios::fixed);
+    summary.precision(1);
+    summary << "Quantização concluída: " << result.tensors << " tensores em " << result.seconds << " s\n"
+            << "  Entrada: " << cpu_llm_project::memory_stats::format_mib(result.input_bytes) << "\n"
+            << "  Saída:   " << cpu_llm_project::memory_stats::format_mib(result.output_bytes)
+            << " (" << ratio * 100.0 << "% da entrada)\n"
+            << "  Vazão:   " << result.input_mib_per_second() << " MiB/s de entrada";
+    if (result.imatrix_entries > 0) {
+        summary << "\n  imatrix: " << result.imatrix_entries << " tensores com dados de importância";
+    }
+    std::cout << summary.str() << std::endl;
+    return 0;
+}
+
+// Grava (ou substitui) a entrada desta máquina em 'hardware_profiles' no YAML da persona.
+// Só o bloco hardware_profiles é reescrito; o resto do arquivo, comentários inclusive,
+// fica como está. A escrita passa por um arquivo temporário para não deixar o YAML pela
+// metade se o processo morrer no meio.
+bool write_hardware_profile(const std::string& yaml_path, const std::string& model_path,
+                            cpu_llm_project::TuneObjective objective,
+                            const cpu_llm_project::AutotuneResult& result,
+                            bool dry_run, std::string& error) {
+    std::ifstream in(yaml_path);
+    if (!in) {
+        error = "não foi possível ler " + yaml_path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    in.close();
+
+    YAML::Node profiles(YAML::NodeType::Map);
+    try {
+        YAML::Node root = YAML::Load(text);
+        if (root["hardware_profiles"] && root["hardware_profiles"].IsMap()) {
+            profiles = YAML::Clone(root["hardware_profiles"]);
+        }
+    } catch (const YAML::Exception& e) {
+        error = std::string("YAML inválido: ") + e.what();
+        return false;
+    }
+
+    auto rounded = [](double value) {
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        out.precision(1);
+        out << value;
+        return out.str();
+    };
+    char tuned_at[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(tuned_at, sizeof(tuned_at), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    const cpu_llm_project::TuneConfig& best = result.best;
+    YAML::Node entry(YAML::NodeType::Map);
+    entry["model"] = std::filesystem::path(model_path).filename().string();
+    entry["objective"] = cpu_llm_project::autotune::objective_name(objective);
+    entry["prefill_threads"] = best.prefill_threads;
+    entry["decode_threads"] = best.decode_threads;
+    entry["n_batch"] = best.n_batch;
+    entry["n_ubatch"] = best.n_ubatch;
+    entry["kv_cache_type"] = best.kv_cache_type;
+    entry["flash_attn"] = best.flash_attn;
+    entry["decode_tok_s"] = rounded(result.best_measurement.decode_tok_s);
+    entry["prefill_tok_s"] = rounded(result.best_measurement.prefill_tok_s);
+    entry["ttft_ms"] = rounded(result.best_measurement.ttft_ms);
+    entry["tuned_at"] = std::string(tuned_at);
+    profiles[result.fingerprint] = entry;
+
+    YAML::Node wrapper(YAML::NodeType::Map);
+    wrapper["hardware_profiles"] = profiles;
+    YAML::Emitter emitter;
+    emitter << wrapper;
+    const std::string block = std::string(emitter.c_str()) + "\n";
+
+    if (dry_run) {
+        std::cout << block;
+        return true;
+    }
+
+    // Bloco existente: a linha "hardware_profiles:" na coluna 0 e as linhas indentadas
+    // seguintes, até a próxima chave de topo (linhas em branco no fim ficam fora).
+    size_t start = std::string::npos;
+    for (size_t pos = 0; pos < text.size(); pos = text.find('\n', pos) + 1) {
+        if (text.compare(pos, 18, "hardware_profiles:") == 0) { start = pos; break; }
+        if (text.find('\n', pos) == std::string::npos) { break; }
+    }
+    if (start != std::string::npos) {
+        size_t end = text.find('\n', start);
+        end = end == std::string::npos ? text.size() : end + 1;
+        for (size_t pos = end; pos < text.size();) {
+            size_t line_end = text.find('\n', pos);
+            line_end = line_end == std::string::npos ? text.size() : line_end + 1;
+            const char first = text[pos];
+            if (first == ' ' || first == '\t') {
+                end = line_end;
+            } else if (first != '\n' && first != '\r') {
+                break;
+            }
+            pos = line_end;
+        }
+        text.replace(start, end - start, block);
+    } else {
+        if (!text.empty() && text.back() != '\n') { text += '\n'; }
+        text += "\n# Ajustes por máquina gravados por `autotune` (veja o README). A entrada cujo\n"
+                "# fingerprint corresponde à CPU atual sobrescreve as chaves de topo acima.\n" + block;
+    }
+
+    // Se o YAML for um symlink (ex.: personas/ apontando para um repositório de configs), o
+    // rename substituiria o link por um arquivo comum: grava ao lado do arquivo real. O
+    // temporário também recebe as permissões do original, em vez das padrão do umask.
+    std::error_code ec;
+    std::filesystem::path target = std::filesystem::canonical(yaml_path, ec);
+    if (ec) { target = yaml_path; }
+    const std::filesystem::perms mode = std::filesystem::status(target, ec).permissions();
+    const bool keep_mode = !ec;
+    const std::string tmp_path = target.string() + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        out << text;
+        if (!out) {
+            error = "não foi possível escrever " + tmp_path;
+            return false;
+        }
+    }
+    if (keep_mode) {
+        std::filesystem::permissions(tmp_path, mode, std::filesystem::perm_options::replace, ec);
+        if (ec) { std::cerr << "Aviso: não foi possível copiar as permissões de " << target.string() << ": " << ec.message() << std::endl; }
+    }
+    std::filesystem::rename(tmp_path, target, ec);
+    if (ec) {
+        std::remove(tmp_path.c_str());
+        error = "não foi possível substituir " + target.string() + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+// Subcomando "autotune": mede combinações de threads, batch, cache KV e flash attention com
+// o modelo da persona e grava a melhor em 'hardware_profiles', sob o fingerprint da CPU.
+// Uso: autotune (<persona.yaml> | --run <nome>) [--objective decode|prefill|ttft]
+//               [--prefill-tokens N] [--decode-tokens N] [--repetitions N] [--dry-run]
+int run_autotune_command(int argc, char* argv[]) {
+    cpu_llm_project::AutotuneOptions options;
+    std::string yaml_path;
+    bool dry_run = false;
+    auto int_flag = [&](int& i, const std::string& flag, int& value) {
+        if (i + 1 < argc) {
+            try { value = std::stoi(argv[++i]); } catch (...) { std::cerr << "Aviso: Valor inválido para " << flag << ": " << argv[i] << std::endl; }
+        } else { std::cerr << "Aviso: Flag " << flag << " requer um argumento." << std::endl; }
+    };
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--run") {
+            if (i + 1 < argc) { yaml_path = "./personas/" + std::string(argv[++i]) + ".yaml"; } else { std::cerr << "Aviso: Flag --run requer um nome de persona." << std::endl; }
+        } else if (arg == "--objective") {
+            if (i + 1 < argc && !cpu_llm_project::autotune::parse_objective(argv[++i], options.objective)) {
+                std::cerr << "Erro: Objetivo desconhecido '" << argv[i] << "' (use decode, prefill ou ttft)." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--prefill-tokens") {
+            int_flag(i, arg, options.prefill_tokens);
+        } else if (arg == "--decode-tokens") {
+            int_flag(i, arg, options.decode_tokens);
+        } else if (arg == "--repetitions") {
+            int_flag(i, arg, options.repetitions);
+        } else if (arg == "--dry-run") {
+            dry_run = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Aviso: Flag desconhecida ignorada: " << arg << std::endl;
+        } else {
+            yaml_path = arg;
+        }
+    }
+
+    if (yaml_path.empty()) {
+        std::cerr << "Uso: " << argv[0] << " autotune (<persona.yaml> | --run <nome>) [--objective decode|prefill|ttft]"
+                  << " [--prefill-tokens N] [--decode-tokens N] [--repetitions N] [--dry-run]" << std::endl;
+        return 1;
+    }
+
+    AppConfig config;
+    if (!load_config_from_yaml(yaml_path, config)) {
+        std::cerr << "Erro: Falha ao carregar configuração de " << yaml_path << std::endl;
+        return 1;
+    }
+    expand_config_paths(config);
+    options.model_path = config.model_gguf_path;
+    options.n_ctx = config.n_ctx;
+    options.n_seq_max = config.max_sequences;
+    options.threadpool_poll = static_cast<uint32_t>(std::max(0, std::min(config.threadpool_poll, 100)));
+
+    std::cout << "Info: Autotune de '" << options.model_path << "' (objetivo: "
+              << cpu_llm_project::autotune::objective_name(options.objective) << ", prompt de "
+              << options.prefill_tokens << " tokens, " << options.decode_tokens << " passos de geração)" << std::endl;
+    std::cout << "Info: Hardware: " << cpu_llm_project::autotune::hardware_fingerprint() << std::endl;
+
+    int trial = 0;
+    auto report_trial = [&](const cpu_llm_project::TuneConfig& tried, const cpu_llm_project::TuneMeasurement& m) {
+        std::ostringstream line;
+        line.setf(std::ios::fixed);
+        line.precision(1);
+        line << "[" << ++trial << "] " << tried.to_string() << ": ";
+        if (m.ok) {
+            line << "prefill " << m.prefill_tok_s << " tok/s, decode " << m.decode_tok_s << " tok/s, TTFT " << m.ttft_ms << " ms";
+        } else {
+            line << "falhou (" << m.error << ")";
+        }
+        std::cout << line.str() << std::endl;
+    };
+
+    cpu_llm_project::AutotuneResult result;
+    std::string error;
+    llama_backend_init(); // autotune::run deixa o backend a cargo de quem chama
+    const bool tuned = cpu_llm_project::autotune::run(options, result, error, report_trial);
+    llama_backend_free();
+    if (!tuned) {
+        std::cerr << "Erro: Autotune falhou: " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Melhor combinação (" << result.trials << " medidas): " << result.best.to_string() << std::endl;
+
+    if (!write_hardware_profile(yaml_path, options.model_path, options.objective, result, dry_run, error)) {
+        std::cerr << "Erro: Falha ao gravar o perfil em " << yaml_path << ": " << error << std::endl;
+        return 1;
+    }
+    if (!dry_run) {
+        std::cout << "Perfil gravado em " << yaml_path << " (hardware_profiles)." << std::endl;
+    }
+    return 0;
+}
+
+// Setado pelo handler de SIGHUP e consumido pela thread de recarga do modo servidor.
+volatile std::sig_atomic_t g_reload_requested = 0;
+
+extern "C" void handle_reload_signal(int /*signal*/) {
+    g_reload_requested = 1;
+}
+
 
 int main(int argc, char* argv[]) {
     std::cout << "CPU LLM Project - Início" << std::endl;
@@ -164,6 +772,13 @@ int main(int argc, char* argv[]) {
         std::cout << "Nenhum argumento recebido." << std::endl;
     }
 
+    if (argc > 1 && std::string(argv[1]) == "quantize") {
+        return run_quantize_command(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "autotune") {
+        return run_autotune_command(argc, argv);
+    }
+
     // Chamando uma função da nossa biblioteca (exemplo antigo)
     // cpu_llm_project::print_avx_message_from_lib();
     // std::cout << "Greeting from lib: " << cpu_llm_project::get_greeting("Main") << std::endl;
@@ -173,7 +788,10 @@ int main(int argc, char* argv[]) {
 
     if (argc < 2) {
         std::cerr << "Uso: " << argv[0] << " (<caminho_para_config.yaml> | <caminho_para_modelo.gguf> | --run <nome_persona>) [opções...]" << std::endl;
-        std::cerr << "Opções: --interactive, --threads N, --host HOST, --port P, --n_ctx N" << std::endl;
+        std::cerr << "Opções: --interactive, --threads N, --host HOST, --port P, --n_ctx N, --unix-socket PATH" << std::endl;
+        std::cerr << "Roteador: --router [--workers N] [--worker-addr unix:/x.sock|host:porta ...]" << std::endl;
+        std::cerr << "Quantização: " << argv[0] << " quantize <entrada.gguf> <saida.gguf> [tipo] [opções...]" << std::endl;
+        std::cerr << "Autotune: " << argv[0] << " autotune (<config.yaml> | --run <nome_persona>) [--objective decode|prefill|ttft] [--dry-run]" << std::endl;
         // Adicionar mais detalhes sobre --list e --create no futuro
         return 1;
     }
@@ -182,6 +800,10 @@ int main(int argc, char* argv[]) {
 
     // Parâmetros de CLI que podem sobrescrever YAML/padrões
     std::string cli_host;
+    std::string cli_unix_socket;
+    bool router_flag = false;
+    int cli_router_workers = -1;
+    std::vector<std::string> cli_worker_addresses;
     int cli_port = -1; // -1 indica não definido pela CLI
     int cli_n_ctx = -1;
     int cli_num_threads = -1;
@@ -206,6 +828,16 @@ int main(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 try { cli_port = std::stoi(argv[++i]); } catch (...) { std::cerr << "Aviso: Valor inválido para --port: " << argv[i] << std::endl; }
             } else { std::cerr << "Aviso: Flag --port requer um argumento." << std::endl; }
+        } else if (arg == "--router") {
+            router_flag = true;
+        } else if (arg == "--workers") {
+            if (i + 1 < argc) {
+                try { cli_router_workers = std::stoi(argv[++i]); } catch (...) { std::cerr << "Aviso: Valor inválido para --workers: " << argv[i] << std::endl; }
+            } else { std::cerr << "Aviso: Flag --workers requer um argumento." << std::endl; }
+        } else if (arg == "--worker-addr") {
+            if (i + 1 < argc) { cli_worker_addresses.push_back(argv[++i]); } else { std::cerr << "Aviso: Flag --worker-addr requer um endereço." << std::endl; }
+        } else if (arg == "--unix-socket") {
+            if (i + 1 < argc) { cli_unix_socket = argv[++i]; } else { std::cerr << "Aviso: Flag --unix-socket requer um caminho." << std::endl; }
         } else if (arg == "--n_ctx") {
             if (i + 1 < argc) {
                 try { cli_n_ctx = std::stoi(argv[++i]); } catch (...) { std::cerr << "Aviso: Valor inválido para --n_ctx: " << argv[i] << std::endl; }
@@ -252,11 +884,22 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Sobrescrever configurações do YAML com flags da CLI, se fornecidas
-    if (!cli_host.empty()) config.api_host = cli_host;
-    if (cli_port != -1) config.api_port = cli_port;
-    if (cli_n_ctx != -1) config.n_ctx = cli_n_ctx > 0 ? cli_n_ctx : config.n_ctx;
-    if (cli_num_threads != -1) config.num_threads = cli_num_threads; // LlmEngine trata <=0 como padrão
+    // Sobrescrever configurações do YAML com flags da CLI, se fornecidas.
+    // Reaplicado a cada recarga da persona para que a CLI continue tendo prioridade.
+    auto apply_cli_overrides = [&](AppConfig& target) {
+        if (!cli_host.empty()) target.api_host = cli_host;
+        if (cli_port != -1) target.api_port = cli_port;
+        if (!cli_unix_socket.empty()) target.server_options.unix_socket_path = cli_unix_socket;
+        if (cli_n_ctx != -1) target.n_ctx = cli_n_ctx > 0 ? cli_n_ctx : target.n_ctx;
+        if (cli_num_threads != -1) target.num_threads = cli_num_threads; // LlmEngine trata <=0 como padrão
+        // --threads explícito também limita os pools de prefill e decode vindos do YAML ou do
+        // perfil de hardware; sem isso eles passariam por cima do valor pedido na CLI.
+        if (cli_num_threads > 0) {
+            if (target.prefill_threads > cli_num_threads) target.prefill_threads = cli_num_threads;
+            if (target.decode_threads > cli_num_threads) target.decode_threads = cli_num_threads;
+        }
+    };
+    apply_cli_overrides(config);
 
     // Verificar se o caminho do modelo GGUF é válido após todas as análises
     if (config.model_gguf_path.empty()) {
@@ -265,15 +908,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Expandir ~ para o diretório home do usuário, se aplicável
-    if (!config.model_gguf_path.empty() && config.model_gguf_path[0] == '~') {
-        const char* home_dir = getenv("HOME");
-        if (home_dir) {
-            config.model_gguf_path.replace(0, 1, home_dir);
-            std::cout << "Info: Caminho do modelo expandido para: " << config.model_gguf_path << std::endl;
-        } else {
-            std::cerr << "Aviso: Não foi possível expandir '~' no caminho do modelo porque a variável de ambiente HOME não está definida. Tentando usar o caminho como está." << std::endl;
-        }
-    }
+    expand_config_paths(config);
 
     std::ifstream model_check_file(config.model_gguf_path);
     if (!model_check_file.good()) {
@@ -282,6 +917,44 @@ int main(int argc, char* argv[]) {
     }
     model_check_file.close();
 
+    // Modo roteador: este processo não carrega modelo; distribui as requisições entre workers.
+    // Só a flag --router ativa o modo (nunca o YAML), para que os workers iniciados com o mesmo
+    // YAML não virem roteadores também.
+    if (router_flag) {
+        cpu_llm_project::RouterOptions router_options;
+        router_options.host = config.api_host;
+        router_options.port = config.api_port;
+        router_options.server = config.server_options;
+        router_options.worker_addresses = cli_worker_addresses.empty() ? config.router_worker_addresses : cli_worker_addresses;
+        router_options.spawn_workers = cli_router_workers >= 0 ? cli_router_workers : config.router_workers;
+        router_options.max_inflight_per_worker = std::max(1, config.router_max_inflight);
+        router_options.health_interval_ms = std::max(100, config.router_health_interval_ms);
+        router_options.restart_after_failures = std::max(1, config.router_restart_after_failures);
+        router_options.socket_dir = config.router_socket_dir;
+
+        // Os workers são este mesmo executável, com a mesma configuração. /proc/self/exe cobre
+        // o caso de o binário ter sido encontrado pelo PATH (argv[0] sem diretório).
+        std::error_code exe_ec;
+        std::filesystem::path self_exe = std::filesystem::read_symlink("/proc/self/exe", exe_ec);
+        router_options.worker_command.push_back(exe_ec ? std::string(argv[0]) : self_exe.string());
+        if (!persona_to_run.empty()) {
+            router_options.worker_command.insert(router_options.worker_command.end(), {"--run", persona_to_run});
+        } else {
+            router_options.worker_command.push_back(argv[1]);
+        }
+        if (cli_n_ctx != -1) {
+            router_options.worker_command.insert(router_options.worker_command.end(), {"--n_ctx", std::to_string(cli_n_ctx)});
+        }
+
+        cpu_llm_project::Router router(router_options);
+        if (!router.start()) {
+            std::cerr << "Erro fatal: Falha ao iniciar o roteador." << std::endl;
+            return 1;
+        }
+        std::cout << "CPU LLM Project - Roteador encerrado." << std::endl;
+        return 0;
+    }
+
 
     // Decidir o modo de execução
     // Se host ou port foram definidos (via CLI ou YAML) E --interactive não foi passado, rodar servidor.
@@ -299,7 +972,7 @@ int main(int argc, char* argv[]) {
         // Se vieram do YAML, precisamos de uma lógica para decidir.
         // Por simplicidade agora: se --interactive não foi passada, e (cli_host foi setado OU cli_port foi setado), então modo servidor.
         // Ou se apenas o .gguf foi passado, modo interativo.
-        if (!cli_host.empty() || cli_port != -1) { // Se host ou port foram explicitamente passados na CLI
+        if (!cli_host.empty() || cli_port != -1 || !cli_unix_socket.empty()) { // Flags de servidor passadas na CLI
              run_server_mode = true;
         } else if (yaml_path_from_arg.empty() && persona_to_run.empty() && argc > 2) {
             // Caso legado: ./programa modelo.gguf host port
@@ -326,21 +999,66 @@ int main(int argc, char* argv[]) {
 
 
     cpu_llm_project::LlmEngine engine;
-    if (!engine.load_model(config.model_gguf_path, config.n_ctx, 0, config.num_threads)) {
+    engine.set_memory_budget(config.memory_budget_mb * 1024 * 1024);
+    if (!engine.load_model(make_load_params(config))) {
         std::cerr << "Erro fatal: Não foi possível carregar o modelo: " << config.model_gguf_path << std::endl;
+        std::cerr << engine.get_last_error() << std::endl;
         return 1;
     }
     std::cout << "Modelo '" << config.model_gguf_path << "' carregado com sucesso no LlmEngine." << std::endl;
+    engine.set_response_cache_capacity(config.response_cache_mb * 1024 * 1024);
+    apply_trace_config(config);
+
+    std::vector<FileStamp> loaded_files = loaded_file_stamps(config);
+    std::mutex config_mutex; // Serializa recargas vindas do SIGHUP e do endpoint de admin
 
     if (run_server_mode) {
         // Iniciar o servidor API
-        cpu_llm_project::ApiServer server(engine, config.api_host, config.api_port);
+        // As opções do front end HTTP valem para toda a execução; recargas da persona não as alteram.
+        cpu_llm_project::ApiServer server(engine, config.api_host, config.api_port, config.server_options);
+        server.set_persona_defaults(config.system_prompt, make_generation_params(config));
+
+        auto do_reload = [&](bool force_model_reload, std::string& message) {
+            std::lock_guard<std::mutex> lock(config_mutex);
+            if (!reload_persona(effective_yaml_path, apply_cli_overrides, force_model_reload,
+                                config, loaded_files, engine, message)) {
+                return false;
+            }
+            server.set_persona_defaults(config.system_prompt, make_generation_params(config));
+            return true;
+        };
+        server.set_reload_handler(do_reload);
+
+        // SIGHUP pede a recarga da persona. O handler só marca a flag; a recarga (que pode
+        // carregar um modelo de vários GB) roda nesta thread auxiliar, fora do contexto do sinal.
+        std::atomic<bool> reload_watcher_running{true};
+#ifdef SIGHUP
+        std::signal(SIGHUP, handle_reload_signal);
+#endif
+        std::thread reload_watcher([&]() {
+            while (reload_watcher_running) {
+                if (g_reload_requested) {
+                    g_reload_requested = 0;
+                    std::string message;
+                    if (do_reload(false, message)) {
+                        std::cout << "Info: SIGHUP: " << message << std::endl;
+                    } else {
+                        std::cerr << "Erro: SIGHUP: " << message << std::endl;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        });
+
         std::cout << "Iniciando servidor API em " << config.api_host << ":" << config.api_port << std::endl;
 
         // Adicionar um handler de sinal para parar o servidor graciosamente (opcional, mas bom para Ctrl+C)
         // std::signal(SIGINT, [](int signal){ server.stop(); }); // Precisa que 'server' seja acessível
 
-        if (!server.start()) { // start() agora é bloqueante
+        bool started = server.start(); // start() agora é bloqueante
+        reload_watcher_running = false;
+        reload_watcher.join();
+        if (!started) {
             std::cerr << "Erro fatal: Falha ao iniciar o servidor API." << std::endl;
             return 1;
         }
@@ -361,6 +1079,14 @@ int main(int argc, char* argv[]) {
                 std::string command = line.substr(2); // Extrai o comando
                 if (command == "sair" || command == "exit" || command == "quit") {
                     break;
+                } else if (command == "reload" || command == "recarregar") {
+                    std::string message;
+                    if (reload_persona(effective_yaml_path, apply_cli_overrides, false,
+                                       config, loaded_files, engine, message)) {
+                        std::cout << message << std::endl;
+                    } else {
+                        std::cerr << "Erro: " << message << std::endl;
+                    }
                 } else {
                     std::cout << "Comando desconhecido: " << command << std::endl;
                 }
@@ -375,11 +1101,7 @@ int main(int argc, char* argv[]) {
             // Passar o system_prompt e os parâmetros de amostragem da struct AppConfig
             std::string response = engine.predict(line,
                                                   config.system_prompt,
-                                                  config.max_tokens,
-                                                  config.model_temperature,
-                                                  config.model_top_k,
-                                                  config.model_top_p,
-                                                  config.model_repeat_penalty);
+                                                  make_generation_params(config));
             std::cout << "Resposta: " << response << std::endl;
         }
         std::cout << "CPU LLM Project - Modo interativo encerrado." << std::endl;
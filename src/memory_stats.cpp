@@ -0,0 +1,201 @@
+#include "cpu_llm_project/memory_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "gguf.h"
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <sys/sysmacros.h> // major, minor
+#include <unistd.h>
+#endif
+
+namespace cpu_llm_project {
+namespace memory_stats {
+
+namespace {
+
+// Lê um inteiro dos metadados. Alguns modelos guardam valores por camada como array
+// (ex.: head_count_kv); nesse caso usamos o maior, que é o que limita a memória.
+bool get_gguf_uint(const gguf_context* ctx, const std::string& key, size_t& value) {
+    const int64_t key_id = gguf_find_key(ctx, key.c_str());
+    if (key_id < 0) { return false; }
+    switch (gguf_get_kv_type(ctx, key_id)) {
+        case GGUF_TYPE_UINT32: value = gguf_get_val_u32(ctx, key_id); return true;
+        case GGUF_TYPE_INT32:  value = static_cast<size_t>(std::max(0, gguf_get_val_i32(ctx, key_id))); return true;
+        case GGUF_TYPE_ARRAY: {
+            const gguf_type arr_type = gguf_get_arr_type(ctx, key_id);
+            if (arr_type != GGUF_TYPE_UINT32 && arr_type != GGUF_TYPE_INT32) { return false; }
+            const size_t n = gguf_get_arr_n(ctx, key_id);
+            const auto* data = static_cast<const int32_t*>(gguf_get_arr_data(ctx, key_id));
+            value = 0;
+            for (size_t i = 0; i < n; ++i) {
+                value = std::max(value, static_cast<size_t>(std::max(0, data[i])));
+            }
+            return n > 0;
+        }
+        default: return false;
+    }
+}
+
+} // namespace
+
+size_t process_rss_bytes() {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+bool mapped_file_id(const std::string& path, MappedFileId& id) {
+#if defined(__linux__)
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) { return false; }
+    id.device = (static_cast<uint64_t>(major(st.st_dev)) << 32) | minor(st.st_dev);
+    id.inode = static_cast<uint64_t>(st.st_ino);
+    return true;
+#else
+    (void)path;
+    (void)id;
+    return false;
+#endif
+}
+
+size_t smaps_resident_bytes(std::istream& smaps, const MappedFileId& id) {
+    // Rss de cada trecho (offset, tamanho) do arquivo; trechos repetidos ficam com o maior.
+    std::map<std::pair<uint64_t, uint64_t>, size_t> resident_kb;
+    std::pair<uint64_t, uint64_t> current;
+    bool in_mapping = false;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        // Cabeçalho de mapeamento: "início-fim perms offset major:minor inode [caminho]".
+        // As linhas de campos ("Rss:   123 kB") começam com uma palavra terminada em ':'.
+        const size_t first_space = line.find(' ');
+        if (first_space == std::string::npos || first_space == 0) { continue; }
+        if (line[first_space - 1] != ':') {
+            std::istringstream header(line);
+            std::string range, perms, offset, device;
+            uint64_t inode = 0;
+            in_mapping = false;
+            if (!(header >> range >> perms >> offset >> device >> inode) || inode != id.inode) { continue; }
+            const size_t dash = range.find('-');
+            const size_t colon = device.find(':');
+            if (dash == std::string::npos || colon == std::string::npos) { continue; }
+            const uint64_t dev = (std::strtoull(device.c_str(), nullptr, 16) << 32) |
+                                 std::strtoull(device.c_str() + colon + 1, nullptr, 16);
+            if (dev != id.device) { continue; }
+            const uint64_t begin = std::strtoull(range.c_str(), nullptr, 16);
+            const uint64_t end = std::strtoull(range.c_str() + dash + 1, nullptr, 16);
+            current = {std::strtoull(offset.c_str(), nullptr, 16), end - begin};
+            in_mapping = true;
+        } else if (in_mapping && line.compare(0, 4, "Rss:") == 0) {
+            size_t& kb = resident_kb[current];
+            kb = std::max(kb, static_cast<size_t>(std::strtoull(line.c_str() + 4, nullptr, 10)));
+        }
+    }
+    size_t total_kb = 0;
+    for (const auto& entry : resident_kb) { total_kb += entry.second; }
+    return total_kb * 1024;
+}
+
+size_t mapped_file_resident_bytes(const MappedFileId& id) {
+#if defined(__linux__)
+    if (!id.valid()) { return 0; }
+    std::ifstream smaps("/proc/self/smaps");
+    return smaps ? smaps_resident_bytes(smaps, id) : 0;
+#else
+    (void)id;
+    return 0;
+#endif
+}
+
+size_t kv_cache_bytes(size_t n_ctx, size_t n_layer, size_t n_head_kv, size_t head_dim_k, size_t head_dim_v) {
+    const size_t f16_size = 2;
+    return n_ctx * n_layer * n_head_kv * (head_dim_k + head_dim_v) * f16_size;
+}
+
+bool estimate_model_memory(const std::string& model_path, int n_ctx, int n_batch,
+                           MemoryEstimate& estimate, std::string& error) {
+    // no_alloc: só o cabeçalho e os metadados são lidos, não os dados dos tensores.
+    gguf_init_params params = {true, nullptr};
+    gguf_context* ctx = gguf_init_from_file(model_path.c_str(), params);
+    if (!ctx) {
+        error = "não foi possível ler o cabeçalho GGUF de '" + model_path + "'";
+        return false;
+    }
+
+    estimate = MemoryEstimate();
+    const int64_t n_tensors = gguf_get_n_tensors(ctx);
+    for (int64_t i = 0; i < n_tensors; ++i) {
+        estimate.weights_bytes += gguf_get_tensor_size(ctx, i);
+    }
+
+    std::string arch;
+    const int64_t arch_id = gguf_find_key(ctx, "general.architecture");
+    if (arch_id >= 0) { arch = gguf_get_val_str(ctx, arch_id); }
+
+    size_t n_layer = 0, n_embd = 0, n_head = 0, n_head_kv = 0, head_dim_k = 0, head_dim_v = 0;
+    if (arch.empty()
+        || !get_gguf_uint(ctx, arch + ".block_count", n_layer)
+        || !get_gguf_uint(ctx, arch + ".embedding_length", n_embd)
+        || !get_gguf_uint(ctx, arch + ".attention.head_count", n_head)
+        || n_head == 0) {
+        gguf_free(ctx);
+        error = "metadados de arquitetura ausentes em '" + model_path + "'";
+        return false;
+    }
+    if (!get_gguf_uint(ctx, arch + ".attention.head_count_kv", n_head_kv)) { n_head_kv = n_head; }
+    if (!get_gguf_uint(ctx, arch + ".attention.key_length", head_dim_k)) { head_dim_k = n_embd / n_head; }
+    if (!get_gguf_uint(ctx, arch + ".attention.value_length", head_dim_v)) { head_dim_v = n_embd / n_head; }
+
+    size_t n_vocab = 0;
+    const int64_t tokens_id = gguf_find_key(ctx, "tokenizer.ggml.tokens");
+    if (tokens_id >= 0) { n_vocab = gguf_get_arr_n(ctx, tokens_id); }
+    gguf_free(ctx);
+
+    const size_t ctx_cells = static_cast<size_t>(std::max(n_ctx, 1));
+    const size_t batch = static_cast<size_t>(std::max(std::min(n_batch, n_ctx), 1));
+    estimate.kv_bytes = kv_cache_bytes(ctx_cells, n_layer, n_head_kv, head_dim_k, head_dim_v);
+    // O buffer de computação é dimensionado para o pior grafo: um batch cheio com logits
+    // de todas as posições e a matriz KQ da atenção (sem flash attention).
+    estimate.compute_bytes = batch * (n_vocab + ctx_cells * n_head) * sizeof(float);
+    return true;
+}
+
+bool parse_buffer_log_line(const char* text, BufferKind& kind, size_t& bytes) {
+    const char* size_pos = std::strstr(text, "buffer size =");
+    if (!size_pos) { return false; }
+    const std::string prefix(text, size_pos);
+    if (prefix.find("KV") != std::string::npos) {
+        kind = BufferKind::Kv;
+    } else if (prefix.find("compute") != std::string::npos || prefix.find("output") != std::string::npos) {
+        kind = BufferKind::Compute;
+    } else {
+        return false; // Buffers dos pesos ("model buffer size") são contados por llama_model_size()
+    }
+    char* end = nullptr;
+    const double mib = std::strtod(size_pos + std::strlen("buffer size ="), &end);
+    if (end == size_pos + std::strlen("buffer size =") || mib < 0) { return false; }
+    bytes = static_cast<size_t>(mib * 1024.0 * 1024.0);
+    return true;
+}
+
+std::string format_mib(size_t bytes) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.1f MiB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    return buffer;
+}
+
+} // namespace memory_stats
+} // namespace cpu_llm_project
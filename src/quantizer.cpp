@@ -0,0 +1,319 @@
+#include "cpu_llm_project/quantizer.hpp"
+#include "cpu_llm_project/llama_log.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "llama.h"
+#include "gguf.h"
+
+namespace cpu_llm_project {
+
+namespace {
+
+struct QuantTypeInfo {
+    const char* name;
+    llama_ftype ftype;
+};
+
+// Mesmos nomes do llama-quantize. Os tipos IQ* usam tabelas de grade e são mais lentos de
+// decodificar em CPUs só com AVX; os _K costumam ser a melhor escolha nelas.
+const QuantTypeInfo kQuantTypes[] = {
+    {"Q4_0",    LLAMA_FTYPE_MOSTLY_Q4_0},
+    {"Q4_1",    LLAMA_FTYPE_MOSTLY_Q4_1},
+    {"Q5_0",    LLAMA_FTYPE_MOSTLY_Q5_0},
+    {"Q5_1",    LLAMA_FTYPE_MOSTLY_Q5_1},
+    {"Q8_0",    LLAMA_FTYPE_MOSTLY_Q8_0},
+    {"Q2_K",    LLAMA_FTYPE_MOSTLY_Q2_K},
+    {"Q2_K_S",  LLAMA_FTYPE_MOSTLY_Q2_K_S},
+    {"Q3_K_S",  LLAMA_FTYPE_MOSTLY_Q3_K_S},
+    {"Q3_K_M",  LLAMA_FTYPE_MOSTLY_Q3_K_M},
+    {"Q3_K_L",  LLAMA_FTYPE_MOSTLY_Q3_K_L},
+    {"Q4_K_S",  LLAMA_FTYPE_MOSTLY_Q4_K_S},
+    {"Q4_K_M",  LLAMA_FTYPE_MOSTLY_Q4_K_M},
+    {"Q5_K_S",  LLAMA_FTYPE_MOSTLY_Q5_K_S},
+    {"Q5_K_M",  LLAMA_FTYPE_MOSTLY_Q5_K_M},
+    {"Q6_K",    LLAMA_FTYPE_MOSTLY_Q6_K},
+    {"IQ1_S",   LLAMA_FTYPE_MOSTLY_IQ1_S},
+    {"IQ1_M",   LLAMA_FTYPE_MOSTLY_IQ1_M},
+    {"IQ2_XXS", LLAMA_FTYPE_MOSTLY_IQ2_XXS},
+    {"IQ2_XS",  LLAMA_FTYPE_MOSTLY_IQ2_XS},
+    {"IQ2_S",   LLAMA_FTYPE_MOSTLY_IQ2_S},
+    {"IQ2_M",   LLAMA_FTYPE_MOSTLY_IQ2_M},
+    {"IQ3_XXS", LLAMA_FTYPE_MOSTLY_IQ3_XXS},
+    {"IQ3_S",   LLAMA_FTYPE_MOSTLY_IQ3_S},
+    {"IQ3_M",   LLAMA_FTYPE_MOSTLY_IQ3_M},
+    {"IQ4_NL",  LLAMA_FTYPE_MOSTLY_IQ4_NL},
+    {"IQ4_XS",  LLAMA_FTYPE_MOSTLY_IQ4_XS},
+    {"F16",     LLAMA_FTYPE_MOSTLY_F16},
+    {"BF16",    LLAMA_FTYPE_MOSTLY_BF16},
+    {"F32",     LLAMA_FTYPE_ALL_F32},
+};
+
+std::string to_upper(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return value;
+}
+
+size_t file_size_or_zero(const std::string& path) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : static_cast<size_t>(size);
+}
+
+// Formato legado do llama-imatrix: n_entries, e para cada tensor
+// [len][nome][ncall][nval][nval floats]. Os valores são somas de ncall chamadas.
+bool load_legacy_imatrix(const std::string& path, ImatrixData& data, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "não foi possível abrir '" + path + "'";
+        return false;
+    }
+    int32_t n_entries = 0;
+    in.read(reinterpret_cast<char*>(&n_entries), sizeof(n_entries));
+    if (!in || n_entries < 1) {
+        error = "'" + path + "' não contém entradas de imatrix";
+        return false;
+    }
+    for (int32_t i = 0; i < n_entries; ++i) {
+        int32_t len = 0;
+        in.read(reinterpret_cast<char*>(&len), sizeof(len));
+        if (!in || len <= 0 || len > 4096) {
+            error = "entrada " + std::to_string(i) + " inválida em '" + path + "'";
+            return false;
+        }
+        std::string name(static_cast<size_t>(len), '\0');
+        in.read(&name[0], len);
+        int32_t ncall = 0, nval = 0;
+        in.read(reinterpret_cast<char*>(&ncall), sizeof(ncall));
+        in.read(reinterpret_cast<char*>(&nval), sizeof(nval));
+        if (!in || nval < 1) {
+            error = "tensor '" + name + "' sem valores em '" + path + "'";
+            return false;
+        }
+        std::vector<float>& values = data[name];
+        values.resize(static_cast<size_t>(nval));
+        in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(nval * sizeof(float)));
+        if (!in) {
+            error = "'" + path + "' termina no meio do tensor '" + name + "'";
+            return false;
+        }
+        if (ncall > 0) {
+            for (float& value : values) { value /= static_cast<float>(ncall); }
+        }
+    }
+    return true;
+}
+
+// Formato GGUF do llama-imatrix: para cada tensor, "<nome>.in_sum2" [n, n_mat] com as
+// somas e "<nome>.counts" [1, n_mat] com o número de chamadas de cada matriz.
+bool load_gguf_imatrix(const std::string& path, ImatrixData& data, std::string& error) {
+    ggml_context* tensors = nullptr;
+    gguf_init_params params = {false, &tensors};
+    gguf_context* ctx = gguf_init_from_file(path.c_str(), params);
+    if (!ctx) {
+        error = "não foi possível ler o GGUF '" + path + "'";
+        return false;
+    }
+
+    const std::string sums_suffix = ".in_sum2";
+    const int64_t n_tensors = gguf_get_n_tensors(ctx);
+    for (int64_t i = 0; i < n_tensors; ++i) {
+        const std::string tensor_name = gguf_get_tensor_name(ctx, i);
+        if (tensor_name.size() <= sums_suffix.size()
+            || tensor_name.compare(tensor_name.size() - sums_suffix.size(), sums_suffix.size(), sums_suffix) != 0) {
+            continue;
+        }
+        const std::string name = tensor_name.substr(0, tensor_name.size() - sums_suffix.size());
+        const ggml_tensor* sums = ggml_get_tensor(tensors, tensor_name.c_str());
+        const ggml_tensor* counts = ggml_get_tensor(tensors, (name + ".counts").c_str());
+        if (!sums || !counts || sums->type != GGML_TYPE_F32 || counts->type != GGML_TYPE_F32
+            || counts->ne[1] != sums->ne[1]) {
+            continue;
+        }
+        const int64_t ne0 = sums->ne[0];
+        const int64_t ne1 = sums->ne[1];
+        const float* sum_data = static_cast<const float*>(sums->data);
+        const float* count_data = static_cast<const float*>(counts->data);
+        std::vector<float>& values = data[name];
+        values.assign(static_cast<size_t>(ne0 * ne1), 1.0f); // Matrizes sem nenhuma chamada: peso neutro
+        for (int64_t j = 0; j < ne1; ++j) {
+            if (count_data[j] <= 0.0f) { continue; }
+            for (int64_t k = 0; k < ne0; ++k) {
+                values[j * ne0 + k] = sum_data[j * ne0 + k] / count_data[j];
+            }
+        }
+    }
+    gguf_free(ctx);
+    ggml_free(tensors);
+
+    if (data.empty()) {
+        error = "'" + path + "' não contém tensores de imatrix";
+        return false;
+    }
+    return true;
+}
+
+struct QuantizeLogState {
+    const std::function<void(const QuantizeProgress&)>* on_progress = nullptr;
+    int last_total = 0;
+    std::string last_error;
+};
+
+void quantize_log_callback(ggml_log_level level, const char* text, void* user_data) {
+    QuantizeLogState* state = static_cast<QuantizeLogState*>(user_data);
+    QuantizeProgress progress;
+    if (quantizer::parse_progress_line(text, progress)) {
+        state->last_total = progress.total;
+        if (*state->on_progress) { (*state->on_progress)(progress); }
+        return;
+    }
+    if (level == GGML_LOG_LEVEL_ERROR || level == GGML_LOG_LEVEL_WARN) {
+        fprintf(stderr, "[LlamaLog] %s", text);
+        fflush(stderr);
+        if (level == GGML_LOG_LEVEL_ERROR) {
+            state->last_error = text;
+            while (!state->last_error.empty() && std::isspace(static_cast<unsigned char>(state->last_error.back()))) {
+                state->last_error.pop_back();
+            }
+        }
+    }
+}
+
+} // namespace
+
+double QuantizeResult::input_mib_per_second() const {
+    if (seconds <= 0.0) { return 0.0; }
+    return static_cast<double>(input_bytes) / (1024.0 * 1024.0) / seconds;
+}
+
+namespace quantizer {
+
+std::vector<std::string> supported_types() {
+    std::vector<std::string> names;
+    for (const QuantTypeInfo& info : kQuantTypes) { names.push_back(info.name); }
+    return names;
+}
+
+bool parse_quant_type(const std::string& name, int& ftype) {
+    const std::string upper = to_upper(name);
+    for (const QuantTypeInfo& info : kQuantTypes) {
+        if (upper == info.name) {
+            ftype = static_cast<int>(info.ftype);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool requires_imatrix(const std::string& name) {
+    const std::string upper = to_upper(name);
+    return upper == "IQ1_S" || upper == "IQ1_M" || upper == "IQ2_XXS" || upper == "IQ2_XS"
+        || upper == "IQ2_S" || upper == "Q2_K_S";
+}
+
+bool parse_progress_line(const char* text, QuantizeProgress& progress) {
+    while (*text == ' ') { ++text; }
+    int current = 0, total = 0;
+    char name[256] = {0};
+    if (std::sscanf(text, "[%d/%d] %255s", &current, &total, name) != 3 || current < 1 || total < current) {
+        return false;
+    }
+    progress.current = current;
+    progress.total = total;
+    progress.tensor_name = name;
+    return true;
+}
+
+bool load_imatrix(const std::string& path, ImatrixData& data, std::string& error) {
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe) {
+        error = "não foi possível abrir '" + path + "'";
+        return false;
+    }
+    char magic[4] = {0};
+    probe.read(magic, sizeof(magic));
+    probe.close();
+
+    data.clear();
+    if (std::memcmp(magic, "GGUF", sizeof(magic)) == 0) {
+        return load_gguf_imatrix(path, data, error);
+    }
+    return load_legacy_imatrix(path, data, error);
+}
+
+bool quantize_model(const QuantizeOptions& options, QuantizeResult& result, std::string& error,
+                    const std::function<void(const QuantizeProgress&)>& on_progress) {
+    result = QuantizeResult();
+
+    int ftype = 0;
+    if (!parse_quant_type(options.type, ftype)) {
+        error = "tipo de quantização desconhecido: '" + options.type + "'";
+        return false;
+    }
+    if (options.input_path.empty() || options.output_path.empty()) {
+        error = "arquivos de entrada e saída são obrigatórios";
+        return false;
+    }
+    std::error_code ec;
+    if (std::filesystem::equivalent(options.input_path, options.output_path, ec)) {
+        error = "o arquivo de saída não pode ser o próprio arquivo de entrada";
+        return false;
+    }
+    result.input_bytes = file_size_or_zero(options.input_path);
+    if (result.input_bytes == 0) {
+        error = "arquivo de entrada '" + options.input_path + "' não encontrado ou vazio";
+        return false;
+    }
+
+    ImatrixData imatrix;
+    if (!options.imatrix_path.empty()) {
+        if (!load_imatrix(options.imatrix_path, imatrix, error)) { return false; }
+        result.imatrix_entries = imatrix.size();
+    } else if (requires_imatrix(options.type)) {
+        error = "o tipo " + to_upper(options.type) + " requer uma matriz de importância (--imatrix)";
+        return false;
+    }
+
+    llama_model_quantize_params params = llama_model_quantize_default_params();
+    params.ftype = static_cast<llama_ftype>(ftype);
+    params.nthread = options.threads > 0 ? options.threads
+                                         : static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+    params.allow_requantize = options.allow_requantize;
+    params.quantize_output_tensor = !options.leave_output_tensor;
+    params.pure = options.pure;
+    params.imatrix = imatrix.empty() ? nullptr : &imatrix;
+
+    // O llama.cpp só informa o progresso pelo log; durante a conversão o callback global é
+    // trocado por um que o repassa a on_progress (e guarda a última mensagem de erro), e
+    // depois volta a ser o de quem chamou (ex.: o do LlmEngine, no mesmo processo).
+    QuantizeLogState state;
+    state.on_progress = &on_progress;
+    uint32_t rc = 0;
+    {
+        llama_log::ScopedCallback log_callback(quantize_log_callback, &state);
+        const auto started = std::chrono::steady_clock::now();
+        rc = llama_model_quantize(options.input_path.c_str(), options.output_path.c_str(), &params);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    if (rc != 0) {
+        error = state.last_error.empty() ? "llama_model_quantize falhou (código " + std::to_string(rc) + ")"
+                                         : state.last_error;
+        return false;
+    }
+    result.tensors = state.last_total;
+    result.output_bytes = file_size_or_zero(options.output_path);
+    return true;
+}
+
+} // namespace quantizer
+} // namespace cpu_llm_project
@@ -0,0 +1,93 @@
+#include "cpu_llm_project/response_cache.hpp"
+
+namespace cpu_llm_project {
+
+CacheKeyBuilder& CacheKeyBuilder::add_bytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash_ ^= bytes[i];
+        hash_ *= 1099511628211ULL; // FNV prime
+    }
+    return *this;
+}
+
+CacheKeyBuilder& CacheKeyBuilder::add(const std::string& value) {
+    // O tamanho entra na chave para que ("ab", "c") e ("a", "bc") não colidam.
+    add_value(value.size());
+    return add_bytes(value.data(), value.size());
+}
+
+ResponseCache::ResponseCache(size_t capacity_bytes) {
+    stats_.capacity_bytes = capacity_bytes;
+}
+
+void ResponseCache::set_capacity(size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.capacity_bytes = capacity_bytes;
+    evict_until_fits(0);
+}
+
+bool ResponseCache::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.capacity_bytes > 0;
+}
+
+bool ResponseCache::lookup(uint64_t key, std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    value = it->second->second;
+    stats_.hits++;
+    return true;
+}
+
+void ResponseCache::insert(uint64_t key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t entry_bytes = value.size() + kEntryOverhead;
+    if (entry_bytes > stats_.capacity_bytes) {
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        stats_.bytes -= it->second->second.size() + kEntryOverhead;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    evict_until_fits(entry_bytes);
+    lru_.emplace_front(key, value);
+    index_[key] = lru_.begin();
+    stats_.bytes += entry_bytes;
+    stats_.insertions++;
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_.bytes = 0;
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats result = stats_;
+    result.entries = index_.size();
+    return result;
+}
+
+void ResponseCache::evict_until_fits(size_t incoming_bytes) {
+    while (!lru_.empty() && stats_.bytes + incoming_bytes > stats_.capacity_bytes) {
+        const Entry& oldest = lru_.back();
+        stats_.bytes -= oldest.second.size() + kEntryOverhead;
+        index_.erase(oldest.first);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+}
+
+} // namespace cpu_llm_project
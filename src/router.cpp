@@ -0,0 +1,632 @@
+#include "cpu_llm_project/router.hpp"
+#include "cpu_llm_project/admin_auth.hpp"
+#include "cpu_llm_project/compute_pool.hpp" // ComputePools::available_cpus
+
+#include "httplib.h"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h> // Para AF_UNIX
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sched.h>      // Para sched_setaffinity
+#include <sys/prctl.h>  // Para PR_SET_PDEATHSIG
+#endif
+
+using json = nlohmann::json;
+
+namespace cpu_llm_project {
+
+struct Router::Worker {
+    int id = 0;
+    std::string address;          // "unix:/caminho" ou "host:porta"
+    bool spawned = false;         // Iniciado (e reiniciado) pelo roteador
+    std::vector<int> cpus;        // CPUs reservadas para o worker iniciado aqui
+
+    // Protegidos por spawn_mutex_
+    pid_t pid = -1;
+    std::chrono::steady_clock::time_point started_at;
+
+    // Usados só pela thread de health check
+    bool ever_healthy = false;
+    int consecutive_failures = 0;
+
+    std::atomic<bool> healthy{false};
+    std::atomic<int> inflight{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> restarts{0};
+};
+
+namespace {
+
+std::unique_ptr<httplib::Client> make_client(const std::string& address, time_t read_timeout_sec) {
+    std::unique_ptr<httplib::Client> client;
+    if (address.rfind("unix:", 0) == 0) {
+        // Com AF_UNIX, o httplib usa o "host" como caminho do socket.
+        client = std::make_unique<httplib::Client>(address.substr(5), 80);
+        client->set_address_family(AF_UNIX);
+    } else {
+        const size_t colon = address.rfind(':');
+        const std::string host = colon == std::string::npos ? address : address.substr(0, colon);
+        const int port = colon == std::string::npos ? 80 : std::atoi(address.c_str() + colon + 1);
+        client = std::make_unique<httplib::Client>(host, port);
+    }
+    client->set_connection_timeout(2);
+    client->set_read_timeout(read_timeout_sec);
+    client->set_write_timeout(30);
+    return client;
+}
+
+// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) { continue; }
+        const size_t dash = range.find('-');
+        const int first = std::atoi(range.c_str());
+        const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// CPUs de cada nó NUMA (Linux: /sys/devices/system/node) que este processo pode usar: o
+// cpulist do nó lista todas as CPUs dele, mesmo as fora do cpuset/taskset do roteador, e
+// um worker preso a elas falharia no sched_setaffinity. Sem essa informação, um nó só.
+std::vector<std::vector<int>> numa_node_cpus() {
+    const std::vector<int> allowed = ComputePools::available_cpus(); // Ordenado
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) { break; }
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parse_cpu_list(list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) { cpus.push_back(cpu); }
+        }
+        if (!cpus.empty()) { nodes.push_back(std::move(cpus)); }
+    }
+    if (nodes.empty()) { nodes.push_back(allowed); }
+    return nodes;
+}
+
+// Worker i fica no nó i % n_nodes e recebe uma fatia contígua das CPUs desse nó, para que
+// threads e memória (alocada por first-touch) fiquem no mesmo nó.
+std::vector<std::vector<int>> partition_cpus(int n_workers) {
+    const std::vector<std::vector<int>> nodes = numa_node_cpus();
+    std::vector<std::vector<int>> partitions(n_workers);
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        std::vector<int> node_workers;
+        for (int worker = 0; worker < n_workers; ++worker) {
+            if (static_cast<size_t>(worker) % nodes.size() == node) { node_workers.push_back(worker); }
+        }
+        const std::vector<int>& cpus = nodes[node];
+        for (size_t k = 0; k < node_workers.size(); ++k) {
+            const size_t begin = k * cpus.size() / node_workers.size();
+            const size_t end = std::max(begin + 1, (k + 1) * cpus.size() / node_workers.size());
+            for (size_t c = begin; c < end && c < cpus.size(); ++c) {
+                partitions[node_workers[k]].push_back(cpus[c]);
+            }
+        }
+    }
+    return partitions;
+}
+
+std::string to_lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+// Cabeçalhos que o proxy repassa ao worker (e de volta ao cliente). Ficam de fora os
+// hop-by-hop (RFC 7230, 6.1), inclusive os listados em "Connection"; os que o httplib
+// recalcula (Host, Content-Length, Content-Type); e os pseudo-cabeçalhos REMOTE_ADDR etc.
+// que o servidor do httplib acrescenta à requisição.
+httplib::Headers end_to_end_headers(const httplib::Headers& headers) {
+    std::vector<std::string> excluded = {
+        "connection", "keep-alive", "proxy-authenticate", "proxy-authorization", "proxy-connection", "te",
+        "trailer", "transfer-encoding", "upgrade", "host", "content-length", "content-type",
+        "remote_addr", "remote_port", "local_addr", "local_port"};
+    for (const auto& header : headers) {
+        if (to_lower(header.first) != "connection") { continue; }
+        std::stringstream ss(header.second);
+        std::string token;
+        while (std::getline(ss, token, ',')) {
+            const size_t begin = token.find_first_not_of(" \t");
+            const size_t end = token.find_last_not_of(" \t");
+            if (begin != std::string::npos) { excluded.push_back(to_lower(token.substr(begin, end - begin + 1))); }
+        }
+    }
+    httplib::Headers forwarded;
+    for (const auto& header : headers) {
+        if (std::find(excluded.begin(), excluded.end(), to_lower(header.first)) == excluded.end()) {
+            forwarded.emplace(header.first, header.second);
+        }
+    }
+    return forwarded;
+}
+
+// Chave de afinidade: o que um worker guarda de uma requisição para a próxima é o cache
+// de respostas, indexado pelo prompt e por todos os parâmetros da geração. O corpo inteiro
+// de /api/generate, normalizado (json::dump ordena as chaves), leva requisições idênticas
+// ao mesmo worker; prompts diferentes se espalham pelo anel. Vazia (= menos ocupado) para
+// as demais rotas, corpos inválidos e requisições com "cache": false.
+std::string routing_key_for(const httplib::Request& req) {
+    if (req.path != "/api/generate") { return std::string(); }
+    json body = json::parse(req.body, nullptr, false);
+    if (!body.is_object()) { return std::string(); }
+    auto cache = body.find("cache");
+    if (cache != body.end() && cache->is_boolean() && !cache->get<bool>()) { return std::string(); }
+    return body.dump();
+}
+
+void json_error(httplib::Response& res, int status, const std::string& message) {
+    res.status = status;
+    json error_json = {{"error", message}};
+    res.set_content(error_json.dump(), "application/json");
+}
+
+} // namespace
+
+Router::Router(const RouterOptions& options) : options_(options) {
+    for (const std::string& address : options_.worker_addresses) {
+        auto worker = std::make_unique<Worker>();
+        worker->id = static_cast<int>(workers_.size());
+        worker->address = address;
+        workers_.push_back(std::move(worker));
+    }
+
+    if (options_.spawn_workers > 0) {
+        std::vector<std::vector<int>> partitions = partition_cpus(options_.spawn_workers);
+        for (int i = 0; i < options_.spawn_workers; ++i) {
+            auto worker = std::make_unique<Worker>();
+            worker->id = static_cast<int>(workers_.size());
+            worker->spawned = true;
+            worker->cpus = partitions[i];
+            worker->address = "unix:" + options_.socket_dir + "/cpu_llm_worker-" + std::to_string(getpid()) +
+                              "-" + std::to_string(worker->id) + ".sock";
+            workers_.push_back(std::move(worker));
+        }
+    }
+
+    for (const auto& worker : workers_) {
+        ring_.add_node(worker->id);
+    }
+
+    server_ = std::make_unique<httplib::Server>();
+    const ServerOptions& http = options_.server;
+    const size_t threads = http.worker_threads > 0
+        ? static_cast<size_t>(http.worker_threads)
+        : static_cast<size_t>(CPPHTTPLIB_THREAD_POOL_COUNT); // Padrão do httplib, como no ApiServer
+    const size_t max_queued = http.max_queued;
+    server_->new_task_queue = [threads, max_queued]() -> httplib::TaskQueue* {
+        return new httplib::ThreadPool(threads, max_queued);
+    };
+    server_->set_read_timeout(http.read_timeout_sec);
+    server_->set_write_timeout(http.write_timeout_sec);
+    server_->set_keep_alive_timeout(http.keep_alive_timeout_sec);
+    server_->set_keep_alive_max_count(http.keep_alive_max_requests);
+    if (http.payload_max_bytes > 0) {
+        server_->set_payload_max_length(http.payload_max_bytes);
+    }
+    setup_routes();
+}
+
+Router::~Router() {
+    stop();
+    if (health_thread_.joinable()) {
+        running_ = false;
+        health_thread_.join();
+    }
+    stop_workers();
+}
+
+void Router::setup_routes() {
+    server_->Post("/api/admin/reload", [this](const httplib::Request& req, httplib::Response& res) {
+        this->broadcast_reload(req, res);
+    });
+    server_->Get("/api/metrics", [this](const httplib::Request& req, httplib::Response& res) {
+        this->get_metrics(req, res);
+    });
+    server_->Get("/api/ps", [this](const httplib::Request& req, httplib::Response& res) {
+        this->get_ps(req, res);
+    });
+    // Demais rotas POST da API (/api/generate, ...) vão para um worker.
+    server_->Post(R"(/api/.+)", [this](const httplib::Request& req, httplib::Response& res) {
+        this->proxy_request(req, res);
+    });
+    server_->Get("/health", [this](const httplib::Request& /*req*/, httplib::Response& res) {
+        int healthy = 0;
+        for (const auto& worker : workers_) {
+            healthy += worker->healthy ? 1 : 0;
+        }
+        json response_json;
+        response_json["status"] = healthy > 0 ? "ok" : "unavailable";
+        response_json["healthy_workers"] = healthy;
+        response_json["workers"] = workers_.size();
+        res.set_content(response_json.dump(), "application/json");
+        res.status = healthy > 0 ? 200 : 503;
+    });
+}
+
+bool Router::start() {
+    if (workers_.empty()) {
+        std::cerr << "Router::start: Nenhum worker configurado (use --workers N ou --worker-addr)." << std::endl;
+        return false;
+    }
+
+    running_ = true;
+    for (const auto& worker : workers_) {
+        if (worker->spawned) {
+            std::lock_guard<std::mutex> lock(spawn_mutex_);
+            if (!spawn_worker(*worker)) {
+                running_ = false;
+                stop_workers();
+                return false;
+            }
+        }
+    }
+    health_thread_ = std::thread([this]() { health_loop(); });
+
+    // Porta 0: o sistema escolhe uma livre, exposta por port().
+    const int port = options_.port == 0 ? server_->bind_to_any_port(options_.host)
+                                        : (server_->bind_to_port(options_.host, options_.port) ? options_.port : -1);
+    bool listened = false;
+    if (port > 0) {
+        port_ = port;
+        std::cout << "Router: " << workers_.size() << " workers; escutando em http://" << options_.host << ":"
+                  << port << " ..." << std::endl;
+        listened = server_->listen_after_bind();
+    }
+    if (!listened) {
+        std::cerr << "Router::start: Failed to listen on " << options_.host << ":" << options_.port << std::endl;
+    }
+
+    running_ = false;
+    health_thread_.join();
+    stop_workers();
+    return listened;
+}
+
+void Router::stop() {
+    if (server_ && server_->is_running()) {
+        server_->stop();
+    }
+}
+
+bool Router::spawn_worker(Worker& worker) {
+    const std::string socket_path = worker.address.substr(5); // Sem o prefixo "unix:"
+    std::vector<std::string> args = options_.worker_command;
+    args.insert(args.end(), {"--host", "127.0.0.1", "--port", "0", "--unix-socket", socket_path,
+                             "--threads", std::to_string(worker.cpus.size())});
+
+    // Tudo que o filho usa é preparado antes do fork: depois dele, num processo com várias
+    // threads, só chamadas async-signal-safe até o exec.
+    std::vector<char*> argv;
+    for (std::string& arg : args) { argv.push_back(&arg[0]); }
+    argv.push_back(nullptr);
+#if defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : worker.cpus) { CPU_SET(cpu, &cpu_set); }
+    static const char affinity_warning[] =
+        "Router: sched_setaffinity falhou no worker; ele roda sem afinidade de CPU.\n";
+#endif
+    std::remove(socket_path.c_str());
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Router: Falha ao iniciar o worker " << worker.id << " (fork)." << std::endl;
+        return false;
+    }
+    if (pid == 0) {
+#if defined(__linux__)
+        prctl(PR_SET_PDEATHSIG, SIGTERM); // Worker não sobrevive ao roteador
+        // Sem afinidade o worker ainda funciona, só disputa CPUs com os outros: avisa e segue.
+        // write() em vez de std::cerr, que não é async-signal-safe.
+        if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+            const ssize_t ignored = write(STDERR_FILENO, affinity_warning, sizeof(affinity_warning) - 1);
+            (void)ignored;
+        }
+#endif
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    worker.pid = pid;
+    worker.started_at = std::chrono::steady_clock::now();
+    worker.ever_healthy = false;
+    worker.consecutive_failures = 0;
+    worker.healthy = false;
+    std::cout << "Router: Worker " << worker.id << " iniciado (pid " << pid << ", " << worker.cpus.size()
+              << " CPUs, " << worker.address << ")." << std::endl;
+    return true;
+}
+
+void Router::stop_workers() {
+    std::lock_guard<std::mutex> lock(spawn_mutex_);
+    for (const auto& worker : workers_) {
+        if (worker->spawned && worker->pid > 0) { kill(worker->pid, SIGTERM); }
+    }
+    // Dá alguns segundos para saírem sozinhos antes do SIGKILL.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (const auto& worker : workers_) {
+        if (!worker->spawned || worker->pid <= 0) { continue; }
+        while (waitpid(worker->pid, nullptr, WNOHANG) == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                kill(worker->pid, SIGKILL);
+                waitpid(worker->pid, nullptr, 0);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        worker->pid = -1;
+        worker->healthy = false;
+        std::remove(worker->address.substr(5).c_str());
+    }
+}
+
+void Router::health_loop() {
+    while (running_) {
+        for (const auto& worker : workers_) {
+            if (!running_) { break; }
+            check_worker(*worker);
+        }
+        const auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.health_interval_ms);
+        while (running_ && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+}
+
+void Router::check_worker(Worker& worker) {
+    if (worker.spawned) {
+        std::lock_guard<std::mutex> lock(spawn_mutex_);
+        if (worker.pid <= 0) {
+            // O último reinício falhou (fork): tenta de novo a cada health check, senão o
+            // worker ficaria fora da rotação para sempre.
+            std::cerr << "Router: Worker " << worker.id << " sem processo; tentando iniciar de novo." << std::endl;
+            worker.healthy = false;
+            if (spawn_worker(worker)) { worker.restarts++; }
+            return;
+        }
+        if (waitpid(worker.pid, nullptr, WNOHANG) == worker.pid) {
+            std::cerr << "Router: Worker " << worker.id << " (pid " << worker.pid << ") terminou; reiniciando." << std::endl;
+            worker.pid = -1;
+            worker.healthy = false;
+            worker.restarts++;
+            spawn_worker(worker);
+            return;
+        }
+    }
+
+    auto client = make_client(worker.address, 2);
+    auto result = client->Get("/health");
+    if (result && result->status == 200) {
+        if (!worker.healthy) {
+            std::cout << "Router: Worker " << worker.id << " pronto (" << worker.address << ")." << std::endl;
+        }
+        worker.healthy = true;
+        worker.ever_healthy = true;
+        worker.consecutive_failures = 0;
+        return;
+    }
+
+    if (worker.healthy) {
+        std::cerr << "Router: Worker " << worker.id << " não respondeu ao health check." << std::endl;
+    }
+    worker.healthy = false;
+    if (!worker.spawned) { return; } // Workers externos só saem da rotação até voltarem
+
+    std::lock_guard<std::mutex> lock(spawn_mutex_);
+    const bool starting = !worker.ever_healthy &&
+        std::chrono::steady_clock::now() - worker.started_at < std::chrono::seconds(options_.startup_grace_sec);
+    if (starting) { return; } // Ainda carregando o modelo
+    if (++worker.consecutive_failures >= options_.restart_after_failures && worker.pid > 0) {
+        std::cerr << "Router: Worker " << worker.id << " sem resposta; reiniciando (pid " << worker.pid << ")." << std::endl;
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, nullptr, 0);
+        worker.pid = -1;
+        worker.restarts++;
+        spawn_worker(worker);
+    }
+}
+
+Router::Worker* Router::pick_worker(const std::string& routing_key, bool& affinity_hit) {
+    affinity_hit = false;
+    std::vector<int> order;
+    if (routing_key.empty()) {
+        // Sem afinidade: do menos ocupado ao mais ocupado.
+        for (size_t i = 0; i < workers_.size(); ++i) { order.push_back(static_cast<int>(i)); }
+        std::stable_sort(order.begin(), order.end(),
+                         [this](int a, int b) { return workers_[a]->inflight.load() < workers_[b]->inflight.load(); });
+    } else {
+        order = ring_.nodes_for(routing_key);
+    }
+    Worker* least_loaded = nullptr;
+    for (size_t i = 0; i < order.size(); ++i) {
+        Worker& worker = *workers_[order[i]];
+        if (!worker.healthy) { continue; }
+        // Reserva a vaga com CAS: duas requisições simultâneas não podem ver a mesma vaga
+        // livre e passar as duas do limite.
+        int inflight = worker.inflight.load();
+        while (inflight < options_.max_inflight_per_worker) {
+            if (worker.inflight.compare_exchange_weak(inflight, inflight + 1)) {
+                affinity_hit = !routing_key.empty() && i == 0;
+                return &worker;
+            }
+        }
+        if (!least_loaded || inflight < least_loaded->inflight) {
+            least_loaded = &worker;
+        }
+    }
+    // Todos saturados: fila no menos ocupado.
+    if (least_loaded) { least_loaded->inflight++; }
+    return least_loaded;
+}
+
+void Router::forward(Worker& worker, const httplib::Request& req, httplib::Response& res, bool& connection_failed) {
+    connection_failed = false;
+    worker.requests++;
+
+    const httplib::Headers headers = end_to_end_headers(req.headers);
+    const std::string content_type = req.has_header("Content-Type") ? req.get_header_value("Content-Type") : "application/json";
+    auto client = make_client(worker.address, options_.request_timeout_sec);
+    auto result = client->Post(req.path, headers, req.body, content_type);
+
+    if (!result) {
+        worker.failures++;
+        // Erro de conexão: a requisição não chegou ao worker e pode ir para outro.
+        connection_failed = result.error() == httplib::Error::Connection;
+        json_error(res, 502, "Worker " + std::to_string(worker.id) + " failed: " + httplib::to_string(result.error()));
+        return;
+    }
+    res.status = result->status;
+    res.set_content(result->body, result->has_header("Content-Type") ? result->get_header_value("Content-Type") : "application/json");
+    for (const auto& header : end_to_end_headers(result->headers)) {
+        res.set_header(header.first, header.second);
+    }
+    res.set_header("X-Worker-Id", std::to_string(worker.id));
+}
+
+void Router::proxy_request(const httplib::Request& req, httplib::Response& res) {
+    requests_++;
+
+    // Corpo inválido vai com chave vazia e o worker responde com o erro.
+    const std::string routing_key = routing_key_for(req);
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool affinity_hit = false;
+        Worker* worker = pick_worker(routing_key, affinity_hit);
+        if (!worker) {
+            unavailable_++;
+            json_error(res, 503, "No healthy worker available.");
+            return;
+        }
+        if (routing_key.empty()) {
+            balanced_++;
+        } else if (affinity_hit && attempt == 0) {
+            affinity_hits_++;
+        } else {
+            fallbacks_++;
+        }
+        // Devolve a vaga reservada por pick_worker mesmo se forward lançar.
+        struct InflightRelease {
+            Worker* worker;
+            ~InflightRelease() { worker->inflight--; }
+        } release{worker};
+        bool connection_failed = false;
+        forward(*worker, req, res, connection_failed);
+        if (!connection_failed) { return; }
+        worker->healthy = false; // O health check o devolve à rotação quando voltar a responder
+    }
+}
+
+void Router::broadcast_reload(const httplib::Request& req, httplib::Response& res) {
+    // O roteador só escuta em TCP: vale o admin_token de options_.server. O header segue para
+    // os workers (os externos por TCP também o exigem; os iniciados aqui atendem pelo Unix socket).
+    int status = 0;
+    std::string auth_error;
+    const std::string authorization = req.get_header_value("Authorization");
+    if (!authorize_admin_request(options_.server.admin_token, authorization, false, status, auth_error)) {
+        res.status = status;
+        json error_json = {{"error", auth_error}};
+        res.set_content(error_json.dump(), "application/json");
+        return;
+    }
+    const httplib::Headers headers = {{"Authorization", authorization}};
+
+    json results = json::array();
+    bool all_ok = true;
+    for (const auto& worker : workers_) {
+        if (!worker->healthy) {
+            results.push_back({{"worker", worker->id}, {"status", 503}, {"error", "unhealthy"}});
+            all_ok = false;
+            continue;
+        }
+        auto client = make_client(worker->address, options_.request_timeout_sec);
+        auto result = client->Post("/api/admin/reload", headers, req.body, "application/json");
+        json entry = {{"worker", worker->id}};
+        if (!result) {
+            entry["status"] = 502;
+            entry["error"] = httplib::to_string(result.error());
+        } else {
+            entry["status"] = result->status;
+            entry["response"] = json::parse(result->body, nullptr, false);
+        }
+        all_ok = all_ok && result && result->status == 200;
+        results.push_back(entry);
+    }
+    json response_data;
+    response_data["status"] = all_ok ? "reloaded" : "partial";
+    response_data["workers"] = results;
+    res.set_content(response_data.dump(), "application/json");
+    res.status = all_ok ? 200 : 500;
+}
+
+void Router::get_metrics(const httplib::Request& /*req*/, httplib::Response& res) {
+    json workers = json::array();
+    for (const auto& worker : workers_) {
+        json entry = {
+            {"id", worker->id},
+            {"address", worker->address},
+            {"spawned", worker->spawned},
+            {"healthy", worker->healthy.load()},
+            {"inflight", worker->inflight.load()},
+            {"requests", worker->requests.load()},
+            {"failures", worker->failures.load()},
+            {"restarts", worker->restarts.load()},
+            {"cpus", worker->cpus}
+        };
+        workers.push_back(entry);
+    }
+    json response_data;
+    response_data["router"] = {
+        {"requests", requests_.load()},
+        {"affinity_hits", affinity_hits_.load()},
+        {"fallbacks", fallbacks_.load()},
+        {"balanced", balanced_.load()},
+        {"unavailable", unavailable_.load()},
+        {"max_inflight_per_worker", options_.max_inflight_per_worker}
+    };
+    response_data["workers"] = workers;
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
+void Router::get_ps(const httplib::Request& /*req*/, httplib::Response& res) {
+    json workers = json::array();
+    for (const auto& worker : workers_) {
+        json entry = {{"id", worker->id}, {"address", worker->address}};
+        if (worker->healthy) {
+            auto client = make_client(worker->address, 5);
+            auto result = client->Get("/api/ps");
+            if (result && result->status == 200) {
+                entry["ps"] = json::parse(result->body, nullptr, false);
+            }
+        }
+        workers.push_back(entry);
+    }
+    json response_data;
+    response_data["workers"] = workers;
+    res.set_content(response_data.dump(), "application/json");
+    res.status = 200;
+}
+
+} // namespace cpu_llm_project
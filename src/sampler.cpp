@@ -0,0 +1,440 @@
+#include "cpu_llm_project/sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Os kernels SIMD usam atributos de target por função, então o restante do projeto pode
+// continuar compilado só com -mavx. A escolha da implementação é feita em tempo de execução.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_LLM_SAMPLER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cpu_llm_project {
+namespace sampling_kernels {
+
+namespace {
+
+constexpr float kNegInf = -std::numeric_limits<float>::infinity();
+
+// Comparador de min-heap por logit: o topo é o menor candidato mantido.
+struct CandidateGreater {
+    bool operator()(const Candidate& a, const Candidate& b) const { return a.logit > b.logit; }
+};
+
+inline void heap_offer(std::vector<Candidate>& heap, size_t k, size_t index, float logit) {
+    if (heap.size() < k) {
+        heap.push_back({static_cast<llama_token>(index), logit});
+        std::push_heap(heap.begin(), heap.end(), CandidateGreater());
+    } else if (logit > heap.front().logit) {
+        std::pop_heap(heap.begin(), heap.end(), CandidateGreater());
+        heap.back() = {static_cast<llama_token>(index), logit};
+        std::push_heap(heap.begin(), heap.end(), CandidateGreater());
+    }
+}
+
+// --- Escalar ---
+
+float max_value_scalar(const float* values, size_t n) {
+    float result = kNegInf;
+    for (size_t i = 0; i < n; ++i) {
+        result = std::max(result, values[i]);
+    }
+    return result;
+}
+
+size_t find_first_scalar(const float* values, size_t n, float target) {
+    for (size_t i = 0; i < n; ++i) {
+        if (values[i] == target) { return i; }
+    }
+    return 0;
+}
+
+float exp_shifted_scalar(const float* in, float* out, size_t n, float max_value, float scale) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::exp((in[i] - max_value) * scale);
+        sum += out[i];
+    }
+    return sum;
+}
+
+void select_top_k_scalar(const float* logits, size_t n, size_t k, std::vector<Candidate>& heap) {
+    heap.clear();
+    heap.reserve(k);
+    for (size_t i = 0; i < n; ++i) {
+        heap_offer(heap, k, i, logits[i]);
+    }
+}
+
+#if defined(CPU_LLM_SAMPLER_X86)
+
+// --- AVX (8 floats por vez) ---
+
+__attribute__((target("avx"))) float max_value_avx(const float* values, size_t n) {
+    size_t i = 0;
+    float result = kNegInf;
+    if (n >= 8) {
+        __m256 acc = _mm256_loadu_ps(values);
+        for (i = 8; i + 8 <= n; i += 8) {
+            acc = _mm256_max_ps(acc, _mm256_loadu_ps(values + i));
+        }
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        result = _mm_cvtss_f32(m);
+    }
+    for (; i < n; ++i) {
+        result = std::max(result, values[i]);
+    }
+    return result;
+}
+
+__attribute__((target("avx"))) size_t find_first_avx(const float* values, size_t n, float target) {
+    const __m256 vtarget = _mm256_set1_ps(target);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), vtarget, _CMP_EQ_OQ));
+        if (mask) { return i + __builtin_ctz(mask); }
+    }
+    for (; i < n; ++i) {
+        if (values[i] == target) { return i; }
+    }
+    return 0;
+}
+
+__attribute__((target("avx"))) void select_top_k_avx(const float* logits, size_t n, size_t k, std::vector<Candidate>& heap) {
+    heap.clear();
+    heap.reserve(k);
+    size_t i = 0;
+    for (; i < n && heap.size() < k; ++i) {
+        heap_offer(heap, k, i, logits[i]);
+    }
+    for (; i + 8 <= n; i += 8) {
+        // Um bloco só é examinado lane a lane se algum valor supera o menor candidato.
+        const __m256 threshold = _mm256_set1_ps(heap.front().logit);
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(logits + i), threshold, _CMP_GT_OQ));
+        while (mask) {
+            const int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            heap_offer(heap, k, i + lane, logits[i + lane]);
+        }
+    }
+    for (; i < n; ++i) {
+        heap_offer(heap, k, i, logits[i]);
+    }
+}
+
+// --- AVX2 + FMA ---
+
+// exp(x) vetorizado (aproximação polinomial do Cephes, erro relativo ~1e-7).
+__attribute__((target("avx2,fma"))) inline __m256 exp_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.37f));
+    __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(exponent));
+}
+
+__attribute__((target("avx2,fma"))) float exp_shifted_avx2(const float* in, float* out, size_t n, float max_value, float scale) {
+    const __m256 vmax = _mm256_set1_ps(max_value);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 e = exp_avx2(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), vmax), vscale));
+        _mm256_storeu_ps(out + i, e);
+        acc = _mm256_add_ps(acc, e);
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    float sum = _mm_cvtss_f32(s);
+    for (; i < n; ++i) {
+        out[i] = std::exp((in[i] - max_value) * scale);
+        sum += out[i];
+    }
+    return sum;
+}
+
+// --- AVX-512F (16 floats por vez) ---
+
+__attribute__((target("avx512f"))) float max_value_avx512(const float* values, size_t n) {
+    size_t i = 0;
+    float result = kNegInf;
+    if (n >= 16) {
+        __m512 acc = _mm512_loadu_ps(values);
+        for (i = 16; i + 16 <= n; i += 16) {
+            acc = _mm512_max_ps(acc, _mm512_loadu_ps(values + i));
+        }
+        result = _mm512_reduce_max_ps(acc);
+    }
+    for (; i < n; ++i) {
+        result = std::max(result, values[i]);
+    }
+    return result;
+}
+
+__attribute__((target("avx512f"))) size_t find_first_avx512(const float* values, size_t n, float target) {
+    const __m512 vtarget = _mm512_set1_ps(target);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(values + i), vtarget, _CMP_EQ_OQ);
+        if (mask) { return i + __builtin_ctz(mask); }
+    }
+    for (; i < n; ++i) {
+        if (values[i] == target) { return i; }
+    }
+    return 0;
+}
+
+__attribute__((target("avx512f"))) void select_top_k_avx512(const float* logits, size_t n, size_t k, std::vector<Candidate>& heap) {
+    heap.clear();
+    heap.reserve(k);
+    size_t i = 0;
+    for (; i < n && heap.size() < k; ++i) {
+        heap_offer(heap, k, i, logits[i]);
+    }
+    for (; i + 16 <= n; i += 16) {
+        const __m512 threshold = _mm512_set1_ps(heap.front().logit);
+        unsigned int mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(logits + i), threshold, _CMP_GT_OQ);
+        while (mask) {
+            const int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            heap_offer(heap, k, i + lane, logits[i + lane]);
+        }
+    }
+    for (; i < n; ++i) {
+        heap_offer(heap, k, i, logits[i]);
+    }
+}
+
+__attribute__((target("avx512f"))) inline __m512 exp_avx512(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-87.3f)), _mm512_set1_ps(88.37f));
+    __m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(1.44269504088896341f), _mm512_set1_ps(0.5f)),
+                                     _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(0.693359375f), x);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(-2.12194440e-4f), x);
+    __m512 y = _mm512_set1_ps(1.9875691500e-4f);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.3981999507e-3f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(8.3334519073e-3f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(4.1665795894e-2f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.6666665459e-1f));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(5.0000001201e-1f));
+    y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+    __m512i exponent = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(127)), 23);
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(exponent));
+}
+
+__attribute__((target("avx512f"))) float exp_shifted_avx512(const float* in, float* out, size_t n, float max_value, float scale) {
+    const __m512 vmax = _mm512_set1_ps(max_value);
+    const __m512 vscale = _mm512_set1_ps(scale);
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 e = exp_avx512(_mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(in + i), vmax), vscale));
+        _mm512_storeu_ps(out + i, e);
+        acc = _mm512_add_ps(acc, e);
+    }
+    float sum = _mm512_reduce_add_ps(acc);
+    for (; i < n; ++i) {
+        out[i] = std::exp((in[i] - max_value) * scale);
+        sum += out[i];
+    }
+    return sum;
+}
+
+#endif // CPU_LLM_SAMPLER_X86
+
+struct KernelTable {
+    const char* name;
+    float (*max_value)(const float*, size_t);
+    size_t (*find_first)(const float*, size_t, float);
+    float (*exp_shifted)(const float*, float*, size_t, float, float);
+    void (*select_top_k)(const float*, size_t, size_t, std::vector<Candidate>&);
+};
+
+KernelTable select_kernels() {
+#if defined(CPU_LLM_SAMPLER_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {"avx512f", max_value_avx512, find_first_avx512, exp_shifted_avx512, select_top_k_avx512};
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return {"avx2", max_value_avx, find_first_avx, exp_shifted_avx2, select_top_k_avx};
+    }
+    if (__builtin_cpu_supports("avx")) {
+        return {"avx", max_value_avx, find_first_avx, exp_shifted_scalar, select_top_k_avx};
+    }
+#endif
+    return {"scalar", max_value_scalar, find_first_scalar, exp_shifted_scalar, select_top_k_scalar};
+}
+
+const KernelTable& kernels() {
+    static const KernelTable table = select_kernels();
+    return table;
+}
+
+} // namespace
+
+const char* backend_name() {
+    return kernels().name;
+}
+
+float max_value(const float* values, size_t n) {
+    return kernels().max_value(values, n);
+}
+
+size_t argmax(const float* values, size_t n) {
+    if (n == 0) { return 0; }
+    return kernels().find_first(values, n, kernels().max_value(values, n));
+}
+
+float exp_shifted(const float* in, float* out, size_t n, float max_value, float scale) {
+    return kernels().exp_shifted(in, out, n, max_value, scale);
+}
+
+float log_sum_exp(const float* values, size_t n, float* scratch) {
+    if (n == 0) { return kNegInf; }
+    const float max = kernels().max_value(values, n);
+    if (!std::isfinite(max)) { return max; }
+    return max + std::log(kernels().exp_shifted(values, scratch, n, max, 1.0f));
+}
+
+void select_top_k(const float* logits, size_t n, size_t k, std::vector<Candidate>& out) {
+    kernels().select_top_k(logits, n, std::min(k, n), out);
+}
+
+} // namespace sampling_kernels
+
+namespace {
+
+// Sorteia um índice em [0, count) proporcional aos pesos (não precisam somar 1).
+size_t draw_index(const float* weights, size_t count, float total, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(0.0f, total);
+    const float target = dist(rng);
+    float cumulative = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        cumulative += weights[i];
+        if (target < cumulative) { return i; }
+    }
+    return count - 1; // Arredondamento: fica com o último candidato
+}
+
+bool by_logit_desc(const sampling_kernels::Candidate& a, const sampling_kernels::Candidate& b) {
+    return a.logit > b.logit;
+}
+
+} // namespace
+
+Sampler::Sampler(const SamplingParams& params)
+    : params_(params),
+      rng_(params.seed == LLAMA_DEFAULT_SEED ? std::random_device{}() : params.seed) {}
+
+void Sampler::accept(llama_token token) {
+    if (params_.penalty_last_n <= 0) { return; }
+    recent_tokens_.push_back(token);
+    recent_counts_[token]++;
+    if (recent_tokens_.size() > static_cast<size_t>(params_.penalty_last_n)) {
+        llama_token oldest = recent_tokens_.front();
+        recent_tokens_.pop_front();
+        auto it = recent_counts_.find(oldest);
+        if (--it->second == 0) { recent_counts_.erase(it); }
+    }
+}
+
+void Sampler::apply_penalties(float* logits, int n_vocab) const {
+    if (params_.repeat_penalty == 1.0f) { return; }
+    // Mesma regra do sampler de penalidades do llama.cpp, mas só sobre os tokens da janela.
+    for (const auto& entry : recent_counts_) {
+        const llama_token token = entry.first;
+        if (token < 0 || token >= n_vocab) { continue; }
+        float& logit = logits[token];
+        logit = logit > 0.0f ? logit / params_.repeat_penalty : logit * params_.repeat_penalty;
+    }
+}
+
+llama_token Sampler::sample(float* logits, int n_vocab) {
+    using namespace sampling_kernels;
+    if (n_vocab <= 0) { return 0; }
+    const size_t n = static_cast<size_t>(n_vocab);
+
+    apply_penalties(logits, n_vocab);
+
+    if (params_.temperature <= 0.0f) {
+        return static_cast<llama_token>(argmax(logits, n));
+    }
+
+    const float scale = 1.0f / params_.temperature;
+    const float top_p = (params_.top_p > 0.0f && params_.top_p < 1.0f) ? params_.top_p : 1.0f;
+
+    if (params_.top_k > 0 && static_cast<size_t>(params_.top_k) < n) {
+        // Softmax e top-p apenas sobre os k candidatos.
+        select_top_k(logits, n, params_.top_k, candidates_);
+        std::sort(candidates_.begin(), candidates_.end(), by_logit_desc);
+        probs_.resize(candidates_.size());
+        for (size_t i = 0; i < candidates_.size(); ++i) {
+            probs_[i] = candidates_[i].logit;
+        }
+        const float sum = exp_shifted(probs_.data(), probs_.data(), probs_.size(), candidates_[0].logit, scale);
+
+        size_t keep = probs_.size();
+        float kept_mass = sum;
+        if (top_p < 1.0f) {
+            float cumulative = 0.0f;
+            for (size_t i = 0; i < probs_.size(); ++i) {
+                cumulative += probs_[i];
+                if (cumulative >= top_p * sum) {
+                    keep = i + 1;
+                    kept_mass = cumulative;
+                    break;
+                }
+            }
+        }
+        return candidates_[draw_index(probs_.data(), keep, kept_mass, rng_)].id;
+    }
+
+    // Sem top-k: softmax sobre o vocabulário inteiro.
+    probs_.resize(n);
+    const float sum = exp_shifted(logits, probs_.data(), n, max_value(logits, n), scale);
+    if (top_p >= 1.0f) {
+        return static_cast<llama_token>(draw_index(probs_.data(), n, sum, rng_));
+    }
+
+    // Núcleo (top-p): em vez de ordenar o vocabulário inteiro, ordena um número crescente
+    // de candidatos até cobrir top_p da massa de probabilidade.
+    for (size_t k = 64;; k *= 4) {
+        k = std::min(k, n);
+        select_top_k(logits, n, k, candidates_);
+        std::sort(candidates_.begin(), candidates_.end(), by_logit_desc);
+        float cumulative = 0.0f;
+        size_t keep = 0;
+        for (size_t i = 0; i < candidates_.size(); ++i) {
+            cumulative += probs_[candidates_[i].id];
+            if (cumulative >= top_p * sum) {
+                keep = i + 1;
+                break;
+            }
+        }
+        if (keep > 0 || k == n) {
+            keep = keep > 0 ? keep : candidates_.size();
+            // probs_ é indexado por token; os pesos do sorteio seguem a ordem dos candidatos.
+            std::vector<float> weights(keep);
+            for (size_t i = 0; i < keep; ++i) {
+                weights[i] = probs_[candidates_[i].id];
+            }
+            return candidates_[draw_index(weights.data(), keep, cumulative, rng_)].id;
+        }
+    }
+}
+
+} // namespace cpu_llm_project
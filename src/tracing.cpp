@@ -0,0 +1,480 @@
+#include "cpu_llm_project/tracing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cpu_llm_project {
+namespace tracing {
+
+namespace {
+
+struct SpanRecord {
+    uint64_t trace_id;
+    uint64_t span_id;
+    uint64_t parent_id;
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+    int64_t value;
+    uint32_t thread_index;
+};
+
+// Limite de traces com spans perdidos contados por thread (traces adiados que nunca são
+// exportados deixariam a contagem crescendo).
+constexpr size_t kMaxDroppedTraces = 1024;
+
+// Ring buffer de uma thread. O mutex só disputa com a exportação, que é rara. Registros já
+// exportados ficam com trace_id 0: sobrescrever um registro com trace_id != 0 perde um
+// span de um trace ainda por exportar, e isso é contado em dropped.
+struct ThreadBuffer {
+    ThreadBuffer(size_t capacity, uint32_t index) : records(capacity), thread_index(index) {}
+
+    void push(const SpanRecord& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (records.empty()) {
+            count_dropped(record.trace_id);
+            return;
+        }
+        if (size == records.size() && records[next].trace_id != 0) { count_dropped(records[next].trace_id); }
+        records[next] = record;
+        records[next].thread_index = thread_index;
+        next = (next + 1) % records.size();
+        size = std::min(size + 1, records.size());
+    }
+
+    void count_dropped(uint64_t trace_id) {
+        if (dropped.size() >= kMaxDroppedTraces && dropped.find(trace_id) == dropped.end()) {
+            dropped.erase(dropped.begin());
+        }
+        dropped[trace_id]++;
+    }
+
+    std::mutex mutex;
+    std::vector<SpanRecord> records;
+    size_t next = 0;
+    size_t size = 0;
+    uint32_t thread_index;
+    std::unordered_map<uint64_t, uint64_t> dropped; // trace_id -> spans sobrescritos antes da exportação
+};
+
+struct DeferredTrace {
+    int64_t scope_end_ns;
+    uint64_t root_span_id;
+};
+
+void export_trace(uint64_t trace_id);
+
+struct Registry {
+    std::mutex mutex;
+    Config config;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::unordered_map<uint64_t, DeferredTrace> deferred;
+    uint32_t next_thread_index = 1;
+    // Arquivos já gravados em files_dir, do mais antigo ao mais novo, para o limite max_files.
+    std::string files_dir;
+    std::deque<std::filesystem::path> files;
+
+    // Exportação em segundo plano: a requisição só enfileira o id, e a varredura dos ring
+    // buffers e a escrita do arquivo ficam fora do caminho de latência que o trace mede.
+    std::thread exporter;
+    std::condition_variable export_cv;   // Há id na fila (ou pedido de parada)
+    std::condition_variable exported_cv; // Fila vazia e nada sendo exportado (flush)
+    std::deque<uint64_t> export_queue;
+    bool exporting = false;
+    bool stopping = false;
+
+    ~Registry() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        export_cv.notify_one();
+        if (exporter.joinable()) { exporter.join(); } // Exporta o que ainda estiver na fila
+    }
+
+    void export_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            export_cv.wait(lock, [this] { return stopping || !export_queue.empty(); });
+            if (export_queue.empty()) { return; } // stopping, fila já escoada
+            const uint64_t trace_id = export_queue.front();
+            export_queue.pop_front();
+            exporting = true;
+            lock.unlock();
+            export_trace(trace_id);
+            lock.lock();
+            exporting = false;
+            if (export_queue.empty()) { exported_cv.notify_all(); }
+        }
+    }
+};
+
+// Limite de traces adiados à espera de finish_trace() (ex.: conexão que caiu antes da resposta).
+constexpr size_t kMaxDeferredTraces = 1024;
+// Limite de traces na fila do exportador; além dele, o trace é descartado (disco lento não
+// faz a memória crescer sem limite).
+constexpr size_t kMaxQueuedExports = 1024;
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Lidas a cada requisição; ficam fora do mutex do registro.
+std::atomic<double> g_sample_rate{0.0};
+std::atomic<bool> g_allow_forced{true};
+
+thread_local uint64_t t_trace_id = 0;
+thread_local uint64_t t_span_id = 0;
+thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Converte o relógio monotônico para tempo Unix (usado nos arquivos exportados).
+int64_t to_unix_ns(int64_t steady_ns) {
+    static const int64_t offset =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+        - now_ns();
+    return steady_ns + offset;
+}
+
+uint64_t new_id() {
+    thread_local std::mt19937_64 rng(std::random_device{}() ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
+    uint64_t id = 0;
+    while (id == 0) { id = rng(); }
+    return id;
+}
+
+ThreadBuffer& thread_buffer() {
+    if (!t_buffer) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        t_buffer = std::make_shared<ThreadBuffer>(reg.config.ring_capacity, reg.next_thread_index++);
+        reg.buffers.push_back(t_buffer);
+    }
+    return *t_buffer;
+}
+
+void record_span(uint64_t trace_id, uint64_t span_id, uint64_t parent_id, const char* name,
+                 int64_t start_ns, int64_t end_ns, int64_t value) {
+    thread_buffer().push({trace_id, span_id, parent_id, name, start_ns, end_ns, value, 0});
+}
+
+std::string hex_id(uint64_t id) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(id));
+    return buffer;
+}
+
+std::string json_escape(const char* text) {
+    std::string escaped;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') { escaped += '\\'; }
+        escaped += *c;
+    }
+    return escaped;
+}
+
+void write_chrome_trace(std::ostream& out, uint64_t trace_id, const std::vector<SpanRecord>& spans, uint64_t dropped) {
+    out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"trace_id\":\"" << hex_id(trace_id)
+        << "\",\"dropped_spans\":" << dropped << "},\"traceEvents\":[";
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const SpanRecord& span = spans[i];
+        out << (i ? "," : "")
+            << "{\"name\":\"" << json_escape(span.name) << "\",\"cat\":\"cpu_llm_project\",\"ph\":\"X\""
+            << ",\"ts\":" << to_unix_ns(span.start_ns) / 1000.0
+            << ",\"dur\":" << (span.end_ns - span.start_ns) / 1000.0
+            << ",\"pid\":1,\"tid\":" << span.thread_index
+            << ",\"args\":{\"trace_id\":\"" << hex_id(trace_id) << "\"";
+        if (span.value >= 0) { out << ",\"value\":" << span.value; }
+        out << "}}";
+    }
+    out << "]}\n";
+}
+
+void write_otlp_trace(std::ostream& out, uint64_t trace_id, const std::vector<SpanRecord>& spans, uint64_t dropped) {
+    // OTLP exige traceId de 16 bytes; os ids daqui têm 8, então a metade alta é zero.
+    const std::string otlp_trace_id = hex_id(0) + hex_id(trace_id);
+    out << "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\","
+        << "\"value\":{\"stringValue\":\"cpu_llm_project\"}},{\"key\":\"cpu_llm_project.dropped_spans\","
+        << "\"value\":{\"intValue\":\"" << dropped << "\"}}]},"
+        << "\"scopeSpans\":[{\"scope\":{\"name\":\"cpu_llm_project\"},\"spans\":[";
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const SpanRecord& span = spans[i];
+        out << (i ? "," : "")
+            << "{\"traceId\":\"" << otlp_trace_id << "\",\"spanId\":\"" << hex_id(span.span_id) << "\"";
+        if (span.parent_id != 0) { out << ",\"parentSpanId\":\"" << hex_id(span.parent_id) << "\""; }
+        out << ",\"name\":\"" << json_escape(span.name) << "\",\"kind\":1"
+            << ",\"startTimeUnixNano\":\"" << to_unix_ns(span.start_ns) << "\""
+            << ",\"endTimeUnixNano\":\"" << to_unix_ns(span.end_ns) << "\""
+            << ",\"attributes\":[{\"key\":\"thread.id\",\"value\":{\"intValue\":\"" << span.thread_index << "\"}}";
+        if (span.value >= 0) {
+            out << ",{\"key\":\"value\",\"value\":{\"intValue\":\"" << span.value << "\"}}";
+        }
+        out << "]}";
+    }
+    out << "]}]}]}\n";
+}
+
+// Arquivos trace-* de dir, do mais antigo ao mais novo (inclusive os de execuções anteriores).
+std::deque<std::filesystem::path> list_trace_files(const std::string& dir) {
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> found;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind("trace-", 0) != 0 || !it->is_regular_file(ec)) { continue; }
+        found.emplace_back(it->last_write_time(ec), it->path());
+    }
+    std::sort(found.begin(), found.end());
+    std::deque<std::filesystem::path> files;
+    for (auto& entry : found) { files.push_back(std::move(entry.second)); }
+    return files;
+}
+
+// Mantém no máximo config.max_files arquivos em output_dir, apagando os mais antigos: um
+// cliente mandando "X-Trace: 1" em toda requisição não enche o disco.
+void rotate_trace_files(const Config& config, const std::filesystem::path& written) {
+    if (config.max_files == 0) { return; }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (reg.files_dir != config.output_dir) {
+        reg.files_dir = config.output_dir;
+        reg.files = list_trace_files(config.output_dir); // Já inclui written
+    } else if (std::find(reg.files.begin(), reg.files.end(), written) == reg.files.end()) {
+        reg.files.push_back(written);
+    }
+    while (reg.files.size() > config.max_files) {
+        std::error_code ec;
+        std::filesystem::remove(reg.files.front(), ec);
+        reg.files.pop_front();
+    }
+}
+
+void export_trace(uint64_t trace_id) {
+    Registry& reg = registry();
+    Config config;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        config = reg.config;
+        buffers = reg.buffers;
+    }
+
+    std::vector<SpanRecord> spans;
+    uint64_t dropped = 0;
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        for (size_t i = 0; i < buffer->size; ++i) {
+            if (buffer->records[i].trace_id == trace_id) {
+                spans.push_back(buffer->records[i]);
+                buffer->records[i].trace_id = 0; // Exportado: sobrescrevê-lo não perde nada
+            }
+        }
+        auto it = buffer->dropped.find(trace_id);
+        if (it != buffer->dropped.end()) {
+            dropped += it->second;
+            buffer->dropped.erase(it);
+        }
+    }
+    buffers.clear();
+
+    {
+        // Buffers cujo único dono é o registro pertencem a threads que já terminaram. Só são
+        // descartados quando nenhum trace adiado pode ainda ter spans neles.
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (reg.deferred.empty()) {
+            reg.buffers.erase(std::remove_if(reg.buffers.begin(), reg.buffers.end(),
+                                             [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; }),
+                              reg.buffers.end());
+        }
+    }
+
+    std::sort(spans.begin(), spans.end(),
+              [](const SpanRecord& a, const SpanRecord& b) { return a.start_ns < b.start_ns; });
+
+    std::error_code ec;
+    std::filesystem::create_directories(config.output_dir, ec);
+    const bool otlp = config.format == ExportFormat::Otlp;
+    const std::filesystem::path path = std::filesystem::path(config.output_dir) /
+        ("trace-" + hex_id(trace_id) + (otlp ? ".otlp.json" : ".json"));
+    {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Tracing: Falha ao escrever " << path.string() << std::endl;
+            return;
+        }
+        if (otlp) {
+            write_otlp_trace(out, trace_id, spans, dropped);
+        } else {
+            write_chrome_trace(out, trace_id, spans, dropped);
+        }
+    }
+    if (dropped > 0) {
+        std::cerr << "Tracing: " << dropped << " spans do trace " << hex_id(trace_id)
+                  << " foram sobrescritos no ring buffer (aumente ring_capacity)." << std::endl;
+    }
+    rotate_trace_files(config, path);
+}
+
+// Entrega o trace à thread exportadora (iniciada no primeiro uso).
+void enqueue_export(uint64_t trace_id) {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (reg.export_queue.size() >= kMaxQueuedExports) {
+            std::cerr << "Tracing: fila de exportação cheia; trace " << hex_id(trace_id) << " descartado." << std::endl;
+            return;
+        }
+        if (!reg.exporter.joinable()) {
+            reg.exporter = std::thread([&reg] { reg.export_loop(); });
+        }
+        reg.export_queue.push_back(trace_id);
+    }
+    reg.export_cv.notify_one();
+}
+
+} // namespace
+
+void flush() {
+    Registry& reg = registry();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    reg.exported_cv.wait(lock, [&reg] { return reg.export_queue.empty() && !reg.exporting; });
+}
+
+void configure(const Config& config) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.config = config;
+    g_sample_rate = config.sample_rate;
+    g_allow_forced = config.allow_forced;
+}
+
+Config current_config() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.config;
+}
+
+bool parse_export_format(const std::string& name, ExportFormat& format) {
+    if (name == "chrome") {
+        format = ExportFormat::ChromeTrace;
+        return true;
+    }
+    if (name == "otlp") {
+        format = ExportFormat::Otlp;
+        return true;
+    }
+    return false;
+}
+
+uint64_t current_trace_id() {
+    return t_trace_id;
+}
+
+uint64_t current_span_id() {
+    return t_span_id;
+}
+
+TraceScope::TraceScope(const char* root_name, bool force) : root_name_(root_name) {
+    bool sampled = force && g_allow_forced.load(std::memory_order_relaxed);
+    if (!sampled) {
+        const double rate = g_sample_rate.load(std::memory_order_relaxed);
+        if (rate > 0.0) {
+            thread_local std::mt19937 rng(std::random_device{}());
+            sampled = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+        }
+    }
+    if (!sampled) { return; }
+
+    trace_id_ = new_id();
+    root_span_id_ = new_id();
+    previous_trace_id_ = t_trace_id;
+    previous_span_id_ = t_span_id;
+    t_trace_id = trace_id_;
+    t_span_id = root_span_id_;
+    start_ns_ = now_ns();
+}
+
+TraceScope::~TraceScope() {
+    if (!active()) { return; }
+    const int64_t end_ns = now_ns();
+    record_span(trace_id_, root_span_id_, 0, root_name_, start_ns_, end_ns, -1);
+    t_trace_id = previous_trace_id_;
+    t_span_id = previous_span_id_;
+
+    if (!deferred_) {
+        enqueue_export(trace_id_);
+        return;
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (reg.deferred.size() >= kMaxDeferredTraces) {
+        reg.deferred.erase(reg.deferred.begin());
+    }
+    reg.deferred[trace_id_] = {end_ns, root_span_id_};
+}
+
+void finish_trace(uint64_t trace_id, const char* final_span_name) {
+    if (trace_id == 0) { return; }
+    DeferredTrace deferred;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto it = reg.deferred.find(trace_id);
+        if (it == reg.deferred.end()) { return; }
+        deferred = it->second;
+        reg.deferred.erase(it);
+    }
+    record_span(trace_id, new_id(), deferred.root_span_id, final_span_name, deferred.scope_end_ns, now_ns(), -1);
+    enqueue_export(trace_id);
+}
+
+Span::Span(const char* name, int64_t value) {
+    if (t_trace_id == 0) { return; }
+    trace_id_ = t_trace_id;
+    parent_id_ = t_span_id;
+    span_id_ = new_id();
+    previous_span_id_ = t_span_id;
+    t_span_id = span_id_;
+    on_current_thread_ = true;
+    name_ = name;
+    value_ = value;
+    start_ns_ = now_ns();
+}
+
+Span::Span(uint64_t trace_id, uint64_t parent_span_id, const char* name, int64_t value) {
+    if (trace_id == 0) { return; }
+    trace_id_ = trace_id;
+    parent_id_ = parent_span_id;
+    span_id_ = new_id();
+    name_ = name;
+    value_ = value;
+    start_ns_ = now_ns();
+}
+
+Span::~Span() {
+    if (trace_id_ == 0) { return; }
+    record_span(trace_id_, span_id_, parent_id_, name_, start_ns_, now_ns(), value_);
+    if (on_current_thread_) {
+        t_span_id = previous_span_id_;
+    }
+}
+
+} // namespace tracing
+} // namespace cpu_llm_project
@@ -0,0 +1,277 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "cpu_llm_project/api_server.hpp"
+#include "cpu_llm_project/compute_pool.hpp"
+#include "cpu_llm_project/llm_engine.hpp"
+#include "cpu_llm_project/sampler.hpp"
+#include "synthetic_model.hpp"
+
+#include "httplib.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h> // getpid
+
+// Benchmarks do LlmEngine sobre um modelo sintético, sem nenhum download: os números só
+// dependem da máquina e do código. Para comparar duas versões, grave o JSON de cada uma:
+//   run_benchmarks --reporter JSON::out=antes.json --reporter console
+// (ou o target benchmarks_json) e compare os "mean" de cada benchmark.
+
+using cpu_llm_project::GenerationParams;
+using cpu_llm_project::LlmEngine;
+using cpu_llm_project::ModelLoadParams;
+
+namespace {
+
+// Maior que o modelo dos testes, para que as medições sejam dominadas pelas matmuls e
+// não pelo overhead fixo de cada llama_decode.
+test_fixtures::SyntheticModelSpec benchmark_spec() {
+    test_fixtures::SyntheticModelSpec spec;
+    spec.n_embd = 256;
+    spec.n_layer = 4;
+    spec.n_head = 8;
+    spec.n_head_kv = 4;
+    spec.n_ff = 768;
+    return spec;
+}
+
+// Apaga o modelo ao terminar; o nome leva o pid para execuções simultâneas não colidirem.
+class BenchmarkModel {
+public:
+    BenchmarkModel()
+        : path_((std::filesystem::temp_directory_path() /
+                 ("cpu_llm_benchmark_model." + std::to_string(::getpid()) + ".gguf")).string()) {
+        std::string error;
+        if (!test_fixtures::write_synthetic_model(path_, benchmark_spec(), error)) { path_.clear(); }
+    }
+    ~BenchmarkModel() {
+        if (!path_.empty()) { std::remove(path_.c_str()); }
+    }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+const BenchmarkModel& benchmark_model() {
+    static const BenchmarkModel model;
+    return model;
+}
+
+std::string repeat(const std::string& text, int times) {
+    std::string out;
+    for (int i = 0; i < times; ++i) { out += text; }
+    return out;
+}
+
+int count_tokens(const llama_vocab* vocab, const std::string& text) {
+    std::vector<llama_token> tokens(text.size() + 16);
+    return llama_tokenize(vocab, text.c_str(), static_cast<int32_t>(text.size()), tokens.data(),
+                          static_cast<int32_t>(tokens.size()), true, false);
+}
+
+} // namespace
+
+TEST_CASE("LlmEngine on a synthetic model", "[benchmark]") {
+    const BenchmarkModel& model = benchmark_model();
+    REQUIRE_FALSE(model.path().empty());
+
+    LlmEngine engine;
+    ModelLoadParams load_params;
+    load_params.model_path = model.path();
+    load_params.n_ctx = 1024;
+
+    BENCHMARK("load_model + unload_model") {
+        const bool loaded = engine.load_model(load_params);
+        engine.unload_model();
+        return loaded;
+    };
+
+    REQUIRE(engine.load_model(load_params));
+
+    // Gerações sem cache de respostas e gulosas: o modelo sintético nunca emite EOG, então
+    // cada chamada gera exatamente max_tokens tokens.
+    GenerationParams params;
+    params.temperature = 0.0f;
+    params.use_cache = false;
+
+    llama_model_params vocab_params = llama_model_default_params();
+    vocab_params.vocab_only = true;
+    llama_model* vocab_model = llama_model_load_from_file(model.path().c_str(), vocab_params);
+    REQUIRE(vocab_model != nullptr);
+    const llama_vocab* vocab = llama_model_get_vocab(vocab_model);
+
+    const std::string long_prompt = repeat("hello world de que para com mais como the capital of França ", 24);
+    const int prompt_tokens = count_tokens(vocab, long_prompt);
+    REQUIRE(prompt_tokens > 0);
+
+    BENCHMARK("tokenize (" + std::to_string(long_prompt.size()) + " bytes)") {
+        return count_tokens(vocab, long_prompt);
+    };
+
+    // tok/s = tokens / mean. O prefill gera um único token. O predict com 64 tokens inclui
+    // o prefill do prompt curto (e a amostragem); o decode sozinho é medido em
+    // "Single-token decode steps", abaixo.
+    params.max_tokens = 1;
+    BENCHMARK("prefill " + std::to_string(prompt_tokens) + " tokens") {
+        return engine.predict(long_prompt, "", params);
+    };
+
+    BENCHMARK("short prompt, 1 token (prefill only)") {
+        return engine.predict("hello", "", params);
+    };
+
+    const int decode_tokens = 64;
+    params.max_tokens = decode_tokens;
+    BENCHMARK("short prompt, " + std::to_string(decode_tokens) + " tokens (prefill + decode)") {
+        return engine.predict("hello", "", params);
+    };
+
+    llama_model_free(vocab_model);
+}
+
+// Só os passos de decode: o prompt é processado uma vez, fora da região medida, e cada
+// execução dá decode_tokens llama_decode de um token sobre ele, sem amostrar (o token de
+// entrada não muda o custo). Entre duas amostras, as células do decode são removidas fora
+// da medição. Se o Catch2 pedir várias execuções por amostra, cada uma usa uma sequência
+// própria, copiada do prompt (com kv_unified a cópia não duplica células).
+TEST_CASE("Single-token decode steps on a synthetic model", "[benchmark]") {
+    const BenchmarkModel& model = benchmark_model();
+    REQUIRE_FALSE(model.path().empty());
+
+    llama_model* llm = llama_model_load_from_file(model.path().c_str(), llama_model_default_params());
+    REQUIRE(llm != nullptr);
+    const llama_vocab* vocab = llama_model_get_vocab(llm);
+
+    const std::string prompt = repeat("hello world de que para com mais como ", 8);
+    std::vector<llama_token> prompt_tokens(prompt.size() + 16);
+    const int n_prompt = llama_tokenize(vocab, prompt.c_str(), static_cast<int32_t>(prompt.size()), prompt_tokens.data(),
+                                        static_cast<int32_t>(prompt_tokens.size()), true, false);
+    REQUIRE(n_prompt > 0);
+    prompt_tokens.resize(n_prompt);
+
+    const int decode_tokens = 64;
+    const int max_runs = 8; // Execuções por amostra; um passo do modelo do benchmark leva bem mais que a resolução do relógio
+    const int n_threads = static_cast<int>(cpu_llm_project::ComputePools::available_cpus().size());
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = static_cast<uint32_t>(n_prompt + max_runs * decode_tokens + 256);
+    ctx_params.n_batch = static_cast<uint32_t>(n_prompt);
+    ctx_params.n_seq_max = static_cast<uint32_t>(max_runs);
+    ctx_params.kv_unified = true;
+    ctx_params.n_threads = n_threads;
+    ctx_params.n_threads_batch = n_threads;
+    llama_context* ctx = llama_init_from_model(llm, ctx_params);
+    REQUIRE(ctx != nullptr);
+    llama_memory_t memory = llama_get_memory(ctx);
+
+    REQUIRE(llama_decode(ctx, llama_batch_get_one(prompt_tokens.data(), n_prompt)) == 0);
+    for (llama_seq_id seq = 1; seq < max_runs; ++seq) {
+        llama_memory_seq_cp(memory, 0, seq, -1, -1);
+    }
+
+    llama_batch step = llama_batch_init(1, 0, 1);
+    step.n_tokens = 1;
+    step.n_seq_id[0] = 1;
+    step.logits[0] = true; // A projeção para o vocabulário faz parte de cada passo de geração
+
+    BENCHMARK_ADVANCED("decode " + std::to_string(decode_tokens) + " tokens after a " + std::to_string(n_prompt) +
+                       "-token prompt (llama_decode only)")(Catch::Benchmark::Chronometer meter) {
+        REQUIRE(meter.runs() <= max_runs);
+        for (llama_seq_id seq = 0; seq < max_runs; ++seq) {
+            llama_memory_seq_rm(memory, seq, n_prompt, -1);
+        }
+        meter.measure([&](int run) {
+            int32_t failed = 0;
+            for (int i = 0; i < decode_tokens; ++i) {
+                step.token[0] = prompt_tokens[i % n_prompt];
+                step.pos[0] = n_prompt + i;
+                step.seq_id[0][0] = run;
+                failed |= llama_decode(ctx, step);
+            }
+            return failed;
+        });
+    };
+
+    llama_batch_free(step);
+    llama_free(ctx);
+    llama_model_free(llm);
+}
+
+TEST_CASE("Sampler on a 32k vocabulary", "[benchmark]") {
+    const int n_vocab = 32000;
+    std::mt19937 rng(42);
+    std::normal_distribution<float> dist(0.0f, 3.0f);
+    std::vector<float> logits(n_vocab);
+    for (float& value : logits) { value = dist(rng); }
+    std::vector<float> work(n_vocab);
+
+    cpu_llm_project::SamplingParams sampling;
+    sampling.seed = 42;
+    cpu_llm_project::Sampler sampler(sampling);
+    for (llama_token token : {1, 2, 3, 500, 1000, 20000}) { sampler.accept(token); }
+
+    BENCHMARK("sample (top-k/top-p, repeat penalty)") {
+        work = logits;
+        return sampler.sample(work.data(), n_vocab);
+    };
+}
+
+TEST_CASE("HTTP round-trip on a synthetic model", "[benchmark]") {
+    const BenchmarkModel& model = benchmark_model();
+    REQUIRE_FALSE(model.path().empty());
+
+    LlmEngine engine;
+    ModelLoadParams load_params;
+    load_params.model_path = model.path();
+    load_params.n_ctx = 1024;
+    REQUIRE(engine.load_model(load_params));
+
+    // Porta 0: o próprio servidor pede uma porta livre ao sistema no bind, sem a corrida de
+    // reservar uma porta antes e reabri-la depois.
+    cpu_llm_project::ApiServer server(engine, "127.0.0.1", 0);
+    std::thread server_thread([&server]() { server.start(); });
+
+    bool ready = false;
+    for (int attempt = 0; attempt < 100 && !ready; ++attempt) {
+        if (server.port() > 0) {
+            httplib::Client probe("127.0.0.1", server.port());
+            ready = static_cast<bool>(probe.Get("/health"));
+        }
+        if (!ready) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }
+    }
+    if (!ready) {
+        server.stop();
+        server_thread.join();
+        FAIL("ApiServer did not start");
+    }
+    httplib::Client client("127.0.0.1", server.port());
+
+    // Uma requisição que falhou vale status 0 em vez de derrubar o benchmark; no fim,
+    // failures precisa estar zerado para os tempos valerem.
+    int failures = 0;
+    auto status_of = [&failures](const httplib::Result& result) {
+        if (!result || result->status != 200) { ++failures; }
+        return result ? result->status : 0;
+    };
+
+    BENCHMARK("GET /health") {
+        return status_of(client.Get("/health"));
+    };
+
+    const std::string body = R"({"prompt": "hello", "max_tokens": 8, "temperature": 0, "cache": false})";
+    BENCHMARK("POST /api/generate (8 tokens)") {
+        return status_of(client.Post("/api/generate", body, "application/json"));
+    };
+
+    CHECK(failures == 0);
+
+    server.stop();
+    server_thread.join();
+}
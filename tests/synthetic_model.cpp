@@ -0,0 +1,199 @@
+#include "synthetic_model.hpp"
+
+#include "ggml.h"
+#include "gguf.h"
+#include "llama.h" // llama_token_type
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h> // getpid
+
+namespace test_fixtures {
+
+namespace {
+
+struct VocabEntry {
+    std::string text;
+    float score;
+    int32_t type;
+};
+
+// "▁" (U+2581) é o marcador de espaço do SentencePiece.
+const std::string kSpace = "\xE2\x96\x81";
+
+std::vector<VocabEntry> build_vocab() {
+    std::vector<VocabEntry> vocab = {
+        {"<unk>", 0.0f, LLAMA_TOKEN_TYPE_UNKNOWN},
+        {"<s>", 0.0f, LLAMA_TOKEN_TYPE_CONTROL},
+        {"</s>", 0.0f, LLAMA_TOKEN_TYPE_CONTROL},
+        {"<start_of_turn>", 0.0f, LLAMA_TOKEN_TYPE_CONTROL},
+        {"<end_of_turn>", 0.0f, LLAMA_TOKEN_TYPE_CONTROL},
+    };
+    // Tokens de byte: qualquer texto é tokenizável, mesmo fora das palavras abaixo.
+    for (int byte = 0; byte < 256; ++byte) {
+        char text[8];
+        std::snprintf(text, sizeof(text), "<0x%02X>", byte);
+        vocab.push_back({text, 0.0f, LLAMA_TOKEN_TYPE_BYTE});
+    }
+    // Peças maiores têm score maior, para o SentencePiece preferi-las aos bytes.
+    vocab.push_back({kSpace, 1.0f, LLAMA_TOKEN_TYPE_NORMAL});
+    for (char c = '!'; c <= '~'; ++c) {
+        vocab.push_back({std::string(1, c), 1.0f, LLAMA_TOKEN_TYPE_NORMAL});
+    }
+    for (char c = 'a'; c <= 'z'; ++c) {
+        vocab.push_back({kSpace + std::string(1, c), 2.0f, LLAMA_TOKEN_TYPE_NORMAL});
+    }
+    const char* words[] = {"the", "of", "and", "to", "in", "is", "model", "user", "hello", "world",
+                           "de", "que", "não", "um", "uma", "para", "com", "por", "mais", "como",
+                           "capital", "França", "Paris", "Roma"};
+    for (const char* word : words) {
+        const std::string piece = kSpace + word;
+        vocab.push_back({piece, static_cast<float>(piece.size()), LLAMA_TOKEN_TYPE_NORMAL});
+    }
+    return vocab;
+}
+
+// Uniforme em [-scale, scale) a partir dos bits do mt19937, que são iguais em qualquer
+// biblioteca padrão (as distribuições do <random> não são).
+class WeightGenerator {
+public:
+    explicit WeightGenerator(uint32_t seed) : rng_(seed) {}
+
+    float next(float scale) {
+        return (static_cast<float>(rng_()) / 4294967296.0f * 2.0f - 1.0f) * scale;
+    }
+
+private:
+    std::mt19937 rng_;
+};
+
+} // namespace
+
+bool write_synthetic_model(const std::string& path, const SyntheticModelSpec& spec, std::string& error) {
+    if (spec.n_embd <= 0 || spec.n_head <= 0 || spec.n_head_kv <= 0 || spec.n_layer <= 0 || spec.n_ff <= 0 ||
+        spec.n_embd % spec.n_head != 0 || spec.n_head % spec.n_head_kv != 0 || (spec.n_embd / spec.n_head) % 2 != 0) {
+        error = "invalid synthetic model dimensions";
+        return false;
+    }
+    const std::vector<VocabEntry> vocab = build_vocab();
+    const int64_t n_vocab = static_cast<int64_t>(vocab.size());
+    const int64_t n_embd = spec.n_embd;
+    const int64_t n_embd_head = n_embd / spec.n_head;
+    const int64_t n_embd_kv = n_embd_head * spec.n_head_kv;
+    const int64_t n_ff = spec.n_ff;
+
+    const int64_t n_elements = 2 * n_vocab * n_embd + n_embd +
+        spec.n_layer * (2 * n_embd + 2 * n_embd * n_embd + 2 * n_embd * n_embd_kv + 3 * n_embd * n_ff);
+    const int n_tensors = 3 + 9 * spec.n_layer;
+
+    ggml_init_params params = {};
+    params.mem_size = static_cast<size_t>(n_elements) * sizeof(float) + n_tensors * ggml_tensor_overhead() + 1024 * 1024;
+    params.mem_buffer = nullptr;
+    params.no_alloc = false;
+    ggml_context* ctx = ggml_init(params);
+    if (!ctx) {
+        error = "ggml_init failed";
+        return false;
+    }
+    gguf_context* gguf = gguf_init_empty();
+
+    gguf_set_val_str(gguf, "general.architecture", "llama");
+    gguf_set_val_str(gguf, "general.name", "synthetic");
+    gguf_set_val_u32(gguf, "llama.context_length", static_cast<uint32_t>(spec.n_ctx_train));
+    gguf_set_val_u32(gguf, "llama.embedding_length", static_cast<uint32_t>(n_embd));
+    gguf_set_val_u32(gguf, "llama.block_count", static_cast<uint32_t>(spec.n_layer));
+    gguf_set_val_u32(gguf, "llama.feed_forward_length", static_cast<uint32_t>(n_ff));
+    gguf_set_val_u32(gguf, "llama.attention.head_count", static_cast<uint32_t>(spec.n_head));
+    gguf_set_val_u32(gguf, "llama.attention.head_count_kv", static_cast<uint32_t>(spec.n_head_kv));
+    gguf_set_val_u32(gguf, "llama.rope.dimension_count", static_cast<uint32_t>(n_embd_head));
+    gguf_set_val_f32(gguf, "llama.attention.layer_norm_rms_epsilon", 1e-5f);
+    gguf_set_val_u32(gguf, "general.file_type", 0); // ALL_F32
+
+    std::vector<const char*> texts;
+    std::vector<float> scores;
+    std::vector<int32_t> types;
+    for (const VocabEntry& entry : vocab) {
+        texts.push_back(entry.text.c_str());
+        scores.push_back(entry.score);
+        types.push_back(entry.type);
+    }
+    gguf_set_val_str(gguf, "tokenizer.ggml.model", "llama");
+    gguf_set_arr_str(gguf, "tokenizer.ggml.tokens", texts.data(), texts.size());
+    gguf_set_arr_data(gguf, "tokenizer.ggml.scores", GGUF_TYPE_FLOAT32, scores.data(), scores.size());
+    gguf_set_arr_data(gguf, "tokenizer.ggml.token_type", GGUF_TYPE_INT32, types.data(), types.size());
+    gguf_set_val_u32(gguf, "tokenizer.ggml.unknown_token_id", 0);
+    gguf_set_val_u32(gguf, "tokenizer.ggml.bos_token_id", 1);
+    gguf_set_val_u32(gguf, "tokenizer.ggml.eos_token_id", 2);
+    gguf_set_val_bool(gguf, "tokenizer.ggml.add_bos_token", true);
+    gguf_set_val_bool(gguf, "tokenizer.ggml.add_eos_token", false);
+
+    WeightGenerator weights(spec.seed);
+    auto add_tensor = [&](const std::string& name, int64_t ne0, int64_t ne1, float scale) {
+        ggml_tensor* tensor = ne1 > 0 ? ggml_new_tensor_2d(ctx, GGML_TYPE_F32, ne0, ne1)
+                                      : ggml_new_tensor_1d(ctx, GGML_TYPE_F32, ne0);
+        ggml_set_name(tensor, name.c_str());
+        float* data = static_cast<float*>(tensor->data);
+        for (int64_t i = 0; i < ggml_nelements(tensor); ++i) {
+            data[i] = scale > 0.0f ? weights.next(scale) : 1.0f; // scale 0 = peso de norma
+        }
+        gguf_add_tensor(gguf, tensor);
+        return data;
+    };
+
+    // A dimensão 0 de todo embedding vale 1 e domina o fluxo residual (as camadas só
+    // somam valores pequenos), então sobrevive às normas até a saída. Os tokens de fim de
+    // geração têm -1 nessa dimensão de output.weight, e os demais 0: seus logits ficam
+    // bem abaixo de todos os outros, e a geração nunca para antes de max_tokens.
+    float* token_embd = add_tensor("token_embd.weight", n_embd, n_vocab, 0.02f);
+    for (int64_t token = 0; token < n_vocab; ++token) { token_embd[token * n_embd] = 1.0f; }
+    add_tensor("output_norm.weight", n_embd, 0, 0.0f);
+    float* output = add_tensor("output.weight", n_embd, n_vocab, 1.0f);
+    for (int64_t token = 0; token < n_vocab; ++token) {
+        const bool eog = vocab[token].text == "</s>" || vocab[token].text == "<end_of_turn>";
+        output[token * n_embd] = eog ? -1.0f : 0.0f;
+    }
+
+    for (int layer = 0; layer < spec.n_layer; ++layer) {
+        const std::string prefix = "blk." + std::to_string(layer) + ".";
+        add_tensor(prefix + "attn_norm.weight", n_embd, 0, 0.0f);
+        add_tensor(prefix + "attn_q.weight", n_embd, n_embd, 0.02f);
+        add_tensor(prefix + "attn_k.weight", n_embd, n_embd_kv, 0.02f);
+        add_tensor(prefix + "attn_v.weight", n_embd, n_embd_kv, 0.02f);
+        add_tensor(prefix + "attn_output.weight", n_embd, n_embd, 0.02f);
+        add_tensor(prefix + "ffn_norm.weight", n_embd, 0, 0.0f);
+        add_tensor(prefix + "ffn_gate.weight", n_embd, n_ff, 0.02f);
+        add_tensor(prefix + "ffn_down.weight", n_ff, n_embd, 0.02f);
+        add_tensor(prefix + "ffn_up.weight", n_embd, n_ff, 0.02f);
+    }
+
+    const bool written = gguf_write_to_file(gguf, path.c_str(), false);
+    gguf_free(gguf);
+    ggml_free(ctx);
+    if (!written) {
+        error = "failed to write " + path;
+        return false;
+    }
+    return true;
+}
+
+const std::string& synthetic_model_path() {
+    // Inicialização estática local: thread-safe e feita uma única vez.
+    static const std::string path = [] {
+        // Escreve num arquivo próprio e renomeia: run_tests e run_benchmarks rodando ao
+        // mesmo tempo nunca leem um arquivo pela metade (o conteúdo é sempre o mesmo).
+        const std::filesystem::path target = std::filesystem::temp_directory_path() / "cpu_llm_synthetic_model.gguf";
+        const std::string partial = target.string() + "." + std::to_string(::getpid()) + ".tmp";
+        std::string error;
+        if (!write_synthetic_model(partial, SyntheticModelSpec(), error)) { return std::string(); }
+        std::error_code ec;
+        std::filesystem::rename(partial, target, ec);
+        return ec ? std::string() : target.string();
+    }();
+    return path;
+}
+
+} // namespace test_fixtures
@@ -0,0 +1,33 @@
+#ifndef CPU_LLM_PROJECT_TESTS_SYNTHETIC_MODEL_HPP
+#define CPU_LLM_PROJECT_TESTS_SYNTHETIC_MODEL_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace test_fixtures {
+
+// Dimensões de um modelo de arquitetura llama com pesos aleatórios. Os padrões geram
+// um arquivo de poucas centenas de KB, que carrega e gera em milissegundos.
+struct SyntheticModelSpec {
+    int n_embd = 64;
+    int n_layer = 2;
+    int n_head = 4;
+    int n_head_kv = 2;
+    int n_ff = 128;
+    int n_ctx_train = 2048;
+    uint32_t seed = 42;  // Mesma seed, mesmo arquivo, em qualquer plataforma
+};
+
+// Escreve em path um GGUF (pesos f32) com tokenizer SentencePiece de ~400 tokens: <unk>,
+// <s>, </s>, os tokens do template de chat, os 256 tokens de byte e algumas palavras.
+// Os pesos são aleatórios, mas os tokens de fim de geração nunca vencem a amostragem,
+// então toda geração produz exatamente max_tokens tokens.
+bool write_synthetic_model(const std::string& path, const SyntheticModelSpec& spec, std::string& error);
+
+// Caminho de um modelo com a spec padrão no diretório temporário, escrito na primeira
+// chamada e reaproveitado pelo resto do processo. Vazio se a escrita falhar.
+const std::string& synthetic_model_path();
+
+} // namespace test_fixtures
+
+#endif // CPU_LLM_PROJECT_TESTS_SYNTHETIC_MODEL_HPP
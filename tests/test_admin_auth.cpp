@@ -0,0 +1,32 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/admin_auth.hpp"
+
+#include <string>
+
+using cpu_llm_project::authorize_admin_request;
+
+TEST_CASE("Admin routes need the Unix socket or the configured token", "[admin_auth]") {
+    int status = 0;
+    std::string error;
+
+    SECTION("The Unix socket is always allowed") {
+        REQUIRE(authorize_admin_request("", "", true, status, error));
+        REQUIRE(authorize_admin_request("s3cret", "", true, status, error));
+    }
+
+    SECTION("Without a configured token, TCP is refused") {
+        REQUIRE_FALSE(authorize_admin_request("", "Bearer ", false, status, error));
+        REQUIRE(status == 403);
+        REQUIRE_FALSE(error.empty());
+    }
+
+    SECTION("With a configured token, TCP needs the matching bearer token") {
+        REQUIRE(authorize_admin_request("s3cret", "Bearer s3cret", false, status, error));
+
+        for (const char* header : {"", "s3cret", "Bearer s3cre", "Bearer s3cret2", "Bearer S3CRET", "Basic s3cret"}) {
+            status = 0;
+            REQUIRE_FALSE(authorize_admin_request("s3cret", header, false, status, error));
+            REQUIRE(status == 401);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/autotune.hpp"
+
+#include <cmath>
+#include <set>
+
+using namespace cpu_llm_project;
+
+namespace {
+
+// Modelo de desempenho fictício: decode melhor com 4 threads e q8_0; prefill cresce com
+// threads e batch até 1024; flash attention ajuda um pouco; q8_0 sem flash attention falha
+// (como o cache V quantizado no llama.cpp).
+TuneMeasurement fake_measure(const TuneConfig& config) {
+    TuneMeasurement m;
+    if (config.kv_cache_type == "q8_0" && !config.flash_attn) {
+        m.error = "V quantizado requer flash attention";
+        return m;
+    }
+    m.ok = true;
+    m.decode_tok_s = 20.0 - std::abs(config.decode_threads - 4) + (config.kv_cache_type == "q8_0" ? 2.0 : 0.0)
+                   + (config.flash_attn ? 1.0 : 0.0);
+    m.prefill_tok_s = config.prefill_threads * 10.0 + (config.n_batch >= 1024 ? 50.0 : 0.0) + config.n_ubatch / 64.0;
+    m.ttft_ms = 100000.0 / m.prefill_tok_s;
+    return m;
+}
+
+TuneSearchSpace small_space() {
+    TuneSearchSpace space;
+    space.threads = {2, 4, 8};
+    space.n_batch = {512, 1024};
+    space.n_ubatch = {256, 512};
+    space.kv_cache_types = {"f16", "q8_0"};
+    space.flash_attn = {false, true};
+    return space;
+}
+
+} // namespace
+
+TEST_CASE("Coordinate descent finds the best configuration of a separable model", "[autotune]") {
+    TuneConfig start;
+    start.prefill_threads = 8;
+    start.decode_threads = 8;
+
+    std::set<std::string> measured;
+    int calls = 0;
+    AutotuneResult result;
+    const TuneConfig best = autotune::coordinate_descent(small_space(), start, TuneObjective::DecodeThroughput, 3,
+        [&](const TuneConfig& config) {
+            ++calls;
+            measured.insert(config.to_string());
+            REQUIRE(config.n_ubatch <= config.n_batch);
+            return fake_measure(config);
+        }, result);
+
+    REQUIRE(best.decode_threads == 4);
+    REQUIRE(best.kv_cache_type == "q8_0");
+    REQUIRE(best.flash_attn);
+    // Os parâmetros de prefill são julgados pela vazão de prefill mesmo com objetivo decode.
+    REQUIRE(best.prefill_threads == 8);
+    REQUIRE(best.n_batch == 1024);
+    REQUIRE(best.n_ubatch == 512);
+
+    REQUIRE(result.best.to_string() == best.to_string());
+    REQUIRE(result.best_measurement.ok);
+    // Nenhuma combinação é medida duas vezes.
+    REQUIRE(calls == result.trials);
+    REQUIRE(static_cast<int>(measured.size()) == calls);
+}
+
+TEST_CASE("Coordinate descent escapes a failing start", "[autotune]") {
+    TuneConfig start;
+    start.prefill_threads = 2;
+    start.decode_threads = 2;
+    start.kv_cache_type = "q8_0"; // Falha sem flash attention
+    AutotuneResult result;
+    const TuneConfig best = autotune::coordinate_descent(small_space(), start, TuneObjective::PrefillThroughput, 2,
+                                                         fake_measure, result);
+    REQUIRE(result.best_measurement.ok);
+    REQUIRE(best.prefill_threads == 8);
+    REQUIRE(best.n_batch == 1024);
+}
+
+TEST_CASE("Objectives parse and score measurements", "[autotune]") {
+    TuneObjective objective = TuneObjective::DecodeThroughput;
+    REQUIRE(autotune::parse_objective("ttft", objective));
+    REQUIRE(objective == TuneObjective::TimeToFirstToken);
+    REQUIRE(std::string(autotune::objective_name(objective)) == "ttft");
+    REQUIRE(autotune::parse_objective("prefill", objective));
+    REQUIRE(objective == TuneObjective::PrefillThroughput);
+    REQUIRE_FALSE(autotune::parse_objective("latency", objective));
+
+    TuneMeasurement fast, slow, failed;
+    fast.ok = slow.ok = true;
+    fast.ttft_ms = 50.0;
+    slow.ttft_ms = 80.0;
+    REQUIRE(autotune::objective_score(TuneObjective::TimeToFirstToken, fast) >
+            autotune::objective_score(TuneObjective::TimeToFirstToken, slow));
+    REQUIRE(std::isinf(autotune::objective_score(TuneObjective::DecodeThroughput, failed)));
+}
+
+TEST_CASE("Default search space covers thread fractions without duplicates", "[autotune]") {
+    TuneSearchSpace space = autotune::default_search_space(16);
+    REQUIRE(space.threads == std::vector<int>{4, 8, 12, 16});
+    space = autotune::default_search_space(2);
+    REQUIRE(space.threads == std::vector<int>{1, 2});
+    REQUIRE_FALSE(space.n_batch.empty());
+    REQUIRE_FALSE(space.kv_cache_types.empty());
+}
+
+TEST_CASE("The hardware fingerprint is stable", "[autotune]") {
+    const std::string fingerprint = autotune::hardware_fingerprint();
+    REQUIRE_FALSE(fingerprint.empty());
+    REQUIRE(fingerprint == autotune::hardware_fingerprint());
+}
@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/compute_pool.hpp"
+
+using cpu_llm_project::ComputePools;
+
+TEST_CASE("Batches lock the pools llama.cpp will compute them on", "[compute_pool]") {
+    bool prefill = false, decode = false;
+
+    // Passo de geração: um token, só o pool de decode.
+    ComputePools::pools_for_batch(1, 512, prefill, decode);
+    REQUIRE_FALSE(prefill);
+    REQUIRE(decode);
+
+    // Um único micro-batch com vários tokens: só o de prefill.
+    ComputePools::pools_for_batch(300, 512, prefill, decode);
+    REQUIRE(prefill);
+    REQUIRE_FALSE(decode);
+
+    ComputePools::pools_for_batch(512, 512, prefill, decode);
+    REQUIRE(prefill);
+    REQUIRE_FALSE(decode);
+
+    // Mais de um micro-batch: qualquer um pode ter um token só (o último, ou um do meio
+    // no split_equal de várias sequências), então os dois pools.
+    ComputePools::pools_for_batch(513, 512, prefill, decode);
+    REQUIRE(prefill);
+    REQUIRE(decode);
+
+    ComputePools::pools_for_batch(1024, 512, prefill, decode);
+    REQUIRE(prefill);
+    REQUIRE(decode);
+
+    // n_ubatch = 1: todo micro-batch tem um token.
+    ComputePools::pools_for_batch(8, 1, prefill, decode);
+    REQUIRE_FALSE(prefill);
+    REQUIRE(decode);
+}
+
+TEST_CASE("Pool options compare by value", "[compute_pool]") {
+    cpu_llm_project::ComputePoolOptions a, b;
+    REQUIRE(a == b);
+    b.poll = 0;
+    REQUIRE(a != b);
+    b = a;
+    b.partition_cpus = true;
+    REQUIRE(a != b);
+}
+
+TEST_CASE("The process can run on at least one CPU", "[compute_pool]") {
+    REQUIRE_FALSE(ComputePools::available_cpus().empty());
+}
@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/connection_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using cpu_llm_project::BoundedConnectionQueue;
+
+namespace {
+
+// Tarefa que simula uma conexão aberta: fica presa até release().
+class Gate {
+public:
+    std::function<void()> task() {
+        return [this]() {
+            started_.fetch_add(1);
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return open_; });
+        };
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    bool wait_started(int count) const {
+        for (int attempt = 0; attempt < 200 && started_.load() < count; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return started_.load() >= count;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool open_ = false;
+    std::atomic<int> started_{0};
+};
+
+// Libera as tarefas e espera as threads da fila ao sair do escopo, mesmo se um REQUIRE
+// falhar: o ThreadPool do httplib não faz join no destrutor.
+struct ShutdownGuard {
+    Gate& gate;
+    BoundedConnectionQueue& queue;
+    ~ShutdownGuard() {
+        gate.release();
+        queue.shutdown();
+    }
+};
+
+struct Counters {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> active{0};
+    std::atomic<uint64_t> peak_active{0};
+};
+
+} // namespace
+
+TEST_CASE("BoundedConnectionQueue rejects connections beyond its limits", "[connection_queue]") {
+    Counters counters;
+    Gate gate;
+
+    SECTION("max_queued: a full queue rejects the next connection") {
+        BoundedConnectionQueue queue(1, 1, 0, counters.accepted, counters.rejected, counters.active, counters.peak_active);
+        ShutdownGuard guard{gate, queue};
+        REQUIRE(queue.enqueue(gate.task()));
+        REQUIRE(gate.wait_started(1)); // A única thread está ocupada; a fila está vazia
+        REQUIRE(queue.enqueue(gate.task()));
+        REQUIRE_FALSE(queue.enqueue(gate.task()));
+        REQUIRE(counters.accepted == 2);
+        REQUIRE(counters.rejected == 1);
+        REQUIRE(counters.active == 2);
+    }
+
+    SECTION("max_connections: open connections are capped across running and queued") {
+        BoundedConnectionQueue queue(1, 0, 2, counters.accepted, counters.rejected, counters.active, counters.peak_active);
+        ShutdownGuard guard{gate, queue};
+        REQUIRE(queue.enqueue(gate.task()));
+        REQUIRE(queue.enqueue(gate.task()));
+        REQUIRE_FALSE(queue.enqueue(gate.task()));
+        REQUIRE(counters.rejected == 1);
+        REQUIRE(counters.peak_active == 2);
+    }
+
+    // Conexões fechadas liberam a vaga.
+    REQUIRE(counters.active == 0);
+}
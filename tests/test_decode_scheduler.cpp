@@ -0,0 +1,244 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/decode_scheduler.hpp"
+#include "synthetic_model.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using cpu_llm_project::DecodeJob;
+using cpu_llm_project::SlotTable;
+
+TEST_CASE("Slot table reserves sequences and cells together", "[decode_scheduler]") {
+    SlotTable slots(4, 1000);
+    std::vector<llama_seq_id> a, b, c;
+
+    REQUIRE(slots.reserve(1, 300, a));
+    REQUIRE(a == std::vector<llama_seq_id>{0});
+    REQUIRE(slots.reserve(2, 500, b));
+    REQUIRE(b == std::vector<llama_seq_id>{1, 2});
+    REQUIRE(slots.free_slots() == 1);
+    REQUIRE(slots.free_cells() == 200);
+
+    // Cabe no contexto vazio, mas não agora: nada é reservado.
+    REQUIRE(slots.fits(1, 400));
+    REQUIRE_FALSE(slots.reserve(1, 400, c));
+    REQUIRE(c.empty());
+    REQUIRE(slots.free_slots() == 1);
+    REQUIRE(slots.free_cells() == 200);
+
+    // Liberar uma geração devolve as sequências e as células dela.
+    slots.release(a, 300);
+    REQUIRE(slots.reserve(2, 400, c));
+    REQUIRE(c == std::vector<llama_seq_id>{0, 3});
+    REQUIRE(slots.free_slots() == 0);
+    REQUIRE(slots.free_cells() == 100);
+}
+
+TEST_CASE("Generations larger than the decode context never fit", "[decode_scheduler]") {
+    SlotTable slots(2, 512);
+    REQUIRE(slots.fits(2, 512));
+    REQUIRE_FALSE(slots.fits(3, 10));
+    REQUIRE_FALSE(slots.fits(1, 513));
+
+    std::vector<llama_seq_id> ids;
+    REQUIRE_FALSE(slots.reserve(0, 10, ids));
+    REQUIRE(slots.free_slots() == 2);
+}
+
+// O escalonador de verdade, sobre o modelo sintético (tests/synthetic_model.cpp): os prompts
+// passam pelo contexto de prefill, o estado vai para o de decode e várias gerações
+// concorrentes dividem os passos. O modelo nunca emite EOG, então cada geração termina
+// exatamente em max_tokens.
+TEST_CASE("Decode scheduler runs concurrent generations to completion", "[decode_scheduler]") {
+    const std::string model_path = test_fixtures::synthetic_model_path();
+    REQUIRE_FALSE(model_path.empty());
+
+    llama_backend_init();
+    llama_model* model = llama_model_load_from_file(model_path.c_str(), llama_model_default_params());
+    REQUIRE(model != nullptr);
+    const llama_vocab* vocab = llama_model_get_vocab(model);
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = 512;
+    ctx_params.n_batch = 128;
+    ctx_params.n_ubatch = 128;
+    ctx_params.n_seq_max = 3;
+    ctx_params.kv_unified = true;
+    ctx_params.n_threads = 2;
+    ctx_params.n_threads_batch = 2;
+    llama_context* prefill_ctx = llama_init_from_model(model, ctx_params);
+    llama_context* decode_ctx = llama_init_from_model(model, ctx_params);
+    REQUIRE(prefill_ctx != nullptr);
+    REQUIRE(decode_ctx != nullptr);
+
+    // Prompts processados antes, um por vez, na seq 0 do contexto de prefill (como predict_n).
+    const int n_jobs = 6;
+    std::vector<DecodeJob> jobs(n_jobs);
+    std::vector<std::vector<llama_token>> expected(n_jobs);
+    for (int j = 0; j < n_jobs; ++j) {
+        const std::string prompt = "hello world " + std::string(static_cast<size_t>(j + 1), 'a');
+        std::vector<llama_token> tokens(prompt.size() + 16);
+        const int n = llama_tokenize(vocab, prompt.c_str(), static_cast<int32_t>(prompt.size()), tokens.data(),
+                                     static_cast<int32_t>(tokens.size()), true, false);
+        REQUIRE(n > 0);
+        tokens.resize(n);
+        llama_memory_seq_rm(llama_get_memory(prefill_ctx), 0, -1, -1);
+        llama_batch batch = llama_batch_init(n, 0, 1);
+        for (int i = 0; i < n; ++i) {
+            batch.token[i] = tokens[i];
+            batch.pos[i] = i;
+            batch.n_seq_id[i] = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i] = i == n - 1;
+        }
+        batch.n_tokens = n;
+        REQUIRE(llama_decode(prefill_ctx, batch) == 0);
+        llama_batch_free(batch);
+
+        DecodeJob& job = jobs[j];
+        const float* logits = llama_get_logits_ith(prefill_ctx, -1);
+        job.prompt_logits.assign(logits, logits + llama_vocab_n_tokens(vocab));
+        job.prompt_state.resize(llama_state_seq_get_size(prefill_ctx, 0));
+        job.prompt_state.resize(llama_state_seq_get_data(prefill_ctx, job.prompt_state.data(), job.prompt_state.size(), 0));
+        REQUIRE_FALSE(job.prompt_state.empty());
+        job.n_prompt_tokens = n;
+        job.max_tokens = 4 + 3 * j;          // Saem em passos diferentes
+        const int n_seqs = j == 1 ? 2 : 1;   // Uma geração com n = 2 (seq_cp no contexto de decode)
+        cpu_llm_project::SamplingParams sampling;
+        sampling.temperature = 0.0f;
+        for (int s = 0; s < n_seqs; ++s) {
+            job.samplers.emplace_back(sampling);
+            for (llama_token token : tokens) { job.samplers.back().accept(token); }
+        }
+
+        // Referência: a mesma geração greedy continuando no próprio contexto de prefill.
+        // Se o estado KV não chegar inteiro ao contexto de decode, os tokens divergem a
+        // partir do segundo (o primeiro sai dos logits do prompt).
+        cpu_llm_project::Sampler reference(sampling);
+        for (llama_token token : tokens) { reference.accept(token); }
+        std::vector<float> logits_copy = job.prompt_logits;
+        float* step_logits = logits_copy.data();
+        llama_batch step = llama_batch_init(1, 0, 1);
+        for (int t = 0; t < job.max_tokens; ++t) {
+            const llama_token token = reference.sample(step_logits, llama_vocab_n_tokens(vocab));
+            reference.accept(token);
+            expected[j].push_back(token);
+            if (t + 1 == job.max_tokens) { break; }
+            step.token[0] = token;
+            step.pos[0] = n + t;
+            step.n_seq_id[0] = 1;
+            step.seq_id[0][0] = 0;
+            step.logits[0] = true;
+            step.n_tokens = 1;
+            REQUIRE(llama_decode(prefill_ctx, step) == 0);
+            step_logits = llama_get_logits_ith(prefill_ctx, -1);
+        }
+        llama_batch_free(step);
+    }
+
+    // 3 seq_ids para 7 sequências: parte das gerações só entra quando outra sai. O primeiro
+    // passo espera um pouco, para que todas já estejam na fila quando o lote começar.
+    std::atomic<int32_t> kv_used_cells{0};
+    std::atomic<int> decode_calls{0};
+    std::atomic<int> max_batch{0};
+    std::atomic<int32_t> max_used_cells{0};
+    {
+        cpu_llm_project::DecodeScheduler scheduler(
+            decode_ctx, vocab, 3, static_cast<int>(llama_n_ctx(decode_ctx)),
+            [&](llama_batch& batch) {
+                if (decode_calls++ == 0) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }
+                max_batch = std::max(max_batch.load(), batch.n_tokens);
+                max_used_cells = std::max(max_used_cells.load(), kv_used_cells.load());
+                return llama_decode(decode_ctx, batch);
+            },
+            kv_used_cells);
+
+        std::vector<std::thread> clients;
+        for (DecodeJob& job : jobs) {
+            clients.emplace_back([&scheduler, &job]() { scheduler.run(job); });
+        }
+        for (std::thread& client : clients) { client.join(); }
+    }
+
+    for (int j = 0; j < n_jobs; ++j) {
+        const DecodeJob& job = jobs[j];
+        INFO("job " << j << " error: " << job.error);
+        REQUIRE(job.ok);
+        REQUIRE(job.tokens.size() == job.samplers.size());
+        for (const std::vector<llama_token>& tokens : job.tokens) {
+            REQUIRE(static_cast<int>(tokens.size()) == job.max_tokens);
+            REQUIRE(tokens == expected[j]); // Estado restaurado (e copiado, com n = 2) intacto
+        }
+    }
+    REQUIRE(max_batch > 1);   // Gerações diferentes dividiram passos
+    REQUIRE(max_batch <= 3);  // Nunca mais sequências que seq_ids
+    // As células contadas entre os passos nunca passam do contexto; ao terminar, cada
+    // geração devolve as suas e o cache fica vazio.
+    REQUIRE(max_used_cells > 0);
+    REQUIRE(max_used_cells <= static_cast<int32_t>(llama_n_ctx(decode_ctx)));
+    REQUIRE(kv_used_cells == 0);
+    for (llama_seq_id seq = 0; seq < static_cast<llama_seq_id>(llama_n_seq_max(decode_ctx)); ++seq) {
+        REQUIRE(llama_memory_seq_pos_max(llama_get_memory(decode_ctx), seq) == -1);
+    }
+
+    llama_free(decode_ctx);
+    llama_free(prefill_ctx);
+    llama_model_free(model);
+}
+
+TEST_CASE("KV cells of forked sequences count the shared prompt once", "[decode_scheduler]") {
+    const std::string model_path = test_fixtures::synthetic_model_path();
+    REQUIRE_FALSE(model_path.empty());
+
+    llama_backend_init();
+    llama_model* model = llama_model_load_from_file(model_path.c_str(), llama_model_default_params());
+    REQUIRE(model != nullptr);
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = 256;
+    ctx_params.n_seq_max = 2;
+    ctx_params.kv_unified = true;
+    ctx_params.n_threads = 2;
+    ctx_params.n_threads_batch = 2;
+    llama_context* ctx = llama_init_from_model(model, ctx_params);
+    REQUIRE(ctx != nullptr);
+    llama_memory_t memory = llama_get_memory(ctx);
+
+    // Prompt de 10 tokens na seq 0, copiado para a seq 1, e um token a mais em cada uma.
+    const int n_prompt = 10;
+    llama_batch batch = llama_batch_init(n_prompt, 0, 1);
+    for (int i = 0; i < n_prompt; ++i) {
+        batch.token[i] = 100 + i;
+        batch.pos[i] = i;
+        batch.n_seq_id[i] = 1;
+        batch.seq_id[i][0] = 0;
+        batch.logits[i] = i == n_prompt - 1;
+    }
+    batch.n_tokens = n_prompt;
+    REQUIRE(llama_decode(ctx, batch) == 0);
+    REQUIRE(cpu_llm_project::kv_cells_in_use(memory, {0, 1}, n_prompt) == n_prompt);
+
+    llama_memory_seq_cp(memory, 0, 1, -1, -1);
+    REQUIRE(cpu_llm_project::kv_cells_in_use(memory, {0, 1}, n_prompt) == n_prompt);
+
+    for (int s = 0; s < 2; ++s) {
+        batch.token[s] = 200 + s;
+        batch.pos[s] = n_prompt;
+        batch.n_seq_id[s] = 1;
+        batch.seq_id[s][0] = s;
+        batch.logits[s] = true;
+    }
+    batch.n_tokens = 2;
+    REQUIRE(llama_decode(ctx, batch) == 0);
+    REQUIRE(cpu_llm_project::kv_cells_in_use(memory, {0, 1}, n_prompt) == n_prompt + 2);
+
+    llama_memory_seq_rm(memory, 1, -1, -1);
+    REQUIRE(cpu_llm_project::kv_cells_in_use(memory, {0, 1}, n_prompt) == n_prompt + 1);
+
+    llama_batch_free(batch);
+    llama_free(ctx);
+    llama_model_free(model);
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/hash_ring.hpp"
+
+#include <map>
+
+using cpu_llm_project::HashRing;
+
+TEST_CASE("HashRing maps keys consistently", "[hash_ring]") {
+    HashRing ring;
+    REQUIRE(ring.node_for("persona") == -1);
+    REQUIRE(ring.nodes_for("persona").empty());
+
+    for (int node = 0; node < 4; ++node) {
+        ring.add_node(node);
+    }
+
+    SECTION("Same key always maps to the same node") {
+        REQUIRE(ring.node_for("assistente juridico") == ring.node_for("assistente juridico"));
+    }
+
+    SECTION("Keys are spread across nodes") {
+        std::map<int, int> counts;
+        for (int i = 0; i < 10000; ++i) {
+            counts[ring.node_for("persona-" + std::to_string(i))]++;
+        }
+        REQUIRE(counts.size() == 4);
+        for (const auto& entry : counts) {
+            REQUIRE(entry.second > 1500);
+            REQUIRE(entry.second < 3500);
+        }
+    }
+
+    SECTION("nodes_for lists every node once, starting at the owner") {
+        std::vector<int> nodes = ring.nodes_for("persona");
+        REQUIRE(nodes.size() == 4);
+        REQUIRE(nodes.front() == ring.node_for("persona"));
+    }
+
+    SECTION("Removing a node only moves its own keys") {
+        std::map<std::string, int> before;
+        for (int i = 0; i < 2000; ++i) {
+            std::string key = "persona-" + std::to_string(i);
+            before[key] = ring.node_for(key);
+        }
+        ring.remove_node(2);
+        for (const auto& entry : before) {
+            int after = ring.node_for(entry.first);
+            REQUIRE(after != 2);
+            if (entry.second != 2) {
+                REQUIRE(after == entry.second);
+            }
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include "cpu_llm_project/llm_engine.hpp"
+#include "synthetic_model.hpp"
+#include <cmath>
 #include <fstream> // Para criar um arquivo dummy GGUF temporário
 
 // Helper para criar um arquivo dummy temporário que se parece com um GGUF (minimamente)
@@ -65,26 +67,28 @@ TEST_CASE("LlmEngine Initialization and Model Loading", "[llm_engine]") {
         std::remove(dummy_file_path.c_str());
     }
 
-    // Nota: Testar o carregamento bem-sucedido de um modelo real é mais um teste de integração
-    // e requer um arquivo de modelo GGUF real, o que pode ser lento e grande.
-    // Esses testes podem ser separados ou marcados para execução condicional.
-    // Exemplo (requer um modelo real em "test_model.gguf"):
-    /*
-    SECTION("Load and unload a real GGUF model (integration test - requires model)") {
-        std::string real_model_path = "test_model.gguf"; // Coloque um modelo pequeno aqui para teste
-        std::ifstream model_check(real_model_path);
-        if (model_check.good()) {
-            REQUIRE(engine.load_model(real_model_path));
-            REQUIRE(engine.is_model_loaded());
-            REQUIRE(engine.get_model_path() == real_model_path);
-            engine.unload_model();
-            REQUIRE_FALSE(engine.is_model_loaded());
-            REQUIRE(engine.get_model_path().empty());
-        } else {
-            WARN("Skipping real model load test: " << real_model_path << " not found.");
-        }
+    SECTION("Reload with an invalid model keeps the engine state") {
+        cpu_llm_project::ModelLoadParams params;
+        params.model_path = "non_existent_model.gguf";
+        REQUIRE_FALSE(engine.reload_model(params));
+        REQUIRE_FALSE(engine.is_model_loaded());
+        REQUIRE(engine.get_model_path().empty());
+    }
+
+    SECTION("Memory budget refuses models it cannot account for") {
+        std::string dummy_file_path = "dummy_budget.gguf";
+        create_dummy_gguf_file(dummy_file_path, true);
+
+        engine.set_memory_budget(1024 * 1024);
+        REQUIRE_FALSE(engine.load_model(dummy_file_path));
+        REQUIRE_FALSE(engine.is_model_loaded());
+        REQUIRE(engine.get_last_error().find("Orçamento de memória") != std::string::npos);
+
+        cpu_llm_project::MemoryReport report = engine.get_memory_report();
+        REQUIRE(report.models.empty());
+        REQUIRE(report.budget_bytes == 1024 * 1024);
+        std::remove(dummy_file_path.c_str());
     }
-    */
 }
 
 TEST_CASE("LlmEngine Prediction Logic (without full model load)", "[llm_engine]") {
@@ -97,7 +101,199 @@ TEST_CASE("LlmEngine Prediction Logic (without full model load)", "[llm_engine]"
         REQUIRE(result.rfind("[Error: Model not loaded]", 0) == 0); // Verifica se começa com a msg de erro
     }
 
+    SECTION("predict_n without a loaded model returns a single error") {
+        cpu_llm_project::GenerationParams params;
+        params.n = 3;
+        std::vector<std::string> results = engine.predict_n("Hello", "", params);
+        REQUIRE(results.size() == 1);
+        REQUIRE(results[0].rfind("[Error: Model not loaded]", 0) == 0);
+        REQUIRE(engine.get_max_sequences() == 0);
+    }
+
+    SECTION("LoRA adapters are unavailable without a loaded model") {
+        REQUIRE(engine.get_lora_adapters().empty());
+
+        cpu_llm_project::ModelLoadParams params;
+        params.model_path = "non_existent_model.gguf";
+        params.lora_adapters.push_back({"juridico", "non_existent_lora.gguf", 1.0f});
+        REQUIRE_FALSE(engine.load_model(params));
+        REQUIRE(engine.get_lora_adapters().empty());
+        REQUIRE_FALSE(engine.get_last_error().empty());
+    }
+
+    SECTION("score without a loaded model fails as a whole") {
+        std::vector<cpu_llm_project::ScoreItem> items = {{"A capital da França é", " Paris"}, {"A capital da França é", " Roma"}};
+        cpu_llm_project::ScoreBatch scored = engine.score(items, cpu_llm_project::ScoreParams());
+        REQUIRE(scored.error == "Model not loaded");
+        REQUIRE(scored.results.empty());
+        REQUIRE(scored.decode_calls == 0);
+    }
+
     // Testar predict com um modelo carregado (mesmo que dummy e falhe na geração)
     // seria mais um teste de integração.
     // Aqui, focamos no comportamento da API da classe LlmEngine.
 }
+
+// Modelo llama minúsculo com pesos aleatórios, gerado no diretório temporário
+// (tests/synthetic_model.cpp): exercita o caminho real do llama.cpp sem baixar nada.
+TEST_CASE("LlmEngine with a synthetic GGUF model", "[llm_engine]") {
+    const std::string model_path = test_fixtures::synthetic_model_path();
+    REQUIRE_FALSE(model_path.empty());
+
+    cpu_llm_project::LlmEngine engine;
+    cpu_llm_project::ModelLoadParams load_params;
+    load_params.model_path = model_path;
+    load_params.n_ctx = 512;
+    load_params.num_threads = 2;
+    load_params.max_sequences = 2;
+    REQUIRE(engine.load_model(load_params));
+    REQUIRE(engine.is_model_loaded());
+    REQUIRE(engine.get_model_path() == model_path);
+    REQUIRE(engine.get_max_sequences() == 2);
+
+    cpu_llm_project::GenerationParams params;
+    params.max_tokens = 8;
+    params.temperature = 0.0f;
+    params.use_cache = false;
+
+    SECTION("Greedy generation is deterministic") {
+        const std::string first = engine.predict("hello world", "", params);
+        INFO("Result: " << first);
+        REQUIRE(first.rfind("[Error", 0) != 0);
+        REQUIRE(engine.predict("hello world", "", params) == first);
+    }
+
+    SECTION("predict_n returns one completion per sequence") {
+        params.n = 2;
+        params.temperature = 0.8f;
+        params.seed = 7;
+        std::vector<std::string> results = engine.predict_n("hello world", "", params);
+        REQUIRE(results.size() == 2);
+        for (const std::string& result : results) {
+            INFO("Result: " << result);
+            REQUIRE(result.rfind("[Error", 0) != 0);
+        }
+    }
+
+    SECTION("Generations that cannot fit in the context are refused up front") {
+        // n_ctx 512: 2 completações de 300 tokens nunca cabem, e sem a checagem o cache
+        // encheria no meio e as completações voltariam truncadas.
+        params.n = 2;
+        params.max_tokens = 300;
+        std::vector<std::string> results = engine.predict_n("hello world", "", params);
+        REQUIRE(results.size() == 1);
+        INFO("Result: " << results[0]);
+        REQUIRE(results[0].rfind("[Error", 0) == 0);
+        REQUIRE(results[0].find("exceed the context") != std::string::npos);
+    }
+
+    SECTION("KV used counts the prompt shared by the completions once") {
+        // O modelo sintético nunca emite EOG: cada completação decodifica max_tokens - 1
+        // tokens (o último não passa pelo modelo) além do prompt.
+        auto kv_used = [&engine]() {
+            const cpu_llm_project::MemoryReport report = engine.get_memory_report();
+            REQUIRE(report.models.size() == 1);
+            return report.models[0];
+        };
+        params.n = 1;
+        REQUIRE(engine.predict_n("hello world", "", params).size() == 1);
+        const cpu_llm_project::MemoryUsage single = kv_used();
+        REQUIRE(single.kv_used_bytes > 0);
+        REQUIRE(single.kv_used_bytes <= single.kv_allocated_bytes);
+
+        params.n = 2;
+        REQUIRE(engine.predict_n("hello world", "", params).size() == 2);
+        const cpu_llm_project::MemoryUsage forked = kv_used();
+        const size_t cell_bytes = forked.kv_allocated_bytes / forked.n_ctx;
+        REQUIRE(forked.kv_used_bytes - single.kv_used_bytes == cell_bytes * static_cast<size_t>(params.max_tokens - 1));
+    }
+
+    SECTION("score returns a logprob per continuation") {
+        std::vector<cpu_llm_project::ScoreItem> items = {{"A capital da França é", " Paris"}, {"A capital da França é", " Roma"}};
+        cpu_llm_project::ScoreBatch scored = engine.score(items, cpu_llm_project::ScoreParams());
+        REQUIRE(scored.error.empty());
+        REQUIRE(scored.results.size() == 2);
+        for (const cpu_llm_project::ScoreResult& result : scored.results) {
+            // Um item que falhou tem total_logprob 0: o erro precisa aparecer antes.
+            REQUIRE(result.error.empty());
+            REQUIRE_FALSE(result.tokens.empty());
+            REQUIRE(result.total_logprob < 0.0);
+        }
+        REQUIRE(scored.decode_calls >= 1);
+    }
+
+    SECTION("score splits more items than max_sequences into rounds") {
+        // Três itens com o mesmo prompt e max_sequences = 2: duas rodadas, cada uma com
+        // o prompt marcado com mais de uma sequência na primeira.
+        std::vector<cpu_llm_project::ScoreItem> items = {
+            {"A capital da França é", " Paris"}, {"A capital da França é", " Roma"}, {"A capital da França é", " Paris"}};
+        cpu_llm_project::ScoreBatch scored = engine.score(items, cpu_llm_project::ScoreParams());
+        REQUIRE(scored.error.empty());
+        REQUIRE(scored.results.size() == 3);
+        for (const cpu_llm_project::ScoreResult& result : scored.results) {
+            REQUIRE(result.error.empty());
+            REQUIRE_FALSE(result.tokens.empty());
+        }
+        REQUIRE(scored.decode_calls >= 2);
+        REQUIRE(std::abs(scored.results[0].total_logprob - scored.results[2].total_logprob) < 1e-3);
+    }
+
+    engine.unload_model();
+    REQUIRE_FALSE(engine.is_model_loaded());
+    REQUIRE(engine.get_model_path().empty());
+}
+
+TEST_CASE("max_sequences does not split the context between sequences", "[llm_engine]") {
+    const std::string model_path = test_fixtures::synthetic_model_path();
+    REQUIRE_FALSE(model_path.empty());
+
+    cpu_llm_project::LlmEngine engine;
+    cpu_llm_project::ModelLoadParams load_params;
+    load_params.model_path = model_path;
+    load_params.n_ctx = 256;
+    load_params.num_threads = 2;
+    load_params.max_sequences = 4;
+    REQUIRE(engine.load_model(load_params));
+
+    // Pelo menos 120 tokens (uma palavra do vocabulário sintético é no mínimo um token):
+    // bem mais que n_ctx / max_sequences = 64, e ainda dentro de n_ctx.
+    std::string prompt;
+    for (int i = 0; i < 60; ++i) { prompt += "hello world "; }
+
+    cpu_llm_project::GenerationParams params;
+    params.max_tokens = 8;
+    params.temperature = 0.0f;
+    params.use_cache = false;
+    const std::string result = engine.predict(prompt, "", params);
+    INFO("Result: " << result);
+    REQUIRE(result.rfind("[Error", 0) != 0);
+    REQUIRE_FALSE(result.empty());
+}
+
+TEST_CASE("Reloading the same model path does not serve cached responses", "[llm_engine]") {
+    const std::string model_path = test_fixtures::synthetic_model_path();
+    REQUIRE_FALSE(model_path.empty());
+
+    cpu_llm_project::LlmEngine engine;
+    engine.set_response_cache_capacity(1024 * 1024);
+    cpu_llm_project::ModelLoadParams load_params;
+    load_params.model_path = model_path;
+    load_params.n_ctx = 256;
+    load_params.num_threads = 2;
+    REQUIRE(engine.load_model(load_params));
+
+    cpu_llm_project::GenerationParams params;
+    params.max_tokens = 4;
+    params.temperature = 0.0f;
+    engine.predict("hello", "", params);
+    engine.predict("hello", "", params);
+    REQUIRE(engine.get_response_cache_stats().hits == 1);
+
+    // O arquivo poderia ter sido trocado no mesmo caminho: a instância nova não acerta
+    // nenhuma entrada da antiga.
+    REQUIRE(engine.reload_model(load_params));
+    engine.predict("hello", "", params);
+    const cpu_llm_project::ResponseCache::Stats stats = engine.get_response_cache_stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.entries == 1);
+}
@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/memory_stats.hpp"
+
+#include <sstream>
+#include <vector>
+
+namespace memory_stats = cpu_llm_project::memory_stats;
+
+TEST_CASE("Buffer sizes are parsed from llama.cpp log lines", "[memory_stats]") {
+    memory_stats::BufferKind kind;
+    size_t bytes = 0;
+
+    REQUIRE(memory_stats::parse_buffer_log_line("llama_kv_cache_unified:        CPU KV buffer size =   416.00 MiB\n", kind, bytes));
+    REQUIRE(kind == memory_stats::BufferKind::Kv);
+    REQUIRE(bytes == 416u * 1024 * 1024);
+
+    REQUIRE(memory_stats::parse_buffer_log_line("llama_context:        CPU compute buffer size =     0.50 MiB\n", kind, bytes));
+    REQUIRE(kind == memory_stats::BufferKind::Compute);
+    REQUIRE(bytes == 512u * 1024);
+
+    REQUIRE(memory_stats::parse_buffer_log_line("llama_context:        CPU  output buffer size =     1.00 MiB\n", kind, bytes));
+    REQUIRE(kind == memory_stats::BufferKind::Compute);
+
+    // Pesos são contados por llama_model_size(); outras linhas são ignoradas.
+    REQUIRE_FALSE(memory_stats::parse_buffer_log_line("load_tensors:   CPU_Mapped model buffer size =  1000.00 MiB\n", kind, bytes));
+    REQUIRE_FALSE(memory_stats::parse_buffer_log_line("llama_context: n_ctx = 2048\n", kind, bytes));
+}
+
+TEST_CASE("KV cache size follows the f16 layout", "[memory_stats]") {
+    // 2048 células, 26 camadas, 4 cabeças KV de 256 (K e V) em f16.
+    REQUIRE(memory_stats::kv_cache_bytes(2048, 26, 4, 256, 256) == 2048ull * 26 * 4 * 512 * 2);
+    REQUIRE(memory_stats::kv_cache_bytes(0, 26, 4, 256, 256) == 0);
+}
+
+TEST_CASE("Estimating a missing model reports an error", "[memory_stats]") {
+    cpu_llm_project::MemoryEstimate estimate;
+    std::string error;
+    REQUIRE_FALSE(memory_stats::estimate_model_memory("non_existent_model.gguf", 2048, 512, estimate, error));
+    REQUIRE_FALSE(error.empty());
+}
+
+#if defined(__linux__)
+TEST_CASE("Process RSS grows with touched memory", "[memory_stats]") {
+    const size_t before = memory_stats::process_rss_bytes();
+    REQUIRE(before > 0);
+    std::vector<char> block(64 * 1024 * 1024, 1);
+    REQUIRE(memory_stats::process_rss_bytes() >= before + block.size() / 2);
+}
+#endif
+
+TEST_CASE("Resident bytes of a mapped file are found by inode and counted once", "[memory_stats]") {
+    // Dois mapeamentos do mesmo trecho (duas instâncias), um deles de um arquivo já
+    // substituído no caminho, e um terceiro de outro arquivo.
+    std::istringstream smaps(
+        "7f0000000000-7f0000100000 r--s 00000000 fd:01 4242                       /models/m.gguf (deleted)\n"
+        "Size:               1024 kB\n"
+        "Rss:                 800 kB\n"
+        "7f1000000000-7f1000100000 r--s 00000000 fd:01 4242                       /models/m.gguf\n"
+        "Size:               1024 kB\n"
+        "Rss:                 600 kB\n"
+        "7f2000000000-7f2000010000 r--s 00100000 fd:01 4242                       /models/m.gguf\n"
+        "Rss:                  64 kB\n"
+        "7f3000000000-7f3000100000 r--s 00000000 fd:01 4343                       /models/m.gguf\n"
+        "Rss:                1000 kB\n"
+        "7f4000000000-7f4000100000 r--s 00000000 fd:02 4242                       /other/disk.gguf\n"
+        "Rss:                1000 kB\n");
+    cpu_llm_project::memory_stats::MappedFileId id;
+    id.device = (0xfdull << 32) | 0x01;
+    id.inode = 4242;
+    REQUIRE(memory_stats::smaps_resident_bytes(smaps, id) == (800 + 64) * 1024);
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/quantizer.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace quantizer = cpu_llm_project::quantizer;
+
+namespace {
+
+void write_i32(std::ofstream& out, int32_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+TEST_CASE("Quantization type names map to llama.cpp file types", "[quantizer]") {
+    int ftype = -1;
+    REQUIRE(quantizer::parse_quant_type("Q4_K_M", ftype));
+    REQUIRE(ftype == LLAMA_FTYPE_MOSTLY_Q4_K_M);
+    REQUIRE(quantizer::parse_quant_type("q5_k_m", ftype)); // Sem diferenciar maiúsculas
+    REQUIRE(ftype == LLAMA_FTYPE_MOSTLY_Q5_K_M);
+    REQUIRE(quantizer::parse_quant_type("Q8_0", ftype));
+    REQUIRE(ftype == LLAMA_FTYPE_MOSTLY_Q8_0);
+    REQUIRE_FALSE(quantizer::parse_quant_type("Q9_X", ftype));
+
+    // Todo nome listado na ajuda precisa ser aceito.
+    for (const std::string& name : quantizer::supported_types()) {
+        REQUIRE(quantizer::parse_quant_type(name, ftype));
+    }
+
+    REQUIRE(quantizer::requires_imatrix("IQ2_XXS"));
+    REQUIRE_FALSE(quantizer::requires_imatrix("Q4_K_M"));
+}
+
+TEST_CASE("Progress is parsed from the per-tensor log line", "[quantizer]") {
+    cpu_llm_project::QuantizeProgress progress;
+    REQUIRE(quantizer::parse_progress_line("[  12/ 291]                 blk.0.attn_q.weight - [ 2048,  2048,     1,     1], type =    f16, ", progress));
+    REQUIRE(progress.current == 12);
+    REQUIRE(progress.total == 291);
+    REQUIRE(progress.tensor_name == "blk.0.attn_q.weight");
+
+    REQUIRE_FALSE(quantizer::parse_progress_line("converting to q4_K .. size =    8.00 MiB ->     2.25 MiB\n", progress));
+    REQUIRE_FALSE(quantizer::parse_progress_line("llama_model_quantize_impl: model size  =  2000.00 MB\n", progress));
+}
+
+TEST_CASE("Legacy imatrix files are loaded and normalized", "[quantizer]") {
+    const std::string path = "test_quantizer_imatrix.dat";
+    {
+        std::ofstream out(path, std::ios::binary);
+        write_i32(out, 1);                        // n_entries
+        const std::string name = "blk.0.ffn_up.weight";
+        write_i32(out, static_cast<int32_t>(name.size()));
+        out.write(name.data(), static_cast<std::streamsize>(name.size()));
+        write_i32(out, 4);                        // ncall
+        write_i32(out, 2);                        // nval
+        const float values[2] = {8.0f, 2.0f};
+        out.write(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+
+    cpu_llm_project::ImatrixData data;
+    std::string error;
+    REQUIRE(quantizer::load_imatrix(path, data, error));
+    REQUIRE(data.size() == 1);
+    const std::vector<float>& values = data.at("blk.0.ffn_up.weight");
+    REQUIRE(values.size() == 2);
+    REQUIRE(values[0] == 2.0f);
+    REQUIRE(values[1] == 0.5f);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Quantization rejects invalid requests before touching the model", "[quantizer]") {
+    cpu_llm_project::QuantizeOptions options;
+    cpu_llm_project::QuantizeResult result;
+    std::string error;
+
+    options.input_path = "non_existent_model.gguf";
+    options.output_path = "non_existent_model.q4.gguf";
+    REQUIRE_FALSE(quantizer::quantize_model(options, result, error));
+    REQUIRE_FALSE(error.empty());
+
+    options.type = "Q9_X";
+    error.clear();
+    REQUIRE_FALSE(quantizer::quantize_model(options, result, error));
+    REQUIRE(error.find("Q9_X") != std::string::npos);
+
+    cpu_llm_project::ImatrixData data;
+    error.clear();
+    REQUIRE_FALSE(quantizer::load_imatrix("non_existent.imatrix", data, error));
+    REQUIRE_FALSE(error.empty());
+}
@@ -0,0 +1,68 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/response_cache.hpp"
+
+using cpu_llm_project::CacheKeyBuilder;
+using cpu_llm_project::ResponseCache;
+
+TEST_CASE("CacheKeyBuilder distinguishes field boundaries and values", "[response_cache]") {
+    uint64_t a = CacheKeyBuilder().add("ab").add("c").key();
+    uint64_t b = CacheKeyBuilder().add("a").add("bc").key();
+    REQUIRE(a != b);
+
+    uint64_t seed_1 = CacheKeyBuilder().add("model").add_value(1u).key();
+    uint64_t seed_2 = CacheKeyBuilder().add("model").add_value(2u).key();
+    REQUIRE(seed_1 != seed_2);
+    REQUIRE(seed_1 == CacheKeyBuilder().add("model").add_value(1u).key());
+}
+
+TEST_CASE("ResponseCache stores, evicts and counts", "[response_cache]") {
+    SECTION("Disabled cache never stores") {
+        ResponseCache cache;
+        REQUIRE_FALSE(cache.enabled());
+        cache.insert(1, "value");
+        std::string value;
+        REQUIRE_FALSE(cache.lookup(1, value));
+        REQUIRE(cache.stats().entries == 0);
+    }
+
+    SECTION("Hits and misses are counted") {
+        ResponseCache cache(4096);
+        std::string value;
+        REQUIRE_FALSE(cache.lookup(1, value));
+        cache.insert(1, "hello");
+        REQUIRE(cache.lookup(1, value));
+        REQUIRE(value == "hello");
+
+        ResponseCache::Stats stats = cache.stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.entries == 1);
+        REQUIRE(stats.bytes > 5);
+    }
+
+    SECTION("Least recently used entry is evicted when over the byte budget") {
+        const std::string big(400, 'x');
+        // Cabem duas entradas de ~500 bytes, não três.
+        ResponseCache cache(1100);
+        cache.insert(1, big);
+        cache.insert(2, big);
+        std::string value;
+        REQUIRE(cache.lookup(1, value)); // 1 passa a ser a mais recente
+        cache.insert(3, big);
+
+        REQUIRE(cache.lookup(1, value));
+        REQUIRE_FALSE(cache.lookup(2, value));
+        REQUIRE(cache.lookup(3, value));
+        REQUIRE(cache.stats().evictions == 1);
+        REQUIRE(cache.stats().bytes <= 1100);
+    }
+
+    SECTION("Shrinking the capacity to zero empties the cache") {
+        ResponseCache cache(4096);
+        cache.insert(1, "hello");
+        cache.set_capacity(0);
+        REQUIRE_FALSE(cache.enabled());
+        REQUIRE(cache.stats().entries == 0);
+        REQUIRE(cache.stats().bytes == 0);
+    }
+}
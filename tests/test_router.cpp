@@ -0,0 +1,181 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/router.hpp"
+
+#include "httplib.h"
+#include "nlohmann/json.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using cpu_llm_project::Router;
+using cpu_llm_project::RouterOptions;
+using json = nlohmann::json;
+
+namespace {
+
+// Worker falso: responde /health e ecoa em /api/generate quem atendeu e alguns cabeçalhos
+// recebidos, sem carregar modelo nenhum.
+class StubWorker {
+public:
+    explicit StubWorker(const std::string& name) {
+        server_.Get("/health", [](const httplib::Request&, httplib::Response& res) {
+            res.set_content(R"({"status": "ok"})", "application/json");
+        });
+        server_.Post("/api/generate", [name](const httplib::Request& req, httplib::Response& res) {
+            json body;
+            body["worker"] = name;
+            body["request_id"] = req.get_header_value("X-Request-Id");
+            body["has_proxy_authorization"] = req.has_header("Proxy-Authorization");
+            body["has_hop_header"] = req.has_header("X-Hop");
+            res.set_header("X-Stub-Header", "yes");
+            res.set_content(body.dump(), "application/json");
+        });
+        server_.Post("/api/admin/reload", [](const httplib::Request& req, httplib::Response& res) {
+            json body;
+            body["authorization"] = req.get_header_value("Authorization");
+            res.set_content(body.dump(), "application/json");
+        });
+        port_ = server_.bind_to_any_port("127.0.0.1");
+        if (port_ > 0) {
+            thread_ = std::thread([this]() { server_.listen_after_bind(); });
+            server_.wait_until_ready();
+        }
+    }
+    ~StubWorker() { stop(); }
+
+    void stop() {
+        if (thread_.joinable()) {
+            server_.stop();
+            thread_.join();
+        }
+    }
+
+    std::string address() const { return "127.0.0.1:" + std::to_string(port_); }
+    int port() const { return port_; }
+
+private:
+    httplib::Server server_;
+    std::thread thread_;
+    int port_ = -1;
+};
+
+httplib::Result generate(httplib::Client& client, const std::string& prompt, bool cache = true) {
+    httplib::Headers headers = {
+        {"X-Request-Id", "req-42"},
+        {"Proxy-Authorization", "Basic c2VjcmV0"},
+        {"Connection", "X-Hop"},
+        {"X-Hop", "1"},
+    };
+    const json body = {{"prompt", prompt}, {"temperature", 0}, {"cache", cache}};
+    return client.Post("/api/generate", headers, body.dump(), "application/json");
+}
+
+} // namespace
+
+TEST_CASE("Router forwards requests to stub workers", "[router]") {
+    StubWorker worker_a("a");
+    StubWorker worker_b("b");
+    REQUIRE(worker_a.port() > 0);
+    REQUIRE(worker_b.port() > 0);
+
+    RouterOptions options;
+    options.host = "127.0.0.1";
+    options.port = 0;
+    options.worker_addresses = {worker_a.address(), worker_b.address()};
+    options.health_interval_ms = 50;
+    options.request_timeout_sec = 5;
+    options.server.admin_token = "s3cret";
+    Router router(options);
+    std::thread router_thread([&router]() { router.start(); });
+
+    // Espera o bind e o primeiro health check dos dois workers.
+    bool ready = false;
+    for (int attempt = 0; attempt < 100 && !ready; ++attempt) {
+        if (router.port() > 0) {
+            httplib::Client probe("127.0.0.1", router.port());
+            auto health = probe.Get("/health");
+            ready = health && health->status == 200 &&
+                    json::parse(health->body, nullptr, false).value("healthy_workers", 0) == 2;
+        }
+        if (!ready) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }
+    }
+    if (!ready) {
+        router.stop();
+        router_thread.join();
+        FAIL("Router did not become ready");
+    }
+
+    httplib::Client client("127.0.0.1", router.port());
+
+    SECTION("End-to-end headers are forwarded both ways, hop-by-hop ones are not") {
+        auto result = generate(client, "juridico");
+        REQUIRE(result);
+        REQUIRE(result->status == 200);
+        const json body = json::parse(result->body);
+        REQUIRE(body["request_id"] == "req-42");
+        REQUIRE(body["has_proxy_authorization"] == false);
+        REQUIRE(body["has_hop_header"] == false);
+        REQUIRE(result->get_header_value("X-Stub-Header") == "yes");
+        REQUIRE(result->has_header("X-Worker-Id"));
+    }
+
+    SECTION("Admin reload over TCP needs the admin token, which is forwarded to the workers") {
+        auto refused = client.Post("/api/admin/reload", "", "application/json");
+        REQUIRE(refused);
+        REQUIRE(refused->status == 401);
+
+        auto wrong = client.Post("/api/admin/reload", {{"Authorization", "Bearer wrong"}}, "", "application/json");
+        REQUIRE(wrong);
+        REQUIRE(wrong->status == 401);
+
+        auto result = client.Post("/api/admin/reload", {{"Authorization", "Bearer s3cret"}}, "", "application/json");
+        REQUIRE(result);
+        REQUIRE(result->status == 200);
+        const json body = json::parse(result->body);
+        REQUIRE(body["workers"].size() == 2);
+        for (const json& worker : body["workers"]) {
+            REQUIRE(worker["response"]["authorization"] == "Bearer s3cret");
+        }
+    }
+
+    SECTION("Identical requests always reach the same worker") {
+        auto first = generate(client, "juridico");
+        REQUIRE(first);
+        const std::string worker = json::parse(first->body)["worker"];
+        for (int i = 0; i < 5; ++i) {
+            auto again = generate(client, "juridico");
+            REQUIRE(again);
+            REQUIRE(json::parse(again->body)["worker"] == worker);
+        }
+    }
+
+    SECTION("Requests with nothing cached go to the least loaded worker") {
+        for (int i = 0; i < 3; ++i) {
+            auto result = generate(client, "prompt " + std::to_string(i), false);
+            REQUIRE(result);
+            REQUIRE(result->status == 200);
+        }
+        auto metrics = client.Get("/api/metrics");
+        REQUIRE(metrics);
+        const json router_metrics = json::parse(metrics->body)["router"];
+        REQUIRE(router_metrics["balanced"] == 3);
+        REQUIRE(router_metrics["affinity_hits"] == 0);
+    }
+
+    SECTION("Requests fall back to the other worker when one is down") {
+        auto first = generate(client, "juridico");
+        REQUIRE(first);
+        const std::string worker = json::parse(first->body)["worker"];
+        (worker == "a" ? worker_a : worker_b).stop();
+
+        auto fallback = generate(client, "juridico");
+        REQUIRE(fallback);
+        REQUIRE(fallback->status == 200);
+        REQUIRE(json::parse(fallback->body)["worker"] != worker);
+    }
+
+    router.stop();
+    router_thread.join();
+}
@@ -0,0 +1,176 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "cpu_llm_project/sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using cpu_llm_project::Sampler;
+using cpu_llm_project::SamplingParams;
+namespace kernels = cpu_llm_project::sampling_kernels;
+
+namespace {
+
+std::vector<float> random_logits(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 3.0f);
+    std::vector<float> logits(n);
+    for (float& value : logits) { value = dist(rng); }
+    return logits;
+}
+
+} // namespace
+
+TEST_CASE("Sampling kernels match scalar references", "[sampler]") {
+    INFO("Backend: " << kernels::backend_name());
+    // Tamanhos que não são múltiplos de 8/16 exercitam as caudas escalares.
+    for (size_t n : {1u, 7u, 17u, 33u, 1003u, 32000u}) {
+        std::vector<float> logits = random_logits(n, static_cast<uint32_t>(n));
+        auto max_it = std::max_element(logits.begin(), logits.end());
+
+        REQUIRE(kernels::max_value(logits.data(), n) == *max_it);
+        REQUIRE(kernels::argmax(logits.data(), n) == static_cast<size_t>(max_it - logits.begin()));
+
+        std::vector<float> out(n);
+        float sum = kernels::exp_shifted(logits.data(), out.data(), n, *max_it, 0.5f);
+        float expected_sum = 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            float expected = std::exp((logits[i] - *max_it) * 0.5f);
+            REQUIRE(std::fabs(out[i] - expected) <= 1e-6f + 1e-5f * expected);
+            expected_sum += expected;
+        }
+        REQUIRE(std::fabs(sum - expected_sum) <= 1e-4f * expected_sum);
+
+        double expected_lse = 0.0;
+        for (float value : logits) { expected_lse += std::exp(static_cast<double>(value) - *max_it); }
+        expected_lse = *max_it + std::log(expected_lse);
+        REQUIRE(std::fabs(kernels::log_sum_exp(logits.data(), n, out.data()) - expected_lse) <= 1e-4);
+
+        const size_t k = std::min<size_t>(40, n);
+        std::vector<kernels::Candidate> top;
+        kernels::select_top_k(logits.data(), n, k, top);
+        REQUIRE(top.size() == k);
+        std::vector<float> sorted = logits;
+        std::sort(sorted.begin(), sorted.end(), std::greater<float>());
+        std::vector<float> selected;
+        for (const auto& candidate : top) {
+            REQUIRE(logits[candidate.id] == candidate.logit);
+            selected.push_back(candidate.logit);
+        }
+        std::sort(selected.begin(), selected.end(), std::greater<float>());
+        REQUIRE(std::equal(selected.begin(), selected.end(), sorted.begin()));
+    }
+}
+
+TEST_CASE("Sampler behaviour", "[sampler]") {
+    const int n_vocab = 5000;
+    const std::vector<float> logits = random_logits(n_vocab, 7);
+    const llama_token best = static_cast<llama_token>(std::max_element(logits.begin(), logits.end()) - logits.begin());
+
+    SECTION("Zero temperature is greedy") {
+        SamplingParams params;
+        params.temperature = 0.0f;
+        params.repeat_penalty = 1.0f;
+        Sampler sampler(params);
+        std::vector<float> work = logits;
+        REQUIRE(sampler.sample(work.data(), n_vocab) == best);
+    }
+
+    SECTION("top_k = 1 always picks the best token") {
+        SamplingParams params;
+        params.top_k = 1;
+        params.repeat_penalty = 1.0f;
+        Sampler sampler(params);
+        for (int i = 0; i < 10; ++i) {
+            std::vector<float> work = logits;
+            REQUIRE(sampler.sample(work.data(), n_vocab) == best);
+        }
+    }
+
+    SECTION("Repeat penalty only touches recent tokens") {
+        SamplingParams params;
+        params.temperature = 0.0f;
+        params.repeat_penalty = 1000.0f;
+        Sampler sampler(params);
+        sampler.accept(best);
+        std::vector<float> work = logits;
+        REQUIRE(sampler.sample(work.data(), n_vocab) != best);
+        for (int i = 0; i < n_vocab; ++i) {
+            if (i != best) { REQUIRE(work[i] == logits[i]); }
+        }
+    }
+
+    SECTION("Fixed seed reproduces the same sequence, with and without top-k") {
+        for (int top_k : {40, 0}) {
+            SamplingParams params;
+            params.temperature = 1.5f;
+            params.top_k = top_k;
+            params.top_p = 0.95f;
+            params.seed = 1234;
+            Sampler first(params);
+            Sampler second(params);
+            std::vector<llama_token> a, b;
+            for (int i = 0; i < 20; ++i) {
+                std::vector<float> work_a = logits, work_b = logits;
+                a.push_back(first.sample(work_a.data(), n_vocab));
+                b.push_back(second.sample(work_b.data(), n_vocab));
+            }
+            REQUIRE(a == b);
+            // Com temperatura alta a amostragem não deve colapsar num único token.
+            REQUIRE(std::count(a.begin(), a.end(), a[0]) < static_cast<long>(a.size()));
+        }
+    }
+}
+
+// Comparação com a cadeia llama_sampler usada anteriormente em LlmEngine::predict.
+// Oculto por padrão; rode com: run_tests "[sampler][benchmark]"
+TEST_CASE("Sampler vs llama_sampler chain on a 256k vocabulary", "[.][sampler][benchmark]") {
+    const int n_vocab = 256000;
+    const std::vector<float> logits = random_logits(n_vocab, 42);
+    const std::vector<llama_token> history = {1, 2, 3, 500, 1000, 20000};
+
+    SamplingParams params;
+    params.temperature = 0.8f;
+    params.top_k = 40;
+    params.top_p = 0.9f;
+    params.repeat_penalty = 1.1f;
+    params.seed = 42;
+
+    llama_sampler* chain = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(chain, llama_sampler_init_penalties(params.penalty_last_n, params.repeat_penalty, 0.0f, 0.0f));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_k(params.top_k));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_p(params.top_p, 1));
+    llama_sampler_chain_add(chain, llama_sampler_init_temp(params.temperature));
+    llama_sampler_chain_add(chain, llama_sampler_init_dist(params.seed));
+    for (llama_token token : history) { llama_sampler_accept(chain, token); }
+    std::vector<llama_token_data> data(n_vocab);
+
+    Sampler sampler(params);
+    for (llama_token token : history) { sampler.accept(token); }
+    std::vector<float> work(n_vocab);
+
+    SamplingParams greedy_params = params;
+    greedy_params.temperature = 0.0f;
+    Sampler greedy(greedy_params);
+
+    BENCHMARK("llama_sampler chain (penalties, top-k, top-p, temp, dist)") {
+        for (int i = 0; i < n_vocab; ++i) { data[i] = {i, logits[i], 0.0f}; }
+        llama_token_data_array cur_p = {data.data(), data.size(), -1, false};
+        llama_sampler_apply(chain, &cur_p);
+        return cur_p.data[cur_p.selected].id;
+    };
+
+    BENCHMARK(std::string("Sampler top-k/top-p [") + kernels::backend_name() + "]") {
+        std::copy(logits.begin(), logits.end(), work.begin());
+        return sampler.sample(work.data(), n_vocab);
+    };
+
+    BENCHMARK(std::string("Sampler greedy [") + kernels::backend_name() + "]") {
+        std::copy(logits.begin(), logits.end(), work.begin());
+        return greedy.sample(work.data(), n_vocab);
+    };
+
+    llama_sampler_free(chain);
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch_test_macros.hpp>
+#include "cpu_llm_project/tracing.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace tracing = cpu_llm_project::tracing;
+
+namespace {
+
+std::string read_trace_file(const std::filesystem::path& dir, uint64_t trace_id, const char* suffix) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "trace-%016llx%s", static_cast<unsigned long long>(trace_id), suffix);
+    std::ifstream in(dir / name);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+tracing::Config test_config(const std::filesystem::path& dir, tracing::ExportFormat format) {
+    tracing::Config config;
+    config.sample_rate = 0.0;
+    config.output_dir = dir.string();
+    config.format = format;
+    return config;
+}
+
+} // namespace
+
+TEST_CASE("Tracing records spans only for sampled requests", "[tracing]") {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "cpu_llm_project_test_traces";
+    std::filesystem::remove_all(dir);
+    const tracing::Config previous = tracing::current_config();
+
+    SECTION("Unsampled scope is inactive and spans are no-ops") {
+        tracing::configure(test_config(dir, tracing::ExportFormat::ChromeTrace));
+        {
+            tracing::TraceScope trace("request", false);
+            REQUIRE_FALSE(trace.active());
+            REQUIRE(tracing::current_trace_id() == 0);
+            tracing::Span span("work");
+        }
+        tracing::flush();
+        REQUIRE_FALSE(std::filesystem::exists(dir));
+    }
+
+    SECTION("Forced scope exports nested spans as Chrome trace events") {
+        tracing::configure(test_config(dir, tracing::ExportFormat::ChromeTrace));
+        uint64_t trace_id = 0;
+        {
+            tracing::TraceScope trace("request", true);
+            REQUIRE(trace.active());
+            trace_id = trace.trace_id();
+            REQUIRE(tracing::current_trace_id() == trace_id);
+            tracing::Span outer("prefill_chunk", 42);
+            { tracing::Span inner("decode_step"); }
+        }
+        REQUIRE(tracing::current_trace_id() == 0);
+
+        // A exportação acontece na thread exportadora; flush espera o arquivo ser gravado.
+        tracing::flush();
+        const std::string contents = read_trace_file(dir, trace_id, ".json");
+        REQUIRE(contents.find("\"traceEvents\"") != std::string::npos);
+        REQUIRE(contents.find("\"name\":\"request\"") != std::string::npos);
+        REQUIRE(contents.find("\"name\":\"prefill_chunk\"") != std::string::npos);
+        REQUIRE(contents.find("\"value\":42") != std::string::npos);
+        REQUIRE(contents.find("\"name\":\"decode_step\"") != std::string::npos);
+    }
+
+    SECTION("Deferred export waits for finish_trace and includes spans from other threads") {
+        tracing::configure(test_config(dir, tracing::ExportFormat::Otlp));
+        uint64_t trace_id = 0;
+        uint64_t parent_span_id = 0;
+        {
+            tracing::TraceScope trace("request", true);
+            trace_id = trace.trace_id();
+            trace.defer_export();
+            REQUIRE(tracing::current_span_id() != 0); // A raiz
+            tracing::Span generate("generate");
+            parent_span_id = tracing::current_span_id();
+            std::thread worker([trace_id, parent_span_id] { tracing::Span span(trace_id, parent_span_id, "worker_step"); });
+            worker.join();
+        }
+        tracing::flush();
+        REQUIRE(read_trace_file(dir, trace_id, ".otlp.json").empty());
+
+        tracing::finish_trace(trace_id, "response_write");
+        tracing::flush();
+        const std::string contents = read_trace_file(dir, trace_id, ".otlp.json");
+        REQUIRE(contents.find("\"resourceSpans\"") != std::string::npos);
+        REQUIRE(contents.find("\"name\":\"worker_step\"") != std::string::npos);
+        REQUIRE(contents.find("\"name\":\"response_write\"") != std::string::npos);
+        REQUIRE(contents.find("\"parentSpanId\"") != std::string::npos);
+        // O span da outra thread fica sob o span da requisição, e não como uma raiz a mais.
+        char worker_parent[96];
+        std::snprintf(worker_parent, sizeof(worker_parent), "\"parentSpanId\":\"%016llx\",\"name\":\"worker_step\"",
+                      static_cast<unsigned long long>(parent_span_id));
+        REQUIRE(contents.find(worker_parent) != std::string::npos);
+
+        // Um segundo finish_trace para o mesmo id não faz nada.
+        tracing::finish_trace(trace_id, "response_write");
+    }
+
+    tracing::flush();
+    tracing::configure(previous);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Tracing bounds what clients can make it write", "[tracing]") {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "cpu_llm_project_test_traces_limits";
+    std::filesystem::remove_all(dir);
+    const tracing::Config previous = tracing::current_config();
+
+    SECTION("Forced traces are ignored when allow_forced is off") {
+        tracing::Config config = test_config(dir, tracing::ExportFormat::ChromeTrace);
+        config.allow_forced = false;
+        tracing::configure(config);
+        tracing::TraceScope trace("request", true);
+        REQUIRE_FALSE(trace.active());
+    }
+
+    SECTION("Only the newest max_files trace files are kept") {
+        tracing::Config config = test_config(dir, tracing::ExportFormat::ChromeTrace);
+        config.max_files = 3;
+        tracing::configure(config);
+        uint64_t last_id = 0;
+        for (int i = 0; i < 5; ++i) {
+            tracing::TraceScope trace("request", true);
+            last_id = trace.trace_id();
+        }
+        tracing::flush();
+        size_t files = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            (void)entry;
+            ++files;
+        }
+        REQUIRE(files == 3);
+        REQUIRE_FALSE(read_trace_file(dir, last_id, ".json").empty());
+    }
+
+    SECTION("Spans overwritten in the ring buffer are counted in the export") {
+        tracing::Config config = test_config(dir, tracing::ExportFormat::ChromeTrace);
+        config.ring_capacity = 4; // Vale para buffers de threads novas
+        tracing::configure(config);
+        uint64_t trace_id = 0;
+        std::thread worker([&trace_id] {
+            tracing::TraceScope trace("request", true);
+            trace_id = trace.trace_id();
+            for (int i = 0; i < 10; ++i) { tracing::Span span("decode_step"); }
+        });
+        worker.join();
+        tracing::flush();
+        // 10 spans + a raiz = 11 registros num ring de 4.
+        REQUIRE(read_trace_file(dir, trace_id, ".json").find("\"dropped_spans\":7") != std::string::npos);
+    }
+
+    tracing::flush();
+    tracing::configure(previous);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Tracing export format names are parsed", "[tracing]") {
+    tracing::ExportFormat format = tracing::ExportFormat::ChromeTrace;
+    REQUIRE(tracing::parse_export_format("otlp", format));
+    REQUIRE(format == tracing::ExportFormat::Otlp);
+    REQUIRE(tracing::parse_export_format("chrome", format));
+    REQUIRE(format == tracing::ExportFormat::ChromeTrace);
+    REQUIRE_FALSE(tracing::parse_export_format("jaeger", format));
+}